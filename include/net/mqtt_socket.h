@@ -24,6 +24,7 @@
 
 #include <stddef.h>
 
+#include <kernel.h>
 #include <zephyr/types.h>
 #include <net/tls_credentials.h>
 
@@ -47,7 +48,9 @@ enum mqtt_evt_type {
 	MQTT_EVT_DISCONNECT,
 
 	/** Publish event received when message is published on a topic client
-	 *  is subscribed to.
+	 *  is subscribed to. With
+	 *  :option:`CONFIG_MQTT_LIB_PUBLISH_STREAMING`, the payload is not
+	 *  included and shall be read with @ref mqtt_read_publish_payload.
 	 */
 	MQTT_EVT_PUBLISH,
 
@@ -67,13 +70,20 @@ enum mqtt_evt_type {
 	MQTT_EVT_SUBACK,
 
 	/** Acknowledgment to a unsubscribe request. */
-	MQTT_EVT_UNSUBACK
+	MQTT_EVT_UNSUBACK,
+
+	/** Transport connection started with @ref mqtt_connect_async is
+	 *  established and the connection request is sent. Followed by
+	 *  @ref MQTT_EVT_CONNACK.
+	 */
+	MQTT_EVT_TRANSPORT_CONNECTED
 };
 
 /** @brief MQTT version protocol level. */
 enum mqtt_version {
 	MQTT_VERSION_3_1_0 = 3, /**< Protocol level for 3.1.0. */
-	MQTT_VERSION_3_1_1 = 4  /**< Protocol level for 3.1.1. */
+	MQTT_VERSION_3_1_1 = 4, /**< Protocol level for 3.1.1. */
+	MQTT_VERSION_5_0 = 5    /**< Protocol level for 5.0. */
 };
 
 /** @brief MQTT Quality of Service types. */
@@ -178,28 +188,74 @@ struct mqtt_connack_param {
 
 	/** The appropriate non-zero Connect return code indicates if the Server
 	 *  is unable to process a connection request for some reason.
+	 *  With MQTT 5.0, this is the Connect Reason Code.
 	 */
 	enum mqtt_conn_return_code return_code;
+
+#if defined(CONFIG_MQTT_LIB_PROTOCOL_V5)
+	/** Session Expiry Interval (in seconds) used by the Server, MQTT 5.0
+	 *  only.
+	 */
+	u32_t session_expiry_interval;
+
+	/** Highest topic alias accepted by the Server, MQTT 5.0 only. */
+	u16_t topic_alias_max;
+
+	/** Keep Alive time (in seconds) used by the Server, MQTT 5.0 only. */
+	u16_t server_keep_alive;
+#endif /* CONFIG_MQTT_LIB_PROTOCOL_V5 */
 };
 
 /** @brief Parameters for MQTT publish acknowledgment (PUBACK). */
 struct mqtt_puback_param {
 	u16_t message_id;
+
+#if defined(CONFIG_MQTT_LIB_PROTOCOL_V5)
+	/** Reason Code of a received packet, MQTT 5.0 only. Values of 0x80
+	 *  and above indicate a failure. Packets are sent with Reason Code
+	 *  Success.
+	 */
+	u8_t reason_code;
+#endif /* CONFIG_MQTT_LIB_PROTOCOL_V5 */
 };
 
 /** @brief Parameters for MQTT publish receive (PUBREC). */
 struct mqtt_pubrec_param {
 	u16_t message_id;
+
+#if defined(CONFIG_MQTT_LIB_PROTOCOL_V5)
+	/** Reason Code of a received packet, MQTT 5.0 only. Values of 0x80
+	 *  and above indicate a failure. Packets are sent with Reason Code
+	 *  Success.
+	 */
+	u8_t reason_code;
+#endif /* CONFIG_MQTT_LIB_PROTOCOL_V5 */
 };
 
 /** @brief Parameters for MQTT publish release (PUBREL). */
 struct mqtt_pubrel_param {
 	u16_t message_id;
+
+#if defined(CONFIG_MQTT_LIB_PROTOCOL_V5)
+	/** Reason Code of a received packet, MQTT 5.0 only. Values of 0x80
+	 *  and above indicate a failure. Packets are sent with Reason Code
+	 *  Success.
+	 */
+	u8_t reason_code;
+#endif /* CONFIG_MQTT_LIB_PROTOCOL_V5 */
 };
 
 /** @brief Parameters for MQTT publish complete (PUBCOMP). */
 struct mqtt_pubcomp_param {
 	u16_t message_id;
+
+#if defined(CONFIG_MQTT_LIB_PROTOCOL_V5)
+	/** Reason Code of a received packet, MQTT 5.0 only. Values of 0x80
+	 *  and above indicate a failure. Packets are sent with Reason Code
+	 *  Success.
+	 */
+	u8_t reason_code;
+#endif /* CONFIG_MQTT_LIB_PROTOCOL_V5 */
 };
 
 /** @brief Parameters for MQTT subscription acknowledgment (SUBACK). */
@@ -303,6 +359,92 @@ struct mqtt_client;
 typedef void (*mqtt_evt_cb_t)(struct mqtt_client *client,
 			      const struct mqtt_evt *evt);
 
+#if defined(CONFIG_MQTT_LIB_INFLIGHT)
+/**
+ * @brief Completion callback of a publish message sent with
+ *        @ref mqtt_publish_tracked.
+ *
+ * @param[in] client Identifies the client that sent the message.
+ * @param[in] message_id Message id of the publish message.
+ * @param[in] result 0 if the broker acknowledged the message (PUBACK for
+ *                   QoS 1, PUBCOMP for QoS 2) or a negative error code
+ *                   (errno.h) indicating reason of failure. -EPERM if the
+ *                   broker rejected the message with an MQTT 5.0 Reason
+ *                   Code.
+ * @param[in] user_data User data given to @ref mqtt_publish_tracked.
+ */
+typedef void (*mqtt_publish_done_cb_t)(struct mqtt_client *client,
+				       u16_t message_id, int result,
+				       void *user_data);
+
+/** @brief Publish message awaiting acknowledgment from the broker. */
+struct mqtt_inflight {
+	/** Parameters of the publish message. Topic and payload point to
+	 *  application memory.
+	 */
+	struct mqtt_publish_param param;
+
+	/** Completion callback. Can be NULL. */
+	mqtt_publish_done_cb_t cb;
+
+	/** User data passed to the completion callback. */
+	void *user_data;
+
+	/** Wall clock value (in milliseconds) of the last transmission. */
+	u32_t timestamp;
+
+	/** Acknowledgment awaited for the message. */
+	u8_t state;
+};
+#endif /* CONFIG_MQTT_LIB_INFLIGHT */
+
+#if defined(CONFIG_MQTT_LIB_PAYLOAD_CODEC)
+/**
+ * @brief Transformation of the payload of a publish message.
+ *
+ * @param[in] ctx Context of the codec.
+ * @param[in] topic Topic of the message.
+ * @param[in] in Payload to transform.
+ * @param[inout] out Transformed payload, set to the payload to transform
+ *                   when called. Leave unchanged to keep the payload as is,
+ *                   for example for topics the codec does not handle.
+ *                   Otherwise, point it to memory owned by the codec.
+ *
+ * @return 0 or a negative error code (errno.h) indicating reason of failure.
+ */
+typedef int (*mqtt_payload_transform_t)(void *ctx,
+					const struct mqtt_topic *topic,
+					const struct mqtt_binstr *in,
+					struct mqtt_binstr *out);
+
+/**
+ * @brief Codec transforming the payload of publish messages, for example
+ *        to compress it.
+ *
+ * @details The codec is called with the client locked, and shall not call
+ *          the MQTT API for the client.
+ */
+struct mqtt_payload_codec {
+	/** Transformation of the payload of sent messages, applied before the
+	 *  message is encoded. The transformed payload shall remain valid
+	 *  until the next call. Messages retransmitted by the library are
+	 *  encoded again. Can be NULL.
+	 */
+	mqtt_payload_transform_t encode;
+
+	/** Transformation of the payload of received messages, applied before
+	 *  @ref MQTT_EVT_PUBLISH is notified. The transformed payload shall
+	 *  remain valid until the event callback returns. On failure, the
+	 *  event is notified with the error as result and the payload as
+	 *  received. Can be NULL.
+	 */
+	mqtt_payload_transform_t decode;
+
+	/** Context passed to the transformations. */
+	void *ctx;
+};
+#endif /* CONFIG_MQTT_LIB_PAYLOAD_CODEC */
+
 /** @brief TLS configuration for secure MQTT transports. */
 struct mqtt_sec_config {
 	/** Indicates the preference for peer verification. */
@@ -326,6 +468,14 @@ struct mqtt_sec_config {
 	 *  May be NULL to skip hostname verification.
 	 */
 	char *hostname;
+
+	/** Indicates the preference for TLS session caching, which lets a
+	 *  reconnection resume the previous TLS session with an abbreviated
+	 *  handshake. Either TLS_SESSION_CACHE_ENABLED or
+	 *  TLS_SESSION_CACHE_DISABLED, the default. Ignored if the socket
+	 *  layer does not support the TLS_SESSION_CACHE option.
+	 */
+	int session_cache;
 };
 
 /** @brief MQTT transport type. */
@@ -374,6 +524,17 @@ struct mqtt_transport {
 	};
 };
 
+#if defined(CONFIG_MQTT_LIB_PROTOCOL_V5)
+/** @brief Topic mapped to an outbound topic alias, MQTT 5.0 only. */
+struct mqtt_topic_alias {
+	/** Topic string, not terminated. */
+	u8_t topic[CONFIG_MQTT_TOPIC_ALIAS_TOPIC_LEN];
+
+	/** Length of the topic, 0 if the alias is not mapped. */
+	u16_t size;
+};
+#endif /* CONFIG_MQTT_LIB_PROTOCOL_V5 */
+
 /**
  * @brief MQTT Client definition to maintain information relevant to the
  *        client.
@@ -410,33 +571,122 @@ struct mqtt_client {
 	 */
 	mqtt_evt_cb_t evt_cb;
 
+#if defined(CONFIG_MQTT_LIB_PAYLOAD_CODEC)
+	/** Codec applied to the payload of sent and received publish
+	 *  messages. NULL, the default, leaves payloads unchanged.
+	 */
+	const struct mqtt_payload_codec *payload_codec;
+#endif /* CONFIG_MQTT_LIB_PAYLOAD_CODEC */
+
 	/** Internal. Wall clock value (in milliseconds) of the last activity
 	 *  that occurred. Needed for periodic PING.
 	 */
 	u32_t last_activity;
 
+	/** Internal. Shall not be touched by the application. Wall clock
+	 *  value (in milliseconds) of the Ping Request awaiting a response.
+	 */
+	u32_t ping_timestamp;
+
+	/** Internal. Shall not be touched by the application. Set while a
+	 *  Ping Request awaits a response.
+	 */
+	u8_t ping_pending;
+
+	/** Internal. Shall not be touched by the application. Keep Alive
+	 *  time (in seconds) used on the current connection.
+	 */
+	u16_t keepalive_interval;
+
 	/** Internal. Shall not be touched by the application.
 	 *  Client's state in the connection.
 	 */
 	u32_t state;
 
+	/** Internal. Shall not be touched by the application. Mutex
+	 *  protecting the client instance.
+	 */
+	struct k_mutex mutex;
+
 	/** Internal. Shall not be touched by the application. Used for creating
 	 *  MQTT packet in TX path.
 	 */
 	u8_t *tx_buf;
 
+	/** Internal. Shall not be touched by the application. */
+	u32_t tx_buf_size;
+
 	/** Internal. Shall not be touched by the application. */
 	u8_t *rx_buf;
 
+	/** Internal. Shall not be touched by the application. */
+	u32_t rx_buf_size;
+
 	/** Internal. Shall not be touched by the application. */
 	u32_t rx_buf_datalen;
 
+	/** Internal. Shall not be touched by the application. Length of the
+	 *  received Publish payload still to be read from the transport.
+	 */
+	u32_t rx_payload_remaining;
+
+#if defined(CONFIG_MQTT_LIB_PUBLISH_COALESCING)
+	/** Internal. Shall not be touched by the application. Publish
+	 *  messages waiting to be written to the transport in one go.
+	 */
+	u8_t coalesce_buf[CONFIG_MQTT_COALESCE_BUFFER_SIZE];
+
+	/** Internal. Shall not be touched by the application. */
+	u32_t coalesce_len;
+
+	/** Internal. Shall not be touched by the application. Wall clock
+	 *  value (in milliseconds) of the first message in coalesce_buf.
+	 */
+	u32_t coalesce_timestamp;
+#endif /* CONFIG_MQTT_LIB_PUBLISH_COALESCING */
+
+#if defined(CONFIG_MQTT_LIB_INFLIGHT)
+	/** Internal. Shall not be touched by the application. Publish
+	 *  messages awaiting acknowledgment from the broker.
+	 */
+	struct mqtt_inflight inflight[CONFIG_MQTT_INFLIGHT_WINDOW];
+
+	/** Internal. Shall not be touched by the application. Last message
+	 *  id allocated for a tracked publish message.
+	 */
+	u16_t inflight_message_id;
+#endif /* CONFIG_MQTT_LIB_INFLIGHT */
+
+#if defined(CONFIG_MQTT_LIB_PROTOCOL_V5)
+	/** Internal. Shall not be touched by the application. Topics mapped
+	 *  to outbound topic aliases, alias i + 1 for entry i.
+	 */
+	struct mqtt_topic_alias topic_alias[CONFIG_MQTT_TOPIC_ALIAS_COUNT];
+
+	/** Internal. Shall not be touched by the application. Highest topic
+	 *  alias accepted by the broker.
+	 */
+	u16_t topic_alias_max;
+
+	/** Internal. Shall not be touched by the application. Entry replaced
+	 *  next when all topic aliases are in use.
+	 */
+	u16_t topic_alias_next;
+#endif /* CONFIG_MQTT_LIB_PROTOCOL_V5 */
+
 	/** Unique client identification to be used for the connection. */
 	struct mqtt_utf8 client_id;
 
 	/** MQTT protocol version. */
 	u8_t protocol_version;
 
+	/** Keep Alive time (in seconds) requested on connection. 0 disables
+	 *  the Keep Alive mechanism. Default is :option:`CONFIG_MQTT_KEEPALIVE`.
+	 *  With MQTT 5.0, the value used by the Server, if any, applies to the
+	 *  current connection instead.
+	 */
+	u16_t keepalive;
+
 	/** Will retain flag, 1 if will message shall be retained persistently.
 	 */
 	u8_t will_retain : 1;
@@ -445,6 +695,14 @@ struct mqtt_client {
 	 *  Default is 1.
 	 */
 	u8_t clean_session : 1;
+
+#if defined(CONFIG_MQTT_LIB_PROTOCOL_V5)
+	/** Session Expiry Interval (in seconds) requested on connection, used
+	 *  with MQTT 5.0 only. 0, the default, ends the session when the
+	 *  connection is closed.
+	 */
+	u32_t session_expiry_interval;
+#endif /* CONFIG_MQTT_LIB_PROTOCOL_V5 */
 };
 
 /**
@@ -462,11 +720,20 @@ int mqtt_init(void);
  *
  * @param[in] client Client instance for which the procedure is requested.
  *                   Shall not be NULL.
+ * @param[in] rx_buf Buffer used to receive packets. Shall not be NULL.
+ * @param[in] rx_buf_size Size of the RX buffer, which limits the size of the
+ *                        packets that can be received.
+ * @param[in] tx_buf Buffer used to encode packets. Shall not be NULL.
+ * @param[in] tx_buf_size Size of the TX buffer, which limits the size of the
+ *                        packets that can be sent.
  *
  * @note Shall be called before connecting the client in order to avoid
  *       unexpected behavior caused by uninitialized parameters.
+ * @note The buffers are owned by the client until it is initialized again,
+ *       and shall not be shared with other clients.
  */
-void mqtt_client_init(struct mqtt_client *client);
+void mqtt_client_init(struct mqtt_client *client, u8_t *rx_buf,
+		      u32_t rx_buf_size, u8_t *tx_buf, u32_t tx_buf_size);
 
 /**
  * @brief API to request new MQTT client connection.
@@ -484,14 +751,41 @@ void mqtt_client_init(struct mqtt_client *client);
  *       set client.protocol_version = MQTT_VERSION_3_1_0 to use protocol 3.1.0.
  * @note If more than one simultaneous client connections are needed, please
  *       modify :option:`CONFIG_MQTT_MAX_CLIENTS` to override default of 1.
- * @note Please modify :option:`CONFIG_MQTT_KEEPALIVE` time to override default
- *       of 1 minute.
- * @note Please modify :option:`CONFIG_MQTT_MAX_PACKET_LENGTH` time to override
- *       default of 128 bytes. Ensure the system has enough memory for the new
- *       length per client.
+ * @note Please set client.keepalive, or modify
+ *       :option:`CONFIG_MQTT_KEEPALIVE`, to override the default Keep Alive
+ *       time of 1 minute.
+ * @note The size of the packets that can be sent and received is limited by
+ *       the buffers given to @ref mqtt_client_init.
  */
 int mqtt_connect(struct mqtt_client *client);
 
+/**
+ * @brief API to request new MQTT client connection without waiting for the
+ *        transport to connect.
+ *
+ * @details The transport connection is initiated with a nonblocking socket
+ *          and advanced by @ref mqtt_input, which @ref mqtt_run calls when
+ *          the socket of the client is ready. Once the transport is
+ *          connected, the connection request is sent and
+ *          @ref MQTT_EVT_TRANSPORT_CONNECTED is notified. The result of the
+ *          connection is notified with @ref MQTT_EVT_CONNACK, also when the
+ *          transport fails to connect.
+ *
+ * @param[in] client Client instance for which the procedure is requested.
+ *                   Shall not be NULL.
+ *
+ * @return 0 or a negative error code (errno.h) indicating reason of failure.
+ *         -ENOTSUP if :option:`CONFIG_NET_SOCKETS_OFFLOAD` is enabled.
+ *
+ * @note The notes of @ref mqtt_connect apply. A TLS handshake only proceeds
+ *       without blocking if the socket implementation supports it.
+ * @note The socket is made nonblocking with fcntl(F_SETFL, O_NONBLOCK), which
+ *       the socket implementation must support. Offloaded sockets, such as
+ *       the nRF91 sockets, have no fcntl support, so only @ref mqtt_connect
+ *       can be used with them.
+ */
+int mqtt_connect_async(struct mqtt_client *client);
+
 /**
  * @brief API to publish messages on topics.
  *
@@ -501,10 +795,105 @@ int mqtt_connect(struct mqtt_client *client);
  *                  Shall not be NULL.
  *
  * @return 0 or a negative error code (errno.h) indicating reason of failure.
+ *
+ * @note The message on the topic is written to the transport directly from
+ *       param->message.payload, it is not copied to the client TX buffer.
+ *       Only the topic and the message id are limited by the size of the
+ *       TX buffer.
+ * @note If :option:`CONFIG_MQTT_LIB_QUEUE` is enabled, the message is stored
+ *       in flash when the client is not connected, or while previously
+ *       stored messages are waiting to be sent. Stored messages are sent in
+ *       order from @ref mqtt_live once the client is connected.
+ * @note If :option:`CONFIG_MQTT_LIB_PUBLISH_COALESCING` is enabled, the
+ *       message is copied to a buffer and written to the transport together
+ *       with the following messages, see @ref mqtt_flush. Transport errors
+ *       are then notified with the @ref MQTT_EVT_DISCONNECT event.
  */
 int mqtt_publish(struct mqtt_client *client,
 		 const struct mqtt_publish_param *param);
 
+/**
+ * @brief API to write coalesced publish messages to the transport.
+ *
+ * @details With :option:`CONFIG_MQTT_LIB_PUBLISH_COALESCING`, publish
+ *          messages are collected in a buffer of
+ *          :option:`CONFIG_MQTT_COALESCE_BUFFER_SIZE` bytes and written to
+ *          the transport in one go when the next message does not fit, when
+ *          another packet is sent, after
+ *          :option:`CONFIG_MQTT_COALESCE_FLUSH_TIMEOUT` milliseconds from
+ *          @ref mqtt_live, or when this function is called. Otherwise, this
+ *          function does nothing.
+ *
+ * @param[in] client Client instance for which the procedure is requested.
+ *                   Shall not be NULL.
+ *
+ * @return 0 or a negative error code (errno.h) indicating reason of failure.
+ */
+int mqtt_flush(struct mqtt_client *client);
+
+#if defined(CONFIG_MQTT_LIB_PUBLISH_STREAMING)
+/**
+ * @brief API to read the payload of a received publish message.
+ *
+ * @details With :option:`CONFIG_MQTT_LIB_PUBLISH_STREAMING`, the
+ *          @ref MQTT_EVT_PUBLISH event carries the topic, message id and
+ *          the total payload length in message.payload.len, while
+ *          message.payload.data is NULL. The payload is read in chunks
+ *          directly from the transport into the application buffer, so it
+ *          is not limited by the size of the RX buffer.
+ *
+ * @param[in] client Client instance for which the procedure is requested.
+ *                   Shall not be NULL.
+ * @param[out] buffer Buffer where the payload is stored.
+ *                    Shall not be NULL.
+ * @param[in] length Size of the buffer.
+ *
+ * @return Number of bytes read, 0 if the whole payload was already read or
+ *         a negative error code (errno.h) indicating reason of failure.
+ *
+ * @note Shall only be called from the event callback handling
+ *       @ref MQTT_EVT_PUBLISH. Payload not read when the callback returns is
+ *       discarded.
+ * @note Blocks until at least one byte of the payload is received.
+ */
+int mqtt_read_publish_payload(struct mqtt_client *client, void *buffer,
+			      u32_t length);
+#endif /* CONFIG_MQTT_LIB_PUBLISH_STREAMING */
+
+#if defined(CONFIG_MQTT_LIB_INFLIGHT)
+/**
+ * @brief API to publish a QoS 1 or QoS 2 message tracked by the library.
+ *
+ * @details The message is kept in the client's in-flight window until the
+ *          broker acknowledges it. Publish Release is sent automatically on
+ *          reception of PUBREC. Unacknowledged messages are retransmitted
+ *          with the DUP flag set when the connection is established again,
+ *          and after :option:`CONFIG_MQTT_INFLIGHT_RETRANSMIT_TIMEOUT`
+ *          seconds from @ref mqtt_live. Several messages can be in flight at
+ *          a time, up to :option:`CONFIG_MQTT_INFLIGHT_WINDOW`.
+ *
+ * @param[in] client Client instance for which the procedure is requested.
+ *                   Shall not be NULL.
+ * @param[in] param Parameters to be used for the publish message.
+ *                  Shall not be NULL. If message_id is 0, a free message id
+ *                  is allocated.
+ * @param[in] cb Callback notified when the message is acknowledged.
+ *               Can be NULL.
+ * @param[in] user_data User data passed to the callback.
+ *
+ * @return 0 or a negative error code (errno.h) indicating reason of failure.
+ *         -ENOMEM if the in-flight window is full.
+ *
+ * @note Topic and payload shall remain valid until the callback is notified.
+ * @note In-flight messages are kept when the connection is lost. To retransmit
+ *       them, reconnect the client with @ref mqtt_connect without calling
+ *       @ref mqtt_client_init, which drops them.
+ */
+int mqtt_publish_tracked(struct mqtt_client *client,
+			 const struct mqtt_publish_param *param,
+			 mqtt_publish_done_cb_t cb, void *user_data);
+#endif /* CONFIG_MQTT_LIB_INFLIGHT */
+
 /**
  * @brief API used by client to send acknowledgment on receiving QoS1 publish
  *        message. Should be called on reception of @ref MQTT_EVT_PUBLISH with
@@ -535,7 +924,8 @@ int mqtt_publish_qos2_receive(struct mqtt_client *client,
 
 /**
  * @brief API used by client to request release of QoS2 publish message.
- *        Should be called on reception of @ref MQTT_EVT_PUBREC.
+ *        Should be called on reception of @ref MQTT_EVT_PUBREC, unless
+ *        the MQTT 5.0 Reason Code indicates a failure.
  *
  * @param[in] client Client instance for which the procedure is requested.
  *                   Shall not be NULL.
@@ -624,15 +1014,37 @@ int mqtt_abort(struct mqtt_client *client);
  * @brief This API should be called periodically for the module to be able
  *        to keep the connection alive by sending Ping Requests if need be.
  *
+ * @details A client for which no Ping Response is received within
+ *          :option:`CONFIG_MQTT_PING_RESPONSE_TIMEOUT` of a Ping Request is
+ *          disconnected, and @ref MQTT_EVT_DISCONNECT is notified with
+ *          result -ETIMEDOUT.
+ *
  * @note  Application shall ensure that the periodicity of calling this function
  *        makes it possible to respect the Keep Alive time agreed with the
  *        broker on connection. @ref mqtt_connect for details on Keep Alive
- *        time.
+ *        time. @ref mqtt_run and @ref mqtt_live_timeout give the time
+ *        until this function has work to do.
  *
  * @return 0 or a negative error code (errno.h) indicating reason of failure.
  */
 int mqtt_live(void);
 
+/**
+ * @brief Get the time until @ref mqtt_live has work to do for a client, for
+ *        example sending a Ping Request or detecting a missing Ping
+ *        Response.
+ *
+ * @details Applications polling the transport on their own can use this as
+ *          the poll timeout instead of calling @ref mqtt_live periodically.
+ *
+ * @param[in] client Client instance for which the procedure is requested.
+ *                   Shall not be NULL.
+ *
+ * @return Time in milliseconds, K_FOREVER if nothing is due, or -EINVAL if
+ *         client is NULL.
+ */
+s32_t mqtt_live_timeout(struct mqtt_client *client);
+
 /**
  * @brief Receive an incoming MQTT packet. The registered callback will be
  *        called with the packet payload.
@@ -646,6 +1058,158 @@ int mqtt_live(void);
  */
 int mqtt_input(struct mqtt_client *client);
 
+/**
+ * @brief Wait until incoming data is available for any connected client, the
+ *        transport of a client connecting with @ref mqtt_connect_async is
+ *        ready, or until @ref mqtt_live has work to do, for example sending
+ *        a Ping Request.
+ *
+ * @details The transports of all clients are polled, with the time until the
+ *          next Keep Alive deadline as the timeout, so that the application
+ *          can sleep between events instead of calling @ref mqtt_input and
+ *          @ref mqtt_live in a loop.
+ *
+ * @param[in] timeout Maximum time to wait, in milliseconds, or K_FOREVER.
+ *
+ * @return Number of clients that are ready, 0 if the timeout expired or
+ *         a negative error code (errno.h) indicating reason of failure.
+ *         -ENOTCONN if no client is connected.
+ */
+int mqtt_wait(s32_t timeout);
+
+/**
+ * @brief Wait for events as in @ref mqtt_wait, then call @ref mqtt_input for
+ *        each client that is ready, and @ref mqtt_live.
+ *
+ * @details Calling this function in a loop is enough to handle all clients.
+ *
+ * @param[in] timeout Maximum time to wait, in milliseconds, or K_FOREVER.
+ *
+ * @return 0 or a negative error code (errno.h) indicating reason of failure.
+ *         -ENOTCONN if no client is connected.
+ */
+int mqtt_run(s32_t timeout);
+
+#if defined(CONFIG_MQTT_LIB_TOPIC_TRIE)
+/**
+ * @brief Handler of received publish messages matching a topic filter.
+ *
+ * @param[in] client Identifies the client that received the message.
+ * @param[in] param Parameters of the received publish message.
+ * @param[in] user_data User data given to @ref mqtt_topic_trie_add.
+ */
+typedef void (*mqtt_topic_handler_t)(struct mqtt_client *client,
+				     const struct mqtt_publish_param *param,
+				     void *user_data);
+
+/** @brief Node of a topic trie, holding one level of a topic filter. */
+struct mqtt_topic_node {
+	/** Topic level, pointing into a registered filter. NULL if the node
+	 *  is free.
+	 */
+	const u8_t *level;
+
+	/** Length of the topic level. */
+	u32_t level_len;
+
+	/** First node of the next level. */
+	struct mqtt_topic_node *child;
+
+	/** Next node of the same level. */
+	struct mqtt_topic_node *sibling;
+
+	/** Filter ending at this node. Only valid if handler is not NULL. */
+	struct mqtt_utf8 filter;
+
+	/** Handler of the filter ending at this node, or NULL. */
+	mqtt_topic_handler_t handler;
+
+	/** User data passed to the handler. */
+	void *user_data;
+};
+
+/** @brief Trie of topic filters. */
+struct mqtt_topic_trie {
+	/** Nodes available to the trie. */
+	struct mqtt_topic_node *nodes;
+
+	/** Number of nodes available to the trie. */
+	u32_t node_count;
+
+	/** First node of the first level. */
+	struct mqtt_topic_node *root;
+};
+
+/**
+ * @brief Initialize a topic trie.
+ *
+ * @details A filter uses one node per topic level, and filters share the
+ *          nodes of their common leading levels.
+ *
+ * @param[out] trie Trie to initialize. Shall not be NULL.
+ * @param[in] nodes Nodes used by the trie. Shall not be NULL.
+ * @param[in] node_count Number of nodes.
+ */
+void mqtt_topic_trie_init(struct mqtt_topic_trie *trie,
+			  struct mqtt_topic_node *nodes, u32_t node_count);
+
+/**
+ * @brief Register the handler of a topic filter.
+ *
+ * @param[inout] trie Trie to which the filter is added. Shall not be NULL.
+ * @param[in] filter Topic filter, which may contain the + and # wildcards.
+ *                   Shall not be NULL.
+ * @param[in] handler Handler of publish messages matching the filter.
+ *                    Shall not be NULL.
+ * @param[in] user_data User data passed to the handler.
+ *
+ * @return 0 or a negative error code (errno.h) indicating reason of failure.
+ *         -EINVAL if the filter is not valid, -EEXIST if the filter is
+ *         already registered and -ENOMEM if there are not enough free nodes.
+ *
+ * @note The filter shall remain valid until it is removed.
+ */
+int mqtt_topic_trie_add(struct mqtt_topic_trie *trie,
+			const struct mqtt_utf8 *filter,
+			mqtt_topic_handler_t handler, void *user_data);
+
+/**
+ * @brief Remove the handler of a topic filter.
+ *
+ * @param[inout] trie Trie from which the filter is removed. Shall not be NULL.
+ * @param[in] filter Topic filter, as given to @ref mqtt_topic_trie_add.
+ *                   Shall not be NULL.
+ *
+ * @return 0 or a negative error code (errno.h) indicating reason of failure.
+ *         -ENOENT if the filter is not registered.
+ */
+int mqtt_topic_trie_remove(struct mqtt_topic_trie *trie,
+			   const struct mqtt_utf8 *filter);
+
+/**
+ * @brief Call the handlers of all filters matching the topic of a received
+ *        publish message. Should be called on reception of
+ *        @ref MQTT_EVT_PUBLISH.
+ *
+ * @details Topics starting with $ are not matched by filters starting with
+ *          a wildcard, and a filter ending with # also matches its parent
+ *          level, as specified by MQTT.
+ *
+ * @param[in] trie Trie of registered filters. Shall not be NULL.
+ * @param[in] client Client that received the message, passed to the handlers.
+ * @param[in] param Parameters of the received publish message.
+ *                  Shall not be NULL.
+ *
+ * @return Number of handlers called.
+ *
+ * @note The trie shall not be modified by the handlers. The application
+ *       serializes access to the trie.
+ */
+int mqtt_topic_trie_dispatch(const struct mqtt_topic_trie *trie,
+			     struct mqtt_client *client,
+			     const struct mqtt_publish_param *param);
+#endif /* CONFIG_MQTT_LIB_TOPIC_TRIE */
+
 #ifdef __cplusplus
 }
 #endif
@@ -207,6 +207,69 @@ struct nrf_esb_payload {
 struct nrf_esb_evt {
 	enum nrf_esb_evt_id evt_id;	/**< Enhanced ShockBurst event ID. */
 	u32_t tx_attempts;	/**< Number of TX retransmission attempts. */
+	/** Payload queued with @ref nrf_esb_write_payload_nocopy that is
+	 *  returned to the application with this TX event, or NULL.
+	 */
+	struct nrf_esb_payload *payload;
+};
+
+/** Number of bins in @ref nrf_esb_pipe_stats::tx_attempts_hist. */
+#define NRF_ESB_STATS_ATTEMPTS_BINS 8
+
+/** @brief Enhanced ShockBurst link statistics of a pipe.
+ *
+ *  Transmission counters are updated in PTX mode, reception counters in PRX
+ *  mode. The packet error rate of acknowledged packets is
+ *  (tx_attempts - tx_success) / tx_attempts.
+ */
+struct nrf_esb_pipe_stats {
+	u32_t tx_success;	/**< Acknowledged packets. */
+	u32_t tx_failed;	/**< Packets that ran out of retransmits. */
+	u32_t tx_noack;		/**< Packets sent without ACK request. */
+	u32_t tx_attempts;	/**< Transmission attempts of packets that
+				  *  requested an ACK.
+				  */
+	/** Acknowledged packets by number of attempts. Bin n counts packets
+	 *  acknowledged at attempt n + 1; the last bin also counts all packets
+	 *  that needed more attempts.
+	 */
+	u32_t tx_attempts_hist[NRF_ESB_STATS_ATTEMPTS_BINS];
+	/** Moving average of attempts per packet, in 1/256 units. */
+	u32_t tx_attempts_avg;
+	u32_t rx_received;	/**< Received packets. */
+	u32_t rx_duplicates;	/**< Received retransmits of packets that
+				  *  were already received.
+				  */
+	/** Moving average of RSSI of received packets and ACKs, in the same
+	 *  unit as @ref nrf_esb_payload::rssi.
+	 */
+	u8_t rssi_avg;
+};
+
+/** @brief Stages of a transmission measured by latency tracing. */
+enum nrf_esb_latency_stage {
+	/** From writing a payload until the radio is enabled to send it. */
+	NRF_ESB_LATENCY_QUEUE,
+	/** From enabling the radio until the end of the last attempt to send
+	 *  the packet, including ramp-up and retransmits.
+	 */
+	NRF_ESB_LATENCY_RADIO,
+	/** From the end of the packet until its ACK is received. */
+	NRF_ESB_LATENCY_ACK,
+	/** From a TX completion or a packet reception until the events are
+	 *  delivered to the event handler.
+	 */
+	NRF_ESB_LATENCY_EVENT,
+	/** Number of stages. */
+	NRF_ESB_LATENCY_STAGE_COUNT
+};
+
+/** @brief Latency statistics of a stage. */
+struct nrf_esb_latency_stats {
+	u32_t count;	/**< Number of measurements. */
+	u32_t min_us;	/**< Shortest duration, in microseconds. */
+	u32_t avg_us;	/**< Average duration, in microseconds. */
+	u32_t max_us;	/**< Longest duration, in microseconds. */
 };
 
 /** @brief Definition of the event handler for the module. */
@@ -268,7 +331,10 @@ int nrf_esb_suspend(void);
  *  Calling this function disables the Enhanced ShockBurst module immediately.
  *  Doing so might stop ongoing communications.
  *
- *  @note All queues are flushed by this function.
+ *  @note All queues are flushed by this function. Payloads queued with
+ *        @ref nrf_esb_write_payload_nocopy are returned to the application
+ *        in @ref NRF_ESB_EVENT_TX_FAILED events before this function
+ *        returns.
  *
  */
 void nrf_esb_disable(void);
@@ -293,6 +359,56 @@ bool nrf_esb_is_idle(void);
  */
 int nrf_esb_write_payload(const struct nrf_esb_payload *payload);
 
+/** @brief Queue an application-owned payload without copying it.
+ *
+ *  Works like @ref nrf_esb_write_payload, but the TX FIFO only keeps a
+ *  reference to @p payload. The buffer is owned by the module until it is
+ *  returned in the @c payload field of an @ref NRF_ESB_EVENT_TX_SUCCESS or
+ *  @ref NRF_ESB_EVENT_TX_FAILED event; one event is generated for each
+ *  returned buffer. Unlike copied payloads, a lent payload is removed from
+ *  the TX FIFO when its transmission fails. Buffers that are still queued
+ *  when they are removed with @ref nrf_esb_flush_tx, @ref nrf_esb_pop_tx or
+ *  @ref nrf_esb_disable are returned in an @ref NRF_ESB_EVENT_TX_FAILED
+ *  event.
+ *
+ *  @param[in,out] payload	The payload. The module sets its PID.
+ *
+ * @retval 0 If successful.
+ *           Otherwise, a (negative) error code is returned.
+ */
+int nrf_esb_write_payload_nocopy(struct nrf_esb_payload *payload);
+
+/** @brief Write an ACK payload for a specific pipe.
+ *
+ *  In PRX mode, every pipe has its own queue of ACK payloads, with
+ *  @ref CONFIG_NRF_ESB_ACK_PAYLOAD_FIFO_SIZE entries. The payload is
+ *  attached to the acknowledgment of the next packet received on
+ *  @c payload->pipe, so a busy pipe does not delay the ACK payloads of the
+ *  other pipes. An @ref NRF_ESB_EVENT_TX_SUCCESS event is generated when
+ *  the PTX on that pipe has received the payload. In PRX mode,
+ *  @ref nrf_esb_write_payload queues the payload in the same way.
+ *
+ *  @param[in]   payload     The payload.
+ *
+ * @retval 0 If successful.
+ * @retval -ENOMEM If the queue of the pipe is full.
+ * @retval -EPERM If the module is not in PRX mode.
+ *           Otherwise, a (negative) error code is returned.
+ */
+int nrf_esb_write_ack_payload(const struct nrf_esb_payload *payload);
+
+/** @brief Flush the ACK payload queue of a pipe.
+ *
+ *  Payloads queued with @ref nrf_esb_write_payload_nocopy are returned in
+ *  @ref NRF_ESB_EVENT_TX_FAILED events.
+ *
+ *  @param[in] pipe	Pipe.
+ *
+ * @retval 0 If successful.
+ *           Otherwise, a (negative) error code is returned.
+ */
+int nrf_esb_flush_ack_payloads(u8_t pipe);
+
 /** @brief Read a payload.
  *
  *  @param[in,out] payload	The payload to be received.
@@ -302,6 +418,19 @@ int nrf_esb_write_payload(const struct nrf_esb_payload *payload);
  */
 int nrf_esb_read_rx_payload(struct nrf_esb_payload *payload);
 
+/** @brief Read multiple payloads.
+ *
+ *  Drains up to @p max payloads from the RX FIFO while interrupts are locked
+ *  only once.
+ *
+ *  @param[out] payloads	Array for the received payloads.
+ *  @param[in]  max		Number of elements in @p payloads.
+ *
+ *  @return Number of payloads read (zero if the RX FIFO is empty) or
+ *          (negative) error code otherwise.
+ */
+int nrf_esb_read_rx_payloads(struct nrf_esb_payload *payloads, size_t max);
+
 /** @brief Start transmitting data.
  *
  * @retval 0 If successful.
@@ -325,16 +454,25 @@ int nrf_esb_stop_rx(void);
 
 /** @brief Flush the TX buffer.
  *
- * This function clears the TX FIFO buffer.
+ * This function clears the TX FIFO buffer and the ACK payload queues of all
+ * pipes. Payloads queued with @ref nrf_esb_write_payload_nocopy are returned
+ * in @ref NRF_ESB_EVENT_TX_FAILED events.
  *
  * @retval 0 If successful.
  *           Otherwise, a (negative) error code is returned.
  */
 int nrf_esb_flush_tx(void);
 
-/** @brief Pop the first item from the TX buffer.
+/** @brief Pop the last written item from the TX buffer.
+ *
+ * A payload queued with @ref nrf_esb_write_payload_nocopy is returned in an
+ * @ref NRF_ESB_EVENT_TX_FAILED event.
+ *
+ * Only supported in PTX mode. In PRX mode, use
+ * @ref nrf_esb_flush_ack_payloads to remove the ACK payloads of a pipe.
  *
  * @retval 0 If successful.
+ * @retval -ENOTSUP If the module is in PRX mode.
  *           Otherwise, a (negative) error code is returned.
  */
 int nrf_esb_pop_tx(void);
@@ -426,7 +564,56 @@ int nrf_esb_update_prefix(u8_t pipe, u8_t prefix);
  */
 int nrf_esb_set_rf_channel(u32_t channel);
 
+/** @brief Set the frequency hop table.
+ *
+ *  Requires @ref CONFIG_NRF_ESB_HOPPING. The PTX and the PRX must use the
+ *  same table. Operation starts on the first channel of the table.
+ *
+ *  In PTX mode, the next channel of the table is used after
+ *  @ref CONFIG_NRF_ESB_HOPPING_PTX_ATTEMPTS attempts without ACK, so that
+ *  retransmissions sweep the table until the PRX is found. Configure enough
+ *  retransmissions to cover the whole table. In PRX mode, the next channel
+ *  is used when no packet has been received for
+ *  @ref CONFIG_NRF_ESB_HOPPING_PRX_TIMEOUT_MS.
+ *
+ *  The module must be in an idle state to call this function.
+ *
+ *  @param[in] channels	Channels of the hop table.
+ *  @param[in] count	Number of channels. Zero disables hopping.
+ *
+ * @retval 0 If successful.
+ *           Otherwise, a (negative) error code is returned.
+ */
+int nrf_esb_set_hop_table(const u8_t *channels, u8_t count);
+
+/** @brief Set duty-cycled RX.
+ *
+ *  Requires @ref CONFIG_NRF_ESB_RX_DUTY_CYCLE. Instead of listening
+ *  continuously after @ref nrf_esb_start_rx, the PRX enables the radio
+ *  for an RX window at the start of every period. The windows are timed by
+ *  the ESB system timer and PPI, without waking up the CPU.
+ *
+ *  A PTX reaches the PRX if its retransmissions span at least one period,
+ *  that is, if the retransmit delay times the number of attempts is larger
+ *  than the period, and the retransmit delay is shorter than the window.
+ *
+ *  RX event moderation is not used in duty-cycled RX.
+ *
+ *  The module must be in an idle state to call this function.
+ *
+ *  @param[in] period_ms	Period of the RX windows, in milliseconds. Zero
+ *				disables duty-cycled RX.
+ *  @param[in] window_us	Length of an RX window, in microseconds. Must
+ *				be shorter than the period.
+ *
+ * @retval 0 If successful.
+ *           Otherwise, a (negative) error code is returned.
+ */
+int nrf_esb_set_rx_duty_cycle(u32_t period_ms, u32_t window_us);
+
 /** @brief Get the current radio channel.
+ *
+ *  When frequency hopping is used, this is the channel currently in use.
  *
  *  @param[in, out] channel	Channel number.
  *
@@ -445,6 +632,12 @@ int nrf_esb_get_rf_channel(u32_t *channel);
 int nrf_esb_set_tx_power(enum nrf_esb_tx_power tx_output_power);
 
 /** @brief Set the packet retransmit delay.
+ *
+ *  When @ref CONFIG_NRF_ESB_ADAPTIVE_RETRANSMIT is enabled, this is the
+ *  smallest delay that the adaptive retransmit control uses. A delay above
+ *  @ref CONFIG_NRF_ESB_ADAPTIVE_RETRANSMIT_DELAY_MAX is kept as is.
+ *  Setting the delay restores the retransmit count set with
+ *  @ref nrf_esb_set_retransmit_count.
  *
  *  @param[in] delay	Delay between retransmissions.
  *
@@ -454,6 +647,11 @@ int nrf_esb_set_tx_power(enum nrf_esb_tx_power tx_output_power);
 int nrf_esb_set_retransmit_delay(u16_t delay);
 
 /** @brief Set the number of retransmission attempts.
+ *
+ *  When @ref CONFIG_NRF_ESB_ADAPTIVE_RETRANSMIT is enabled, this is the
+ *  smallest count that the adaptive retransmit control uses. Setting the
+ *  count restores the retransmit delay set with
+ *  @ref nrf_esb_set_retransmit_delay.
  *
  *  @param[in] count	Number of retransmissions.
  *
@@ -485,6 +683,57 @@ int nrf_esb_set_bitrate(enum nrf_esb_bitrate bitrate);
  */
 int nrf_esb_reuse_pid(u8_t pipe);
 
+/** @brief Get the link statistics of a pipe.
+ *
+ *  Requires @ref CONFIG_NRF_ESB_STATS.
+ *
+ *  @param[in]  pipe	Pipe.
+ *  @param[out] stats	Statistics.
+ *
+ * @retval 0 If successful.
+ *           Otherwise, a (negative) error code is returned.
+ */
+int nrf_esb_get_pipe_stats(u8_t pipe, struct nrf_esb_pipe_stats *stats);
+
+/** @brief Reset the link statistics of a pipe.
+ *
+ *  Requires @ref CONFIG_NRF_ESB_STATS.
+ *
+ *  @param[in] pipe	Pipe.
+ *
+ * @retval 0 If successful.
+ *           Otherwise, a (negative) error code is returned.
+ */
+int nrf_esb_reset_pipe_stats(u8_t pipe);
+
+/** @brief Get the latency statistics of a stage.
+ *
+ *  Requires @ref CONFIG_NRF_ESB_LATENCY_TRACE.
+ *
+ *  @param[in]  stage	Stage.
+ *  @param[out] stats	Statistics.
+ *
+ * @retval 0 If successful.
+ *           Otherwise, a (negative) error code is returned.
+ */
+int nrf_esb_get_latency_stats(enum nrf_esb_latency_stage stage,
+			      struct nrf_esb_latency_stats *stats);
+
+/** @brief Reset the latency statistics of all stages.
+ *
+ *  Requires @ref CONFIG_NRF_ESB_LATENCY_TRACE.
+ */
+void nrf_esb_reset_latency_stats(void);
+
+/** @brief Send the latency statistics of all stages to the profiler.
+ *
+ *  One esb_latency event is logged for each stage. The function must be
+ *  called from a thread.
+ *
+ *  Requires @ref CONFIG_NRF_ESB_LATENCY_TRACE and @ref CONFIG_PROFILER.
+ */
+void nrf_esb_log_latency_stats(void);
+
 /** @} */
 
 #ifdef __cplusplus
@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2018 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+#ifndef __NRF_ESB_FRAG_H
+#define __NRF_ESB_FRAG_H
+
+#include <nrf_esb.h>
+#include <stdbool.h>
+#include <zephyr/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @defgroup nrf_esb_frag Enhanced ShockBurst fragmentation
+ * @{
+ * @ingroup nrf_esb
+ *
+ * @brief Transport layer that sends messages larger than
+ *        @ref CONFIG_NRF_ESB_MAX_PAYLOAD_LENGTH over Enhanced ShockBurst.
+ *
+ * Messages are split into fragments that are queued in the TX FIFO without
+ * waiting for the acknowledgment of each fragment. The receiver reassembles
+ * the fragments in one buffer per pipe. The layer requires the
+ * @ref NRF_ESB_PROTOCOL_ESB_DPL protocol, and all packets exchanged through
+ * the ESB module must be sent with this layer.
+ */
+
+/** Size of the header that is added to each fragment. */
+#define NRF_ESB_FRAG_HEADER_SIZE 3
+
+/** Maximum number of message bytes carried by one fragment. */
+#define NRF_ESB_FRAG_DATA_SIZE \
+	(CONFIG_NRF_ESB_MAX_PAYLOAD_LENGTH - NRF_ESB_FRAG_HEADER_SIZE)
+
+/** @brief Fragmentation layer event IDs. */
+enum nrf_esb_frag_evt_id {
+	/** All fragments of the message have been sent. */
+	NRF_ESB_FRAG_EVENT_TX_SUCCESS,
+	/** A fragment of the message could not be sent. */
+	NRF_ESB_FRAG_EVENT_TX_FAILED,
+	/** A complete message has been received. */
+	NRF_ESB_FRAG_EVENT_RX_RECEIVED,
+};
+
+/** @brief Fragmentation layer event. */
+struct nrf_esb_frag_evt {
+	enum nrf_esb_frag_evt_id evt_id; /**< Event ID. */
+	u8_t pipe;			/**< Pipe of the message. */
+	/** Message data. For received messages, the data is only valid
+	 *  until the event handler returns.
+	 */
+	const u8_t *data;
+	size_t length;			/**< Length of the message. */
+};
+
+/** @brief Event handler prototype. */
+typedef void (*nrf_esb_frag_event_handler_t)(
+	const struct nrf_esb_frag_evt *event);
+
+/** @brief Initialize the fragmentation layer.
+ *
+ *  Any message that is being sent or received is discarded.
+ *
+ *  @param[in] event_handler	Event handler.
+ *
+ * @retval 0 If successful.
+ *           Otherwise, a (negative) error code is returned.
+ */
+int nrf_esb_frag_init(nrf_esb_frag_event_handler_t event_handler);
+
+/** @brief Send a message.
+ *
+ *  The message is split into fragments of at most
+ *  @ref NRF_ESB_FRAG_DATA_SIZE bytes, which are queued with
+ *  @ref nrf_esb_write_payload_nocopy as long as there is room in the TX
+ *  FIFO. More fragments are queued as the previous ones are acknowledged.
+ *  The data is not copied and must stay valid until the
+ *  @ref NRF_ESB_FRAG_EVENT_TX_SUCCESS or @ref NRF_ESB_FRAG_EVENT_TX_FAILED
+ *  event. Only one message can be sent at a time.
+ *
+ *  If a fragment fails, the TX FIFO is flushed and
+ *  @ref NRF_ESB_FRAG_EVENT_TX_FAILED is generated.
+ *
+ *  @param[in] pipe	Pipe.
+ *  @param[in] data	Message data.
+ *  @param[in] length	Length of the message, at most
+ *			@ref CONFIG_NRF_ESB_FRAG_MAX_MESSAGE_SIZE bytes.
+ *  @param[in] noack	Send the fragments without requesting an ACK.
+ *
+ * @retval 0 If successful.
+ * @retval -EBUSY If a message is already being sent.
+ * @retval -EMSGSIZE If the length of the message is invalid.
+ *           Otherwise, a (negative) error code is returned.
+ */
+int nrf_esb_frag_send(u8_t pipe, const u8_t *data, size_t length,
+		      bool noack);
+
+/** @brief Process an Enhanced ShockBurst event.
+ *
+ *  Call this function from the @ref nrf_esb_event_handler of the
+ *  application for every event. On @ref NRF_ESB_EVENT_RX_RECEIVED, the RX
+ *  FIFO is emptied and the fragments are reassembled.
+ *
+ *  @param[in] event	Enhanced ShockBurst event.
+ *
+ *  @retval true If the event was consumed by the fragmentation layer.
+ *  @retval false If the event concerns a payload that was not sent by the
+ *                fragmentation layer.
+ */
+bool nrf_esb_frag_process_event(const struct nrf_esb_evt *event);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __NRF_ESB_FRAG_H */
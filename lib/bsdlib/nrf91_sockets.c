@@ -120,6 +120,11 @@ static int z_to_nrf_optname(int z_in_optname, int *nrf_out_optname)
 	case TLS_DTLS_ROLE:
 		*nrf_out_optname = NRF_SO_SEC_ROLE;
 		break;
+#if defined(TLS_SESSION_CACHE) && defined(NRF_SO_SEC_SESSION_CACHE)
+	case TLS_SESSION_CACHE:
+		*nrf_out_optname = NRF_SO_SEC_SESSION_CACHE;
+		break;
+#endif
 	default:
 		retval = -1;
 	}
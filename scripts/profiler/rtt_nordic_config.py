@@ -11,5 +11,5 @@ RttNordicConfig = {
     'byteorder': 'little',
     'reset_on_start': False,
     'connection_timeout': -1,
-    'timestamp_raw_max': 2**32 #timestamp on uC is stored as 32-bit value
+    'timestamp_raw_max': 2**32 #event timestamp holds low 32 bits of 64-bit value
 }
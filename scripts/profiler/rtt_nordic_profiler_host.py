@@ -21,6 +21,9 @@ class Command(Enum):
 
 class RttNordicProfilerHost:
 
+    # Event type ID reserved by device for 64-bit timestamp epoch records
+    EPOCH_ID = 0xFF
+
     def __init__(self, config=RttNordicConfig, finish_event=None,
                  queue=None, event_filename=None,
                  event_types_filename=None, log_lvl=logging.WARNING):
@@ -30,8 +33,7 @@ class RttNordicProfilerHost:
         self.finish_event = finish_event
         self.queue = queue
         self.received_events = EventsData([], {})
-        self.timestamp_overflows = 0
-        self.after_half = False
+        self.timestamp_epoch = None
         self.logger = logging.getLogger('RTT Profiler Host')
         self.logger_console = logging.StreamHandler()
         self.logger.setLevel(log_lvl)
@@ -116,8 +118,21 @@ class RttNordicProfilerHost:
         return buf
 
     def _calculate_timestamp_from_clock_ticks(self, clock_ticks):
-        return self.config['ms_per_timestamp_tick'] * (
-            clock_ticks + self.timestamp_overflows * self.config['timestamp_raw_max']) / 1000
+        return self.config['ms_per_timestamp_tick'] * clock_ticks / 1000
+
+    def _extend_timestamp(self, timestamp_raw):
+        # Event timestamp holds low 32 bits of device's 64-bit timestamp.
+        # Device sends epoch record with full timestamp before any event
+        # that is too far from previous epoch, so event is placed at
+        # signed 32-bit distance from last epoch.
+        if self.timestamp_epoch is None:
+            self.logger.warning("Event received before timestamp epoch")
+            self.timestamp_epoch = timestamp_raw
+        raw_max = self.config['timestamp_raw_max']
+        delta = (timestamp_raw - self.timestamp_epoch) % raw_max
+        if delta >= raw_max // 2:
+            delta -= raw_max
+        return self.timestamp_epoch + delta
 
     def _read_single_event_description(self):
         buf = self._read_char(self.config['rtt_info_channel'])
@@ -166,6 +181,15 @@ class RttNordicProfilerHost:
                 1),
             byteorder=self.config['byteorder'],
             signed=False)
+
+        if id == self.EPOCH_ID:
+            buf = self._read_bytes(self.config['rtt_data_channel'], 8)
+            self.timestamp_epoch = int.from_bytes(
+                buf,
+                byteorder=self.config['byteorder'],
+                signed=False)
+            return None
+
         et = self.received_events.registered_events_types[id]
 
         buf = self._read_bytes(self.config['rtt_data_channel'], 4)
@@ -175,15 +199,8 @@ class RttNordicProfilerHost:
                 byteorder=self.config['byteorder'],
                 signed=False))
 
-        if self.after_half and timestamp_raw < 0.2 * self.config['timestamp_raw_max']:
-            self.timestamp_overflows += 1
-            self.after_half = False
-
-        if timestamp_raw > 0.6 * \
-                self.config['timestamp_raw_max'] and timestamp_raw < 0.9 * self.config['timestamp_raw_max']:
-            self.after_half = True
-
-        timestamp = self._calculate_timestamp_from_clock_ticks(timestamp_raw)
+        timestamp = self._calculate_timestamp_from_clock_ticks(
+            self._extend_timestamp(timestamp_raw))
 
         data = []
         for i in et.data_types:
@@ -201,9 +218,10 @@ class RttNordicProfilerHost:
         current_time = start_time
         while current_time - start_time < time_seconds or time_seconds < 0:
             event = self._read_single_event_rtt()
-            self.received_events.events.append(event)
-            if self.queue is not None:
-                self.queue.put(event)
+            if event is not None:
+                self.received_events.events.append(event)
+                if self.queue is not None:
+                    self.queue.put(event)
             current_time = time.time()
         self.stop_logging_events()
 
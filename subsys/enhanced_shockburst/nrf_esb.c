@@ -5,10 +5,12 @@
  */
 #include <errno.h>
 #include <irq.h>
+#include <kernel.h>
 #include <misc/byteorder.h>
 #include <nrf.h>
 #include <nrf_common.h>
 #include <nrf_esb.h>
+#include <profiler.h>
 #include <stddef.h>
 #include <string.h>
 
@@ -109,6 +111,11 @@ enum esb_state {
 	ESB_STATE_PRX_SEND_ACK, /* Transmitting ACK in RX mode. */
 };
 
+/* Number of payloads lent by the application that can be in the driver. */
+#define TX_RELEASED_SIZE                                                       \
+	(CONFIG_NRF_ESB_TX_FIFO_SIZE +                                         \
+	 CONFIG_NRF_ESB_PIPE_COUNT * CONFIG_NRF_ESB_ACK_PAYLOAD_FIFO_SIZE)
+
 /* Pipe info PID and CRC and acknowledgment payload. */
 struct pipe_info {
 	u16_t crc;	  /* CRC of the last received packet.
@@ -130,6 +137,28 @@ struct payload_tx_fifo {
 	u32_t count;	/* Number of elements in the queue. */
 };
 
+/* First-in, first-out queue of ACK payloads for a single pipe (PRX). */
+struct payload_ack_fifo {
+	 /* Payload queue */
+	struct nrf_esb_payload *payload[CONFIG_NRF_ESB_ACK_PAYLOAD_FIFO_SIZE];
+
+	u32_t back;	/* Back of the queue (last in). */
+	u32_t front;	/* Front of queue (first out). */
+	u32_t count;	/* Number of elements in the queue. */
+};
+
+/* Payloads lent by the application that are ready to be returned to it. */
+struct payload_tx_released {
+	struct {
+		struct nrf_esb_payload *payload;
+		enum nrf_esb_evt_id evt_id;
+	} entry[TX_RELEASED_SIZE];
+
+	u32_t back;	/* Back of the queue (last in). */
+	u32_t front;	/* Front of queue (first out). */
+	u32_t count;	/* Number of elements in the queue. */
+};
+
 /* First-in, first-out queue of received payloads. */
 struct payload_rx_fifo {
 	 /* Payload queue */
@@ -181,10 +210,24 @@ static struct nrf_esb_payload *current_payload;
 
 /* FIFOs and buffers */
 static struct payload_tx_fifo tx_fifo;
+static struct payload_tx_released tx_released;
 static struct payload_rx_fifo rx_fifo;
-static u8_t tx_payload_buffer[CONFIG_NRF_ESB_MAX_PAYLOAD_LENGTH + 2];
+static struct nrf_esb_payload tx_payload_storage[CONFIG_NRF_ESB_TX_FIFO_SIZE];
+static struct payload_ack_fifo ack_fifo[CONFIG_NRF_ESB_PIPE_COUNT];
+static struct nrf_esb_payload
+	ack_payload_storage[CONFIG_NRF_ESB_PIPE_COUNT]
+			   [CONFIG_NRF_ESB_ACK_PAYLOAD_FIFO_SIZE];
 static u8_t rx_payload_buffer[CONFIG_NRF_ESB_MAX_PAYLOAD_LENGTH + 2];
 
+/* Two alternating on-air TX buffers. While the radio sends from one of them,
+ * the next no-ACK packet in the TX FIFO is prepared in the other one.
+ */
+static u8_t tx_payload_buffers[2][CONFIG_NRF_ESB_MAX_PAYLOAD_LENGTH + 2];
+static u8_t tx_buffer_index;
+static u8_t *tx_payload_buffer = tx_payload_buffers[0];
+static volatile bool tx_next_prepared;
+static volatile bool tx_next_started;
+
 /* Run time variables */
 static u8_t pids[CONFIG_NRF_ESB_PIPE_COUNT];
 static struct pipe_info rx_pipe_info[CONFIG_NRF_ESB_PIPE_COUNT];
@@ -192,22 +235,101 @@ static volatile u32_t interrupt_flags;
 static volatile u32_t retransmits_remaining;
 static volatile u32_t last_tx_attempts;
 static volatile u32_t wait_for_ack_timeout_us;
+static volatile u32_t rx_unreported;
 
 static u32_t radio_shorts_common = RADIO_SHORTS_COMMON;
 
+#ifdef CONFIG_NRF_ESB_STATS
+/* Weight of a new sample in the moving averages, as a power of two. */
+#define STATS_AVG_SHIFT 3
+
+/* Link statistics of a pipe. Moving averages are kept in 1/256 units. */
+struct pipe_stats {
+	struct nrf_esb_pipe_stats counters;
+	u32_t rssi_avg;
+	u32_t tx_attempts_avg;
+};
+
+static struct pipe_stats pipe_stats[CONFIG_NRF_ESB_PIPE_COUNT];
+#endif
+
+#ifdef CONFIG_NRF_ESB_LATENCY_TRACE
+/* Durations of a stage, in hardware cycles. */
+struct latency_stage {
+	u32_t count;
+	u32_t min;
+	u32_t max;
+	u64_t sum;
+};
+
+static struct latency_stage latency_stages[NRF_ESB_LATENCY_STAGE_COUNT];
+
+static struct {
+	u32_t written[CONFIG_NRF_ESB_TX_FIFO_SIZE]; /* Per TX FIFO entry. */
+	u32_t tx_enabled;	/* Radio enabled for the packet in flight. */
+	u32_t tx_sent;		/* Last attempt of the packet in flight. */
+	u32_t event_raised;	/* Oldest event not delivered yet. */
+	bool event_pending;
+} latency;
+#endif
+
+#ifdef CONFIG_NRF_ESB_HOPPING
+static void hopping_prx_timeout(struct k_timer *timer);
+
+static K_TIMER_DEFINE(hopping_prx_timer, hopping_prx_timeout, NULL);
+
+static struct {
+	u8_t table[CONFIG_NRF_ESB_HOPPING_TABLE_MAX_SIZE]; /* Channels. */
+	u8_t count;		/* Number of channels in the table. */
+	u8_t index;		/* Index of the channel in use. */
+	u8_t misses;		/* PTX attempts without ACK on the channel. */
+	volatile bool rx_seen;	/* PRX received a packet in this period. */
+	volatile bool switch_pending; /* PRX channel timeout not handled. */
+} hopping;
+#endif
+
+#ifdef CONFIG_NRF_ESB_RX_DUTY_CYCLE
+static struct {
+	u32_t period_us;	/* Period of the RX windows, or 0. */
+	u32_t window_us;	/* Length of an RX window. */
+} rx_duty;
+#endif
+
+#ifdef CONFIG_NRF_ESB_ADAPTIVE_RETRANSMIT
+/* Number of acknowledged transmissions between two adaptations. */
+#define ADAPTIVE_PERIOD 8
+/* Average number of attempts (in 1/256 units) above which retransmissions
+ * are made more robust, and below which they are made faster again.
+ */
+#define ADAPTIVE_ATTEMPTS_HIGH (2 * 256)
+#define ADAPTIVE_ATTEMPTS_LOW (256 + 64)
+
+static struct {
+	u16_t base_delay;	/* Retransmit delay set by the application. */
+	u16_t base_count;	/* Retransmit count set by the application. */
+	u32_t attempts_avg;	/* Average attempts of all pipes (1/256). */
+	u32_t samples;		/* Transmissions since last adaptation. */
+	bool failed;		/* Transmission failed since last adaptation. */
+} adaptive;
+#endif
+
 /* These function pointers are changed dynamically, depending on protocol
  * configuration and state. Note that they will be 0 initialized.
  */
 static void (*on_radio_disabled)(void);
+static void (*on_radio_address)(void);
 static void (*on_radio_end)(void);
 static void (*update_rf_payload_format)(u32_t payload_length);
 
 /*  The following functions are assigned to the function pointers above. */
 static void on_radio_disabled_tx_noack(void);
+static void on_radio_address_tx_noack(void);
+static void on_radio_end_tx_noack(void);
 static void on_radio_disabled_tx(void);
 static void on_radio_disabled_tx_wait_for_ack(void);
 static void on_radio_disabled_rx(void);
 static void on_radio_disabled_rx_ack(void);
+static void clear_events_restart_rx(void);
 
 /*  Function to do bytewise bit-swap on an unsigned 32-bit value */
 static u32_t bytewise_bit_swap(const u8_t *input)
@@ -454,6 +576,12 @@ static void reset_fifos(void)
 	tx_fifo.front = 0;
 	tx_fifo.count = 0;
 
+	tx_released.back = 0;
+	tx_released.front = 0;
+	tx_released.count = 0;
+
+	memset(ack_fifo, 0, sizeof(ack_fifo));
+
 	rx_fifo.back = 0;
 	rx_fifo.front = 0;
 	rx_fifo.count = 0;
@@ -462,17 +590,24 @@ static void reset_fifos(void)
 static void initialize_fifos(void)
 {
 	static struct nrf_esb_payload rx_payload[CONFIG_NRF_ESB_RX_FIFO_SIZE];
-	static struct nrf_esb_payload tx_payload[CONFIG_NRF_ESB_TX_FIFO_SIZE];
 
 	reset_fifos();
 
 	for (size_t i = 0; i < CONFIG_NRF_ESB_TX_FIFO_SIZE; i++) {
-		tx_fifo.payload[i] = &tx_payload[i];
+		tx_fifo.payload[i] = &tx_payload_storage[i];
 	}
 
 	for (size_t i = 0; i < CONFIG_NRF_ESB_RX_FIFO_SIZE; i++) {
 		rx_fifo.payload[i] = &rx_payload[i];
 	}
+
+	for (size_t pipe = 0; pipe < CONFIG_NRF_ESB_PIPE_COUNT; pipe++) {
+		for (size_t i = 0; i < CONFIG_NRF_ESB_ACK_PAYLOAD_FIFO_SIZE;
+		     i++) {
+			ack_fifo[pipe].payload[i] =
+				&ack_payload_storage[pipe][i];
+		}
+	}
 }
 
 static void tx_fifo_remove_last(void)
@@ -491,6 +626,499 @@ static void tx_fifo_remove_last(void)
 	irq_unlock(key);
 }
 
+#ifdef CONFIG_NRF_ESB_STATS
+static void stats_avg_update(u32_t *avg, u32_t sample)
+{
+	s32_t diff = (s32_t)(sample << 8) - (s32_t)*avg;
+
+	*avg = (u32_t)((s32_t)*avg + diff / (1 << STATS_AVG_SHIFT));
+}
+
+static void stats_rssi_update(struct pipe_stats *stats, u8_t rssi)
+{
+	if (stats->rssi_avg == 0) {
+		stats->rssi_avg = rssi << 8;
+	} else {
+		stats_avg_update(&stats->rssi_avg, rssi);
+	}
+}
+#endif
+
+#ifdef CONFIG_NRF_ESB_ADAPTIVE_RETRANSMIT
+/* Tune the retransmit delay and count from the average number of attempts
+ * needed by recent transmissions. A busy channel gets more attempts spread
+ * over a longer time, and the application settings are restored gradually
+ * when the channel is clear again.
+ */
+static void adaptive_retransmit_update(u32_t attempts, bool success)
+{
+	stats_avg_update(&adaptive.attempts_avg, attempts);
+	adaptive.failed |= !success;
+
+	if (++adaptive.samples < ADAPTIVE_PERIOD) {
+		return;
+	}
+
+	if (adaptive.failed ||
+	    adaptive.attempts_avg > ADAPTIVE_ATTEMPTS_HIGH) {
+		if (esb_cfg.retransmit_count <
+		    CONFIG_NRF_ESB_ADAPTIVE_RETRANSMIT_COUNT_MAX) {
+			esb_cfg.retransmit_count++;
+		}
+		/* A delay set above the maximum is never shortened. */
+		esb_cfg.retransmit_delay =
+			max(min(esb_cfg.retransmit_delay +
+				esb_cfg.retransmit_delay / 4,
+				CONFIG_NRF_ESB_ADAPTIVE_RETRANSMIT_DELAY_MAX),
+			    adaptive.base_delay);
+	} else if (adaptive.attempts_avg < ADAPTIVE_ATTEMPTS_LOW) {
+		if (esb_cfg.retransmit_count > adaptive.base_count) {
+			esb_cfg.retransmit_count--;
+		}
+		esb_cfg.retransmit_delay =
+			max(esb_cfg.retransmit_delay -
+			    esb_cfg.retransmit_delay / 8,
+			    adaptive.base_delay);
+	}
+
+	adaptive.samples = 0;
+	adaptive.failed = false;
+}
+
+/* Restart the adaptation from the application settings. */
+static void adaptive_retransmit_reset(void)
+{
+	esb_cfg.retransmit_delay = adaptive.base_delay;
+	esb_cfg.retransmit_count = adaptive.base_count;
+	adaptive.attempts_avg = 1 << 8;
+	adaptive.samples = 0;
+	adaptive.failed = false;
+}
+#else
+static inline void adaptive_retransmit_update(u32_t attempts, bool success)
+{
+}
+
+static inline void adaptive_retransmit_reset(void)
+{
+}
+#endif
+
+#ifdef CONFIG_NRF_ESB_HOPPING
+/* Move to the next channel of the hop table. The radio must be disabled. */
+static void hopping_next_channel(void)
+{
+	if (++hopping.index >= hopping.count) {
+		hopping.index = 0;
+	}
+
+	hopping.misses = 0;
+	esb_addr.rf_channel = hopping.table[hopping.index];
+	NRF_RADIO->FREQUENCY = esb_addr.rf_channel;
+}
+
+/* In PTX mode, a channel is left after a number of attempts without ACK, so
+ * that retransmissions sweep the hop table until the PRX is found.
+ */
+static void hopping_ptx_miss(void)
+{
+	if (hopping.count == 0) {
+		return;
+	}
+
+	if (++hopping.misses >= CONFIG_NRF_ESB_HOPPING_PTX_ATTEMPTS) {
+		hopping_next_channel();
+	}
+}
+
+static void hopping_ptx_ack(void)
+{
+	hopping.misses = 0;
+}
+
+static void hopping_prx_rx(void)
+{
+	hopping.rx_seen = true;
+}
+
+/* In PRX mode, the channel is left when no packet has been received for
+ * CONFIG_NRF_ESB_HOPPING_PRX_TIMEOUT_MS. The PRX hops slowly and the PTX
+ * sweeps the hop table quickly, so the PTX finds the PRX again within one
+ * sweep.
+ *
+ * The timer expires in the system clock interrupt, so the channel switch is
+ * deferred to the radio interrupt, which owns the radio registers.
+ */
+static void hopping_prx_timeout(struct k_timer *timer)
+{
+	u32_t key = irq_lock();
+
+	if (!hopping.rx_seen) {
+		hopping.switch_pending = true;
+		NVIC_SetPendingIRQ(RADIO_IRQn);
+	}
+	hopping.rx_seen = false;
+
+	irq_unlock(key);
+}
+
+/* Switch to the next channel after a PRX channel timeout. Called from the
+ * radio interrupt.
+ */
+static void hopping_prx_switch(void)
+{
+	if (!hopping.switch_pending) {
+		return;
+	}
+
+	hopping.switch_pending = false;
+
+	/* A packet that is being acknowledged keeps the PRX on the channel. */
+	if ((hopping.count == 0) || (esb_state != ESB_STATE_PRX)) {
+		return;
+	}
+
+	if (NRF_RADIO->STATE == RADIO_STATE_STATE_Disabled) {
+		/* Between two windows of duty-cycled RX. */
+		hopping_next_channel();
+		return;
+	}
+
+	NRF_RADIO->SHORTS = radio_shorts_common;
+	NRF_RADIO->EVENTS_DISABLED = 0;
+	NRF_RADIO->TASKS_DISABLE = 1;
+	while (NRF_RADIO->EVENTS_DISABLED == 0) {
+		/* wait for register to settle */
+	}
+
+	hopping_next_channel();
+	clear_events_restart_rx();
+}
+
+static void hopping_prx_start(void)
+{
+	if (hopping.count > 0) {
+		hopping.rx_seen = false;
+		k_timer_start(&hopping_prx_timer,
+			      K_MSEC(CONFIG_NRF_ESB_HOPPING_PRX_TIMEOUT_MS),
+			      K_MSEC(CONFIG_NRF_ESB_HOPPING_PRX_TIMEOUT_MS));
+	}
+}
+
+static void hopping_prx_stop(void)
+{
+	k_timer_stop(&hopping_prx_timer);
+	hopping.switch_pending = false;
+}
+#else
+static inline void hopping_ptx_miss(void)
+{
+}
+
+static inline void hopping_ptx_ack(void)
+{
+}
+
+static inline void hopping_prx_rx(void)
+{
+}
+
+static inline void hopping_prx_switch(void)
+{
+}
+
+static inline void hopping_prx_start(void)
+{
+}
+
+static inline void hopping_prx_stop(void)
+{
+}
+#endif
+
+#ifdef CONFIG_NRF_ESB_LATENCY_TRACE
+static void latency_record(enum nrf_esb_latency_stage stage, u32_t start,
+			   u32_t end)
+{
+	struct latency_stage *entry = &latency_stages[stage];
+	u32_t duration = end - start;
+
+	if ((entry->count == 0) || (duration < entry->min)) {
+		entry->min = duration;
+	}
+	if (duration > entry->max) {
+		entry->max = duration;
+	}
+	entry->sum += duration;
+	entry->count++;
+}
+
+/* A payload was written to a TX FIFO entry. */
+static void latency_trace_tx_write(u32_t index)
+{
+	latency.written[index] = k_cycle_get_32();
+}
+
+/* The radio is enabled for the payload at the front of the TX FIFO. */
+static void latency_trace_tx_start(void)
+{
+	u32_t now = k_cycle_get_32();
+
+	latency_record(NRF_ESB_LATENCY_QUEUE, latency.written[tx_fifo.front],
+		       now);
+	latency.tx_enabled = now;
+}
+
+/* An attempt to send the packet in flight ended. */
+static void latency_trace_tx_sent(void)
+{
+	latency.tx_sent = k_cycle_get_32();
+}
+
+/* The packet in flight was acknowledged, or sent without ACK request. */
+static void latency_trace_tx_done(bool acked)
+{
+	u32_t now = k_cycle_get_32();
+
+	if (acked) {
+		latency_record(NRF_ESB_LATENCY_RADIO, latency.tx_enabled,
+			       latency.tx_sent);
+		latency_record(NRF_ESB_LATENCY_ACK, latency.tx_sent, now);
+	} else {
+		latency_record(NRF_ESB_LATENCY_RADIO, latency.tx_enabled, now);
+	}
+}
+
+/* An event was raised for the application. */
+static void latency_trace_event_raise(void)
+{
+	if (!latency.event_pending) {
+		latency.event_raised = k_cycle_get_32();
+		latency.event_pending = true;
+	}
+}
+
+/* Raised events are delivered to the application. */
+static void latency_trace_event_deliver(void)
+{
+	u32_t key = irq_lock();
+
+	if (latency.event_pending) {
+		latency.event_pending = false;
+		latency_record(NRF_ESB_LATENCY_EVENT, latency.event_raised,
+			       k_cycle_get_32());
+	}
+
+	irq_unlock(key);
+}
+#else
+static inline void latency_trace_tx_write(u32_t index)
+{
+}
+
+static inline void latency_trace_tx_start(void)
+{
+}
+
+static inline void latency_trace_tx_sent(void)
+{
+}
+
+static inline void latency_trace_tx_done(bool acked)
+{
+}
+
+static inline void latency_trace_event_raise(void)
+{
+}
+
+static inline void latency_trace_event_deliver(void)
+{
+}
+#endif
+
+/* Update the statistics of a pipe after a transmission in PTX mode.
+ *
+ * @param pipe		Pipe.
+ * @param attempts	Number of attempts, or zero for no-ACK packets.
+ * @param success	True if the packet was acknowledged.
+ */
+static void stats_tx_update(u8_t pipe, u32_t attempts, bool success)
+{
+#ifdef CONFIG_NRF_ESB_STATS
+	struct pipe_stats *stats = &pipe_stats[pipe];
+
+	if (attempts == 0) {
+		stats->counters.tx_noack++;
+		return;
+	}
+
+	if (success) {
+		stats->counters.tx_success++;
+		stats->counters.tx_attempts_hist[
+			min(attempts, NRF_ESB_STATS_ATTEMPTS_BINS) - 1]++;
+		/* The RSSI was sampled on the received ACK. */
+		stats_rssi_update(stats, NRF_RADIO->RSSISAMPLE);
+	} else {
+		stats->counters.tx_failed++;
+	}
+	stats->counters.tx_attempts += attempts;
+	stats_avg_update(&stats->tx_attempts_avg, attempts);
+
+	adaptive_retransmit_update(attempts, success);
+#endif
+}
+
+/* Update the statistics of a pipe after a reception in PRX mode. */
+static void stats_rx_update(u8_t pipe, bool retransmit)
+{
+#ifdef CONFIG_NRF_ESB_STATS
+	struct pipe_stats *stats = &pipe_stats[pipe];
+
+	if (retransmit) {
+		stats->counters.rx_duplicates++;
+	} else {
+		stats->counters.rx_received++;
+	}
+	stats_rssi_update(stats, NRF_RADIO->RSSISAMPLE);
+#endif
+}
+
+static bool tx_fifo_front_is_lent(void)
+{
+	return tx_fifo.payload[tx_fifo.front] !=
+	       &tx_payload_storage[tx_fifo.front];
+}
+
+/* Queue a payload lent by the application for its TX success or TX failed
+ * event, depending on result_msk.
+ */
+static void tx_release(struct nrf_esb_payload *payload, u32_t result_msk)
+{
+	u32_t key = irq_lock();
+
+	tx_released.entry[tx_released.back].payload = payload;
+	tx_released.entry[tx_released.back].evt_id =
+		(result_msk == INT_TX_SUCCESS_MSK) ?
+		NRF_ESB_EVENT_TX_SUCCESS : NRF_ESB_EVENT_TX_FAILED;
+	if (++tx_released.back >= TX_RELEASED_SIZE) {
+		tx_released.back = 0;
+	}
+	tx_released.count++;
+
+	irq_unlock(key);
+}
+
+/* Complete the transmission of the payload at the front of the TX FIFO.
+ *
+ * Payloads lent by the application are removed from the TX FIFO both on
+ * success and on failure, and are returned to the application in a
+ * dedicated event. Copied payloads are only removed on success and are
+ * reported through the interrupt flags.
+ *
+ * @param result_msk	INT_TX_SUCCESS_MSK or INT_TX_FAILED_MSK.
+ */
+static void tx_complete(u32_t result_msk)
+{
+	latency_trace_event_raise();
+
+	if (tx_fifo.count == 0 || !tx_fifo_front_is_lent()) {
+		interrupt_flags |= result_msk;
+		if (result_msk == INT_TX_SUCCESS_MSK) {
+			tx_fifo_remove_last();
+		}
+		return;
+	}
+
+	tx_release(tx_fifo.payload[tx_fifo.front], result_msk);
+	tx_fifo.payload[tx_fifo.front] = &tx_payload_storage[tx_fifo.front];
+
+	tx_fifo_remove_last();
+}
+
+/* Return a lent payload of the TX FIFO to the application in a TX failed
+ * event and restore the storage of its entry.
+ */
+static void tx_fifo_entry_release(u32_t index)
+{
+	if (tx_fifo.payload[index] != &tx_payload_storage[index]) {
+		tx_release(tx_fifo.payload[index], INT_TX_FAILED_MSK);
+		tx_fifo.payload[index] = &tx_payload_storage[index];
+	}
+}
+
+/* Remove all payloads from the TX FIFO. Must be called with interrupts
+ * locked.
+ */
+static void tx_fifo_flush(void)
+{
+	u32_t index = tx_fifo.front;
+
+	for (u32_t i = 0; i < tx_fifo.count; i++) {
+		tx_fifo_entry_release(index);
+		if (++index >= CONFIG_NRF_ESB_TX_FIFO_SIZE) {
+			index = 0;
+		}
+	}
+
+	tx_fifo.count = 0;
+	tx_fifo.back = 0;
+	tx_fifo.front = 0;
+}
+
+/* Remove all payloads from the ACK payload queue of a pipe. Lent payloads
+ * are returned to the application in TX failed events. Must be called with
+ * interrupts locked.
+ */
+static void ack_fifo_flush(u8_t pipe)
+{
+	struct payload_ack_fifo *fifo = &ack_fifo[pipe];
+	u32_t index = fifo->front;
+
+	for (u32_t i = 0; i < fifo->count; i++) {
+		struct nrf_esb_payload *storage =
+			&ack_payload_storage[pipe][index];
+
+		if (fifo->payload[index] != storage) {
+			tx_release(fifo->payload[index], INT_TX_FAILED_MSK);
+			fifo->payload[index] = storage;
+		}
+		if (++index >= CONFIG_NRF_ESB_ACK_PAYLOAD_FIFO_SIZE) {
+			index = 0;
+		}
+	}
+
+	fifo->count = 0;
+	fifo->back = 0;
+	fifo->front = 0;
+	rx_pipe_info[pipe].ack_payload = false;
+}
+
+/* Complete the ACK payload at the front of the queue of a pipe, after the
+ * PTX has acknowledged its reception by sending a new packet.
+ */
+static void ack_fifo_complete(u8_t pipe)
+{
+	struct payload_ack_fifo *fifo = &ack_fifo[pipe];
+	struct nrf_esb_payload *storage =
+		&ack_payload_storage[pipe][fifo->front];
+
+	if (fifo->payload[fifo->front] != storage) {
+		tx_release(fifo->payload[fifo->front], INT_TX_SUCCESS_MSK);
+		fifo->payload[fifo->front] = storage;
+	} else {
+		interrupt_flags |= INT_TX_SUCCESS_MSK;
+	}
+	latency_trace_event_raise();
+
+	if (++fifo->front >= CONFIG_NRF_ESB_ACK_PAYLOAD_FIFO_SIZE) {
+		fifo->front = 0;
+	}
+	fifo->count--;
+
+	NVIC_SetPendingIRQ(ESB_EVT_IRQ);
+}
+
 /*  Function to push the content of the rx_buffer to the RX FIFO.
  *
  *  The module will point the register NRF_RADIO->PACKETPTR to a buffer for
@@ -546,6 +1174,69 @@ static void sys_timer_init(void)
 				TIMER_SHORTS_COMPARE1_STOP_Msk;
 }
 
+/* Configure the system timer to time out pending RX events in PRX mode,
+ * where it is not used to time ACK reception.
+ */
+static void sys_timer_rx_event_init(void)
+{
+	ESB_SYS_TIMER->TASKS_SHUTDOWN = 1;
+	ESB_SYS_TIMER->SHORTS = TIMER_SHORTS_COMPARE2_CLEAR_Msk |
+				TIMER_SHORTS_COMPARE2_STOP_Msk;
+	ESB_SYS_TIMER->CC[2] = CONFIG_NRF_ESB_RX_EVENT_TIMEOUT_US;
+	ESB_SYS_TIMER->EVENTS_COMPARE[2] = 0;
+	ESB_SYS_TIMER->INTENSET = TIMER_INTENSET_COMPARE2_Msk;
+}
+
+static void sys_timer_rx_event_uninit(void)
+{
+	ESB_SYS_TIMER->INTENCLR = TIMER_INTENCLR_COMPARE2_Msk;
+	ESB_SYS_TIMER->TASKS_SHUTDOWN = 1;
+	ESB_SYS_TIMER->EVENTS_COMPARE[2] = 0;
+	sys_timer_init();
+}
+
+/* RX event moderation uses the system timer, which duty-cycled RX needs for
+ * the RX windows.
+ */
+static bool rx_event_moderated(void)
+{
+#ifdef CONFIG_NRF_ESB_RX_DUTY_CYCLE
+	if (rx_duty.period_us > 0) {
+		return false;
+	}
+#endif
+	return CONFIG_NRF_ESB_RX_EVENT_COUNT > 1;
+}
+
+/* Signal a received packet to the application.
+ *
+ * Unless the RX FIFO is full, the RX event is delayed until
+ * CONFIG_NRF_ESB_RX_EVENT_COUNT packets are pending or the system timer
+ * reaches CONFIG_NRF_ESB_RX_EVENT_TIMEOUT_US after the first pending packet.
+ */
+static void rx_event_signal(void)
+{
+	interrupt_flags |= INT_RX_DATA_RECEIVED_MSK;
+	latency_trace_event_raise();
+
+	if (rx_event_moderated()) {
+		if (++rx_unreported < CONFIG_NRF_ESB_RX_EVENT_COUNT &&
+		    rx_fifo.count < CONFIG_NRF_ESB_RX_FIFO_SIZE) {
+			if (rx_unreported == 1) {
+				ESB_SYS_TIMER->TASKS_CLEAR = 1;
+				ESB_SYS_TIMER->EVENTS_COMPARE[2] = 0;
+				ESB_SYS_TIMER->TASKS_START = 1;
+			}
+			return;
+		}
+
+		ESB_SYS_TIMER->TASKS_SHUTDOWN = 1;
+		rx_unreported = 0;
+	}
+
+	NVIC_SetPendingIRQ(ESB_EVT_IRQ);
+}
+
 static void ppi_init(void)
 {
 	NRF_PPI->CH[CONFIG_NRF_ESB_PPI_TIMER_START].EEP =
@@ -567,15 +1258,144 @@ static void ppi_init(void)
 		(u32_t)&ESB_SYS_TIMER->EVENTS_COMPARE[1];
 	NRF_PPI->CH[CONFIG_NRF_ESB_PPI_TX_START].TEP =
 		(u32_t)&NRF_RADIO->TASKS_TXEN;
+
+	/* Both channels are in the same group and disable it when they are
+	 * triggered, so the next no-ACK packet is started only once.
+	 */
+	NRF_PPI->CH[CONFIG_NRF_ESB_PPI_TX_NEXT].EEP =
+		(u32_t)&NRF_RADIO->EVENTS_DISABLED;
+	NRF_PPI->CH[CONFIG_NRF_ESB_PPI_TX_NEXT].TEP =
+		(u32_t)&NRF_RADIO->TASKS_TXEN;
+
+	NRF_PPI->CH[CONFIG_NRF_ESB_PPI_TX_NEXT_DISARM].EEP =
+		(u32_t)&NRF_RADIO->EVENTS_DISABLED;
+	NRF_PPI->CH[CONFIG_NRF_ESB_PPI_TX_NEXT_DISARM].TEP =
+		(u32_t)&NRF_PPI->TASKS_CHG[CONFIG_NRF_ESB_PPI_GROUP_TX_NEXT].DIS;
+
+	NRF_PPI->CHG[CONFIG_NRF_ESB_PPI_GROUP_TX_NEXT] =
+		(1 << CONFIG_NRF_ESB_PPI_TX_NEXT) |
+		(1 << CONFIG_NRF_ESB_PPI_TX_NEXT_DISARM);
 }
 
-static void start_tx_transaction(void)
+#ifdef CONFIG_NRF_ESB_RX_DUTY_CYCLE
+static bool rx_duty_active(void)
+{
+	return rx_duty.period_us > 0;
+}
+
+/* Start duty-cycled RX. The system timer restarts every period. Through
+ * PPI, the period start enables the radio in RX and COMPARE0 disables it at
+ * the end of the window, so the CPU is not woken up between packets.
+ */
+static void rx_duty_start(void)
+{
+	ESB_SYS_TIMER->TASKS_SHUTDOWN = 1;
+	ESB_SYS_TIMER->BITMODE = TIMER_BITMODE_BITMODE_32Bit;
+	ESB_SYS_TIMER->SHORTS = TIMER_SHORTS_COMPARE1_CLEAR_Msk;
+	ESB_SYS_TIMER->CC[0] = rx_duty.window_us;
+	ESB_SYS_TIMER->CC[1] = rx_duty.period_us;
+	ESB_SYS_TIMER->EVENTS_COMPARE[0] = 0;
+	ESB_SYS_TIMER->EVENTS_COMPARE[1] = 0;
+
+	/* The TX start channel is not used in PRX mode. */
+	NRF_PPI->CH[CONFIG_NRF_ESB_PPI_TX_START].TEP =
+		(u32_t)&NRF_RADIO->TASKS_RXEN;
+	NRF_PPI->CHENCLR = (1 << CONFIG_NRF_ESB_PPI_TIMER_START) |
+			   (1 << CONFIG_NRF_ESB_PPI_TIMER_STOP);
+	NRF_PPI->CHENSET = (1 << CONFIG_NRF_ESB_PPI_RX_TIMEOUT) |
+			   (1 << CONFIG_NRF_ESB_PPI_TX_START);
+
+	NRF_RADIO->TASKS_RXEN = 1;
+	ESB_SYS_TIMER->TASKS_START = 1;
+}
+
+static void rx_duty_stop(void)
+{
+	NRF_PPI->CHENCLR = (1 << CONFIG_NRF_ESB_PPI_RX_TIMEOUT) |
+			   (1 << CONFIG_NRF_ESB_PPI_TX_START);
+	ESB_SYS_TIMER->TASKS_SHUTDOWN = 1;
+	ESB_SYS_TIMER->EVENTS_COMPARE[0] = 0;
+	ESB_SYS_TIMER->EVENTS_COMPARE[1] = 0;
+
+	sys_timer_init();
+	ppi_init();
+}
+
+/* Check if the radio was disabled by the end of an RX window. If so, keep
+ * it disabled until the next window instead of restarting RX or sending
+ * an ACK.
+ */
+static bool rx_duty_window_closed(void)
 {
-	bool ack;
+	if (!rx_duty_active() || !ESB_SYS_TIMER->EVENTS_COMPARE[0]) {
+		return false;
+	}
 
+	ESB_SYS_TIMER->EVENTS_COMPARE[0] = 0;
+
+	/* Stop a ramp-up started by a DISABLED shortcut. */
+	NRF_RADIO->SHORTS = radio_shorts_common;
+	NRF_RADIO->EVENTS_DISABLED = 0;
+	NRF_RADIO->TASKS_DISABLE = 1;
+	while (NRF_RADIO->EVENTS_DISABLED == 0) {
+		/* wait for register to settle */
+	}
+	NRF_RADIO->EVENTS_DISABLED = 0;
+
+	NRF_RADIO->SHORTS = radio_shorts_common |
+			    RADIO_SHORTS_DISABLED_TXEN_Msk;
+	update_rf_payload_format(esb_cfg.payload_length);
+	NRF_RADIO->PACKETPTR = (u32_t)rx_payload_buffer;
+	on_radio_disabled = on_radio_disabled_rx;
+	esb_state = ESB_STATE_PRX;
+
+	return true;
+}
+#else
+static inline bool rx_duty_active(void)
+{
+	return false;
+}
+
+static inline void rx_duty_start(void)
+{
+}
+
+static inline void rx_duty_stop(void)
+{
+}
+
+static inline bool rx_duty_window_closed(void)
+{
+	return false;
+}
+#endif
+
+static bool tx_payload_ack(const struct nrf_esb_payload *payload)
+{
+	return !payload->noack || !esb_cfg.selective_auto_ack;
+}
+
+static void tx_payload_buffer_fill_dpl(u8_t *buffer,
+				       const struct nrf_esb_payload *payload)
+{
+	buffer[0] = payload->length;
+	buffer[1] = payload->pid << 1;
+	buffer[1] |= payload->noack ? 0x00 : 0x01;
+	memcpy(&buffer[2], payload->data, payload->length);
+}
+
+static void start_tx_transaction(void)
+{
 	last_tx_attempts = 1;
 	/* Prepare the payload */
 	current_payload = tx_fifo.payload[tx_fifo.front];
+	tx_next_prepared = false;
+	tx_next_started = false;
+	on_radio_address = NULL;
+	on_radio_end = NULL;
+	NRF_RADIO->INTENCLR = RADIO_INTENCLR_ADDRESS_Msk |
+			      RADIO_INTENCLR_END_Msk;
 
 	switch (esb_cfg.protocol) {
 	case NRF_ESB_PROTOCOL_ESB:
@@ -597,17 +1417,12 @@ static void start_tx_transaction(void)
 		break;
 
 	case NRF_ESB_PROTOCOL_ESB_DPL:
-		ack = !current_payload->noack || !esb_cfg.selective_auto_ack;
-		tx_payload_buffer[0] = current_payload->length;
-		tx_payload_buffer[1] = current_payload->pid << 1;
-		tx_payload_buffer[1] |= current_payload->noack ? 0x00 : 0x01;
-		memcpy(&tx_payload_buffer[2], current_payload->data,
-		       current_payload->length);
+		tx_payload_buffer_fill_dpl(tx_payload_buffer, current_payload);
 
 		/* Handling ack if noack is set to false or if
 		 * selective auto ack is turned off
 		 */
-		if (ack) {
+		if (tx_payload_ack(current_payload)) {
 			NRF_RADIO->SHORTS = radio_shorts_common |
 					    RADIO_SHORTS_DISABLED_RXEN_Msk;
 			NRF_RADIO->INTENSET = RADIO_INTENSET_DISABLED_Msk |
@@ -619,8 +1434,12 @@ static void start_tx_transaction(void)
 			esb_state = ESB_STATE_PTX_TX_ACK;
 		} else {
 			NRF_RADIO->SHORTS = radio_shorts_common;
-			NRF_RADIO->INTENSET = RADIO_INTENSET_DISABLED_Msk;
+			NRF_RADIO->INTENSET = RADIO_INTENSET_DISABLED_Msk |
+					      RADIO_INTENSET_ADDRESS_Msk |
+					      RADIO_INTENSET_END_Msk;
 			on_radio_disabled = on_radio_disabled_tx_noack;
+			on_radio_address = on_radio_address_tx_noack;
+			on_radio_end = on_radio_end_tx_noack;
 			esb_state = ESB_STATE_PTX_TX;
 		}
 		break;
@@ -643,25 +1462,114 @@ static void start_tx_transaction(void)
 	NRF_RADIO->EVENTS_PAYLOAD = 0;
 	NRF_RADIO->EVENTS_DISABLED = 0;
 
+	latency_trace_tx_start();
 	NRF_RADIO->TASKS_TXEN = 1;
 }
 
+static void on_radio_address_tx_noack(void)
+{
+	u32_t next;
+	struct nrf_esb_payload *next_payload;
+	u8_t *next_buffer;
+
+	/* The radio has latched PACKETPTR for the packet in flight, so the
+	 * next no-ACK packet can be prepared in the other buffer and started
+	 * through PPI when the radio is disabled, without waiting for the
+	 * interrupt. The packet is not started by END -> START: a PRX needs a
+	 * ramp-up to return to RX after a packet and would miss it.
+	 *
+	 * A DISABLED -> TXEN shortcut is not used either. When the interrupt
+	 * is served late, the shortcut keeps restarting the same packet until
+	 * it is removed. The PPI channels disable themselves, so the radio
+	 * never starts more than one packet without this handler having run.
+	 */
+	if (tx_fifo.count < 2) {
+		return;
+	}
+
+	next = tx_fifo.front + 1;
+	if (next >= CONFIG_NRF_ESB_TX_FIFO_SIZE) {
+		next = 0;
+	}
+
+	next_payload = tx_fifo.payload[next];
+	if (tx_payload_ack(next_payload)) {
+		return;
+	}
+
+	next_buffer = tx_payload_buffers[tx_buffer_index ^ 1];
+	tx_payload_buffer_fill_dpl(next_buffer, next_payload);
+
+	NRF_RADIO->TXADDRESS = next_payload->pipe;
+	NRF_RADIO->PACKETPTR = (u32_t)next_buffer;
+	NRF_PPI->TASKS_CHG[CONFIG_NRF_ESB_PPI_GROUP_TX_NEXT].EN = 1;
+	tx_next_prepared = true;
+
+	/* If the radio was disabled before the channels were enabled, they
+	 * are still enabled and the next packet is started from the DISABLED
+	 * interrupt instead.
+	 */
+	if ((NRF_RADIO->STATE == RADIO_STATE_STATE_Disabled) &&
+	    (NRF_PPI->CHEN & (1 << CONFIG_NRF_ESB_PPI_TX_NEXT))) {
+		NRF_PPI->TASKS_CHG[CONFIG_NRF_ESB_PPI_GROUP_TX_NEXT].DIS = 1;
+		tx_next_prepared = false;
+	}
+}
+
+static void on_radio_end_tx_noack(void)
+{
+	stats_tx_update(current_payload->pipe, 0, true);
+	latency_trace_tx_done(false);
+	tx_complete(INT_TX_SUCCESS_MSK);
+	NVIC_SetPendingIRQ(ESB_EVT_IRQ);
+
+	tx_next_started = tx_next_prepared;
+
+	if (tx_next_prepared) {
+		/* The next packet is started from the other buffer. */
+		tx_next_prepared = false;
+		tx_buffer_index ^= 1;
+		tx_payload_buffer = tx_payload_buffers[tx_buffer_index];
+		current_payload = tx_fifo.payload[tx_fifo.front];
+		latency_trace_tx_start();
+	} else {
+		/* The radio is being disabled, so a pending ADDRESS event
+		 * belongs to the packet that just completed.
+		 */
+		NRF_RADIO->EVENTS_ADDRESS = 0;
+	}
+}
+
 static void on_radio_disabled_tx_noack(void)
 {
-	interrupt_flags |= INT_TX_SUCCESS_MSK;
-	tx_fifo_remove_last();
+	/* Completion is reported from the END event. If the radio is not
+	 * disabled anymore, PPI has started the next packet, which completes
+	 * with its own END event.
+	 */
+	if (NRF_RADIO->STATE != RADIO_STATE_STATE_Disabled) {
+		return;
+	}
+
+	/* The radio stopped after a chained packet whose END event was not
+	 * handled yet. When the interrupt is served late, this END event may
+	 * also have been merged with the one of the previous packet.
+	 */
+	if (tx_next_started) {
+		NRF_RADIO->EVENTS_END = 0;
+		on_radio_end_tx_noack();
+	}
 
 	if (tx_fifo.count == 0) {
 		esb_state = ESB_STATE_IDLE;
-		NVIC_SetPendingIRQ(ESB_EVT_IRQ);
 	} else {
-		NVIC_SetPendingIRQ(ESB_EVT_IRQ);
 		start_tx_transaction();
 	}
 }
 
 static void on_radio_disabled_tx(void)
 {
+	latency_trace_tx_sent();
+
 	/* Remove the DISABLED -> RXEN shortcut, to make sure the radio stays
 	 * disabled after the RX window
 	 */
@@ -709,11 +1617,13 @@ static void on_radio_disabled_tx_wait_for_ack(void)
 	if (NRF_RADIO->EVENTS_END && NRF_RADIO->CRCSTATUS != 0) {
 		ESB_SYS_TIMER->TASKS_SHUTDOWN = 1;
 		NRF_PPI->CHENCLR = (1 << CONFIG_NRF_ESB_PPI_TX_START);
-		interrupt_flags |= INT_TX_SUCCESS_MSK;
 		last_tx_attempts = esb_cfg.retransmit_count -
 				   retransmits_remaining + 1;
 
-		tx_fifo_remove_last();
+		stats_tx_update(current_payload->pipe, last_tx_attempts, true);
+		latency_trace_tx_done(true);
+		hopping_ptx_ack();
+		tx_complete(INT_TX_SUCCESS_MSK);
 
 		if (esb_cfg.protocol != NRF_ESB_PROTOCOL_ESB &&
 		    rx_payload_buffer[0] > 0) {
@@ -733,6 +1643,8 @@ static void on_radio_disabled_tx_wait_for_ack(void)
 			start_tx_transaction();
 		}
 	} else {
+		hopping_ptx_miss();
+
 		if (retransmits_remaining-- == 0) {
 			ESB_SYS_TIMER->TASKS_SHUTDOWN = 1;
 			NRF_PPI->CHENCLR = (1 << CONFIG_NRF_ESB_PPI_TX_START);
@@ -740,7 +1652,9 @@ static void on_radio_disabled_tx_wait_for_ack(void)
 			 * suspended
 			 */
 			last_tx_attempts = esb_cfg.retransmit_count + 1;
-			interrupt_flags |= INT_TX_FAILED_MSK;
+			stats_tx_update(current_payload->pipe,
+					last_tx_attempts, false);
+			tx_complete(INT_TX_FAILED_MSK);
 
 			esb_state = ESB_STATE_IDLE;
 			NVIC_SetPendingIRQ(ESB_EVT_IRQ);
@@ -786,28 +1700,27 @@ static void clear_events_restart_rx(void)
 static void on_radio_disabled_rx_dpl(bool retransmit_payload,
 				     struct pipe_info *pipe_info)
 {
-	if (tx_fifo.count > 0 &&
-	    (tx_fifo.payload[tx_fifo.front]->pipe == NRF_RADIO->RXMATCH)) {
-		/* Pipe stays in ACK with payload until TX FIFO is empty */
-		/* Do not report TX success on first ack payload or retransmit
-		 */
-		if (pipe_info->ack_payload && !retransmit_payload) {
-			if (++tx_fifo.front >= CONFIG_NRF_ESB_TX_FIFO_SIZE) {
-				tx_fifo.front = 0;
-			}
-
-			tx_fifo.count--;
+	u8_t pipe = NRF_RADIO->RXMATCH;
+	struct payload_ack_fifo *fifo = &ack_fifo[pipe];
 
-			/* ACK payloads also require TX_DS */
-			/* (page 40 of the
-			 * 'nRF24LE1_Product_Specification_rev1_6.pdf').
-			 */
-			interrupt_flags |= INT_TX_SUCCESS_MSK;
-		}
+	/* A new packet on the pipe means that the PTX received the previous
+	 * ACK with payload. Do not report TX success on first ack payload or
+	 * retransmit.
+	 */
+	if (pipe_info->ack_payload && !retransmit_payload &&
+	    fifo->count > 0) {
+		/* ACK payloads also require TX_DS */
+		/* (page 40 of the
+		 * 'nRF24LE1_Product_Specification_rev1_6.pdf').
+		 */
+		ack_fifo_complete(pipe);
+	}
 
+	if (fifo->count > 0) {
+		/* Pipe stays in ACK with payload until its queue is empty */
 		pipe_info->ack_payload = true;
 
-		current_payload = tx_fifo.payload[tx_fifo.front];
+		current_payload = fifo->payload[fifo->front];
 
 		update_rf_payload_format(current_payload->length);
 		tx_payload_buffer[0] = current_payload->length;
@@ -828,6 +1741,10 @@ static void on_radio_disabled_rx(void)
 	bool send_rx_event = true;
 	struct pipe_info *pipe_info;
 
+	if (rx_duty_window_closed()) {
+		return;
+	}
+
 	if (NRF_RADIO->CRCSTATUS == 0) {
 		clear_events_restart_rx();
 		return;
@@ -848,6 +1765,9 @@ static void on_radio_disabled_rx(void)
 	pipe_info->pid = rx_payload_buffer[1] >> 1;
 	pipe_info->crc = NRF_RADIO->RXCRC;
 
+	stats_rx_update(NRF_RADIO->RXMATCH, retransmit_payload);
+	hopping_prx_rx();
+
 	/* Check if an ack should be sent */
 	if ((esb_cfg.selective_auto_ack == false) ||
 	    ((rx_payload_buffer[1] & 0x01) == 1)) {
@@ -881,14 +1801,17 @@ static void on_radio_disabled_rx(void)
 		 * successful.
 		 */
 		if (rx_fifo_push_rfbuf(NRF_RADIO->RXMATCH, pipe_info->pid)) {
-			interrupt_flags |= INT_RX_DATA_RECEIVED_MSK;
-			NVIC_SetPendingIRQ(ESB_EVT_IRQ);
+			rx_event_signal();
 		}
 	}
 }
 
 static void on_radio_disabled_rx_ack(void)
 {
+	if (rx_duty_window_closed()) {
+		return;
+	}
+
 	NRF_RADIO->SHORTS = radio_shorts_common |
 			    RADIO_SHORTS_DISABLED_TXEN_Msk;
 	update_rf_payload_format(esb_cfg.payload_length);
@@ -923,6 +1846,10 @@ static void RADIO_IRQHandler(void)
 		ESB_SYS_TIMER->TASKS_START;
 	}
 
+	/* END is handled before ADDRESS, because an END event of the previous
+	 * packet and an ADDRESS event of the next one can be pending at the
+	 * same time when packets are sent back-to-back.
+	 */
 	if (NRF_RADIO->EVENTS_END &&
 	    (NRF_RADIO->INTENSET & RADIO_INTENSET_END_Msk)) {
 		NRF_RADIO->EVENTS_END = 0;
@@ -934,6 +1861,14 @@ static void RADIO_IRQHandler(void)
 		}
 	}
 
+	if (NRF_RADIO->EVENTS_ADDRESS &&
+	    (NRF_RADIO->INTENSET & RADIO_INTENSET_ADDRESS_Msk)) {
+		NRF_RADIO->EVENTS_ADDRESS = 0;
+		if (on_radio_address) {
+			on_radio_address();
+		}
+	}
+
 	if (NRF_RADIO->EVENTS_DISABLED &&
 	    (NRF_RADIO->INTENSET & RADIO_INTENSET_DISABLED_Msk)) {
 		NRF_RADIO->EVENTS_DISABLED = 0;
@@ -944,6 +1879,30 @@ static void RADIO_IRQHandler(void)
 			on_radio_disabled();
 		}
 	}
+
+	hopping_prx_switch();
+}
+
+/* Return the released payloads to the application, one event each. */
+static void tx_released_notify(struct nrf_esb_evt *event)
+{
+	while (tx_released.count > 0) {
+		u32_t key = irq_lock();
+
+		event->evt_id = tx_released.entry[tx_released.front].evt_id;
+		event->payload = tx_released.entry[tx_released.front].payload;
+		if (++tx_released.front >= TX_RELEASED_SIZE) {
+			tx_released.front = 0;
+		}
+		tx_released.count--;
+
+		irq_unlock(key);
+
+		if (event_handler != NULL) {
+			event_handler(event);
+		}
+	}
+	event->payload = NULL;
 }
 
 static void ESB_EVT_IRQHandler(void)
@@ -952,8 +1911,13 @@ static void ESB_EVT_IRQHandler(void)
 	struct nrf_esb_evt event;
 
 	event.tx_attempts = last_tx_attempts;
+	event.payload = NULL;
 
+	latency_trace_event_deliver();
 	get_and_clear_irqs(&interrupts);
+
+	tx_released_notify(&event);
+
 	if (event_handler != NULL) {
 		if (interrupts & INT_TX_SUCCESS_MSK) {
 			event.evt_id = NRF_ESB_EVENT_TX_SUCCESS;
@@ -972,6 +1936,19 @@ static void ESB_EVT_IRQHandler(void)
 
 static void NRF_ESB_SYS_TIMER_IRQHandler(void)
 {
+	if (ESB_SYS_TIMER->EVENTS_COMPARE[2] &&
+	    (ESB_SYS_TIMER->INTENSET & TIMER_INTENSET_COMPARE2_Msk)) {
+		ESB_SYS_TIMER->EVENTS_COMPARE[2] = 0;
+
+		u32_t key = irq_lock();
+
+		if (rx_unreported > 0) {
+			rx_unreported = 0;
+			NVIC_SetPendingIRQ(ESB_EVT_IRQ);
+		}
+
+		irq_unlock(key);
+	}
 }
 
 #ifdef CONFIG_NRF_ESB_ADDR_HANG_BUGFIX
@@ -1009,6 +1986,18 @@ int nrf_esb_init(const struct nrf_esb_config *config)
 
 	memset(rx_pipe_info, 0, sizeof(rx_pipe_info));
 	memset(pids, 0, sizeof(pids));
+#ifdef CONFIG_NRF_ESB_STATS
+	memset(pipe_stats, 0, sizeof(pipe_stats));
+#endif
+#ifdef CONFIG_NRF_ESB_LATENCY_TRACE
+	memset(latency_stages, 0, sizeof(latency_stages));
+	latency.event_pending = false;
+#endif
+#ifdef CONFIG_NRF_ESB_ADAPTIVE_RETRANSMIT
+	adaptive.base_delay = config->retransmit_delay;
+	adaptive.base_count = config->retransmit_count;
+#endif
+	adaptive_retransmit_reset();
 
 	update_radio_parameters();
 
@@ -1118,11 +2107,29 @@ void nrf_esb_disable(void)
 	NRF_PPI->CHENCLR = (1 << CONFIG_NRF_ESB_PPI_TIMER_START) |
 			   (1 << CONFIG_NRF_ESB_PPI_TIMER_STOP) |
 			   (1 << CONFIG_NRF_ESB_PPI_RX_TIMEOUT) |
-			   (1 << CONFIG_NRF_ESB_PPI_TX_START);
+			   (1 << CONFIG_NRF_ESB_PPI_TX_START) |
+			   (1 << CONFIG_NRF_ESB_PPI_TX_NEXT) |
+			   (1 << CONFIG_NRF_ESB_PPI_TX_NEXT_DISARM);
 
 	esb_state = ESB_STATE_IDLE;
 	esb_initialized = false;
 
+	/* Return the lent payloads before the queues are reset. */
+	u32_t key = irq_lock();
+
+	tx_fifo_flush();
+	for (u8_t pipe = 0; pipe < CONFIG_NRF_ESB_PIPE_COUNT; pipe++) {
+		ack_fifo_flush(pipe);
+	}
+
+	irq_unlock(key);
+
+	struct nrf_esb_evt event = {
+		.tx_attempts = last_tx_attempts,
+	};
+
+	tx_released_notify(&event);
+
 	reset_fifos();
 
 	memset(rx_pipe_info, 0, sizeof(rx_pipe_info));
@@ -1141,7 +2148,7 @@ bool nrf_esb_is_idle(void)
 	return (esb_state == ESB_STATE_IDLE);
 }
 
-int nrf_esb_write_payload(const struct nrf_esb_payload *payload)
+static int tx_payload_check(const struct nrf_esb_payload *payload)
 {
 	if (!esb_initialized) {
 		return -EACCES;
@@ -1155,20 +2162,100 @@ int nrf_esb_write_payload(const struct nrf_esb_payload *payload)
 	     payload->length > esb_cfg.payload_length)) {
 		return -EMSGSIZE;
 	}
-	if (tx_fifo.count >= CONFIG_NRF_ESB_TX_FIFO_SIZE) {
-		return -ENOMEM;
-	}
 	if (payload->pipe >= CONFIG_NRF_ESB_PIPE_COUNT) {
 		return -EINVAL;
 	}
 
+	return 0;
+}
+
+static u32_t queued_payload_count(void)
+{
+	u32_t count = tx_fifo.count;
+
+	for (size_t pipe = 0; pipe < CONFIG_NRF_ESB_PIPE_COUNT; pipe++) {
+		count += ack_fifo[pipe].count;
+	}
+
+	return count;
+}
+
+/* Add a payload to the back of the ACK payload queue of its pipe. */
+static int ack_fifo_push(struct nrf_esb_payload *payload, bool lend)
+{
+	struct payload_ack_fifo *fifo = &ack_fifo[payload->pipe];
+	struct nrf_esb_payload *entry;
+	int err = 0;
+	u32_t key = irq_lock();
+
+	if ((fifo->count >= CONFIG_NRF_ESB_ACK_PAYLOAD_FIFO_SIZE) ||
+	    (lend && (queued_payload_count() + tx_released.count >=
+		      TX_RELEASED_SIZE))) {
+		err = -ENOMEM;
+		goto out;
+	}
+
+	if (lend) {
+		entry = payload;
+	} else {
+		entry = &ack_payload_storage[payload->pipe][fifo->back];
+		entry->length = payload->length;
+		entry->pipe = payload->pipe;
+		entry->noack = payload->noack;
+		memcpy(entry->data, payload->data, payload->length);
+	}
+	fifo->payload[fifo->back] = entry;
+
+	pids[payload->pipe] = (pids[payload->pipe] + 1) % (PID_MAX + 1);
+	entry->pid = pids[payload->pipe];
+
+	if (++fifo->back >= CONFIG_NRF_ESB_ACK_PAYLOAD_FIFO_SIZE) {
+		fifo->back = 0;
+	}
+
+	fifo->count++;
+
+out:
+	irq_unlock(key);
+
+	return err;
+}
+
+/* Add a payload to the back of the TX FIFO.
+ *
+ * Only the header fields and the used part of the data are copied when the
+ * payload is stored in the driver. A lent payload is queued by reference.
+ */
+static int tx_fifo_push(struct nrf_esb_payload *payload, bool lend)
+{
+	struct nrf_esb_payload *entry;
+	int err = 0;
 	u32_t key = irq_lock();
 
-	memcpy(tx_fifo.payload[tx_fifo.back], payload,
-	       sizeof(struct nrf_esb_payload));
+	/* Lent payloads are returned through tx_released, which must be able
+	 * to hold all of them.
+	 */
+	if ((tx_fifo.count >= CONFIG_NRF_ESB_TX_FIFO_SIZE) ||
+	    (lend && (queued_payload_count() + tx_released.count >=
+		      TX_RELEASED_SIZE))) {
+		err = -ENOMEM;
+		goto out;
+	}
+
+	if (lend) {
+		entry = payload;
+	} else {
+		entry = &tx_payload_storage[tx_fifo.back];
+		entry->length = payload->length;
+		entry->pipe = payload->pipe;
+		entry->noack = payload->noack;
+		memcpy(entry->data, payload->data, payload->length);
+	}
+	tx_fifo.payload[tx_fifo.back] = entry;
+	latency_trace_tx_write(tx_fifo.back);
 
 	pids[payload->pipe] = (pids[payload->pipe] + 1) % (PID_MAX + 1);
-	tx_fifo.payload[tx_fifo.back]->pid = pids[payload->pipe];
+	entry->pid = pids[payload->pipe];
 
 	if (++tx_fifo.back >= CONFIG_NRF_ESB_TX_FIFO_SIZE) {
 		tx_fifo.back = 0;
@@ -1176,32 +2263,88 @@ int nrf_esb_write_payload(const struct nrf_esb_payload *payload)
 
 	tx_fifo.count++;
 
+out:
 	irq_unlock(key);
 
-	if (esb_cfg.mode == NRF_ESB_MODE_PTX &&
+	if (!err &&
+	    esb_cfg.mode == NRF_ESB_MODE_PTX &&
 	    esb_cfg.tx_mode == NRF_ESB_TXMODE_AUTO &&
 	    esb_state == ESB_STATE_IDLE) {
 		start_tx_transaction();
 	}
 
-	return 0;
+	return err;
 }
 
-int nrf_esb_read_rx_payload(struct nrf_esb_payload *payload)
+int nrf_esb_write_payload(const struct nrf_esb_payload *payload)
+{
+	int err = tx_payload_check(payload);
+
+	if (err) {
+		return err;
+	}
+
+	if (esb_cfg.mode == NRF_ESB_MODE_PRX) {
+		return ack_fifo_push((struct nrf_esb_payload *)payload, false);
+	}
+
+	return tx_fifo_push((struct nrf_esb_payload *)payload, false);
+}
+
+int nrf_esb_write_payload_nocopy(struct nrf_esb_payload *payload)
+{
+	int err = tx_payload_check(payload);
+
+	if (err) {
+		return err;
+	}
+
+	if (esb_cfg.mode == NRF_ESB_MODE_PRX) {
+		return ack_fifo_push(payload, true);
+	}
+
+	return tx_fifo_push(payload, true);
+}
+
+int nrf_esb_write_ack_payload(const struct nrf_esb_payload *payload)
+{
+	int err = tx_payload_check(payload);
+
+	if (err) {
+		return err;
+	}
+	if (esb_cfg.mode != NRF_ESB_MODE_PRX) {
+		return -EPERM;
+	}
+
+	return ack_fifo_push((struct nrf_esb_payload *)payload, false);
+}
+
+int nrf_esb_flush_ack_payloads(u8_t pipe)
 {
 	if (!esb_initialized) {
 		return -EACCES;
 	}
-	if (payload == NULL) {
+	if (pipe >= CONFIG_NRF_ESB_PIPE_COUNT) {
 		return -EINVAL;
 	}
 
-	if (rx_fifo.count == 0) {
-		return -ENODATA;
-	}
-
 	u32_t key = irq_lock();
 
+	ack_fifo_flush(pipe);
+
+	irq_unlock(key);
+
+	NVIC_SetPendingIRQ(ESB_EVT_IRQ);
+
+	return 0;
+}
+
+/* Move the payload at the front of the RX FIFO to the application.
+ * Must be called with interrupts locked.
+ */
+static void rx_fifo_pop(struct nrf_esb_payload *payload)
+{
 	payload->length = rx_fifo.payload[rx_fifo.front]->length;
 	payload->pipe = rx_fifo.payload[rx_fifo.front]->pipe;
 	payload->rssi = rx_fifo.payload[rx_fifo.front]->rssi;
@@ -1215,12 +2358,53 @@ int nrf_esb_read_rx_payload(struct nrf_esb_payload *payload)
 	}
 
 	rx_fifo.count--;
+}
+
+int nrf_esb_read_rx_payload(struct nrf_esb_payload *payload)
+{
+	if (!esb_initialized) {
+		return -EACCES;
+	}
+	if (payload == NULL) {
+		return -EINVAL;
+	}
+
+	if (rx_fifo.count == 0) {
+		return -ENODATA;
+	}
+
+	u32_t key = irq_lock();
+
+	rx_fifo_pop(payload);
 
 	irq_unlock(key);
 
 	return 0;
 }
 
+int nrf_esb_read_rx_payloads(struct nrf_esb_payload *payloads, size_t max)
+{
+	size_t count = 0;
+
+	if (!esb_initialized) {
+		return -EACCES;
+	}
+	if (payloads == NULL) {
+		return -EINVAL;
+	}
+
+	u32_t key = irq_lock();
+
+	while ((count < max) && (rx_fifo.count > 0)) {
+		rx_fifo_pop(&payloads[count]);
+		count++;
+	}
+
+	irq_unlock(key);
+
+	return count;
+}
+
 int nrf_esb_start_tx(void)
 {
 	if (esb_state != ESB_STATE_IDLE) {
@@ -1245,6 +2429,13 @@ int nrf_esb_start_rx(void)
 	NRF_RADIO->INTENCLR = 0xFFFFFFFF;
 	NRF_RADIO->EVENTS_DISABLED = 0;
 	on_radio_disabled = on_radio_disabled_rx;
+	on_radio_address = NULL;
+	on_radio_end = NULL;
+
+	rx_unreported = 0;
+	if (rx_event_moderated()) {
+		sys_timer_rx_event_init();
+	}
 
 	NRF_RADIO->SHORTS = radio_shorts_common |
 			    RADIO_SHORTS_DISABLED_TXEN_Msk;
@@ -1262,7 +2453,13 @@ int nrf_esb_start_rx(void)
 	NRF_RADIO->EVENTS_PAYLOAD = 0;
 	NRF_RADIO->EVENTS_DISABLED = 0;
 
-	NRF_RADIO->TASKS_RXEN = 1;
+	if (rx_duty_active()) {
+		rx_duty_start();
+	} else {
+		NRF_RADIO->TASKS_RXEN = 1;
+	}
+
+	hopping_prx_start();
 
 	return 0;
 }
@@ -1273,6 +2470,9 @@ int nrf_esb_stop_rx(void)
 		return -EINVAL;
 	}
 
+	hopping_prx_stop();
+	rx_duty_stop();
+
 	NRF_RADIO->SHORTS = 0;
 	NRF_RADIO->INTENCLR = 0xFFFFFFFF;
 	on_radio_disabled = NULL;
@@ -1282,6 +2482,16 @@ int nrf_esb_stop_rx(void)
 		/* wait for register to settle */
 	}
 
+	if (rx_event_moderated()) {
+		sys_timer_rx_event_uninit();
+
+		/* Report packets held back by RX event moderation. */
+		if (rx_unreported > 0) {
+			rx_unreported = 0;
+			NVIC_SetPendingIRQ(ESB_EVT_IRQ);
+		}
+	}
+
 	esb_state = ESB_STATE_IDLE;
 
 	return 0;
@@ -1295,12 +2505,16 @@ int nrf_esb_flush_tx(void)
 
 	u32_t key = irq_lock();
 
-	tx_fifo.count = 0;
-	tx_fifo.back = 0;
-	tx_fifo.front = 0;
+	tx_fifo_flush();
+
+	for (u8_t pipe = 0; pipe < CONFIG_NRF_ESB_PIPE_COUNT; pipe++) {
+		ack_fifo_flush(pipe);
+	}
 
 	irq_unlock(key);
 
+	NVIC_SetPendingIRQ(ESB_EVT_IRQ);
+
 	return 0;
 }
 
@@ -1309,19 +2523,28 @@ int nrf_esb_pop_tx(void)
 	if (!esb_initialized) {
 		return -EACCES;
 	}
+	if (esb_cfg.mode == NRF_ESB_MODE_PRX) {
+		/* ACK payloads are queued per pipe. */
+		return -ENOTSUP;
+	}
 	if (tx_fifo.count == 0) {
 		return -ENODATA;
 	}
 
 	u32_t key = irq_lock();
 
-	if (++tx_fifo.back >= CONFIG_NRF_ESB_TX_FIFO_SIZE) {
-		tx_fifo.back = 0;
+	if (tx_fifo.back == 0) {
+		tx_fifo.back = CONFIG_NRF_ESB_TX_FIFO_SIZE - 1;
+	} else {
+		tx_fifo.back--;
 	}
 	tx_fifo.count--;
+	tx_fifo_entry_release(tx_fifo.back);
 
 	irq_unlock(key);
 
+	NVIC_SetPendingIRQ(ESB_EVT_IRQ);
+
 	return 0;
 }
 
@@ -1681,6 +2904,55 @@ int nrf_esb_set_rf_channel(u32_t channel)
 	return 0;
 }
 
+#ifdef CONFIG_NRF_ESB_HOPPING
+int nrf_esb_set_hop_table(const u8_t *channels, u8_t count)
+{
+	if (esb_state != ESB_STATE_IDLE) {
+		return -EBUSY;
+	}
+	if ((count > CONFIG_NRF_ESB_HOPPING_TABLE_MAX_SIZE) ||
+	    ((count > 0) && (channels == NULL))) {
+		return -EINVAL;
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		if (channels[i] > 100) {
+			return -EINVAL;
+		}
+	}
+
+	memcpy(hopping.table, channels, count);
+	hopping.count = count;
+	hopping.index = 0;
+	hopping.misses = 0;
+
+	if (count > 0) {
+		esb_addr.rf_channel = hopping.table[0];
+	}
+
+	return 0;
+}
+#endif
+
+#ifdef CONFIG_NRF_ESB_RX_DUTY_CYCLE
+int nrf_esb_set_rx_duty_cycle(u32_t period_ms, u32_t window_us)
+{
+	if (esb_state != ESB_STATE_IDLE) {
+		return -EBUSY;
+	}
+	if ((period_ms > UINT32_MAX / USEC_PER_MSEC) ||
+	    ((period_ms > 0) &&
+	     ((window_us == 0) || (window_us >= period_ms * USEC_PER_MSEC)))) {
+		return -EINVAL;
+	}
+
+	rx_duty.period_us = period_ms * USEC_PER_MSEC;
+	rx_duty.window_us = window_us;
+
+	return 0;
+}
+#endif
+
 int nrf_esb_get_rf_channel(u32_t *channel)
 {
 	if (channel == NULL) {
@@ -1716,6 +2988,10 @@ int nrf_esb_set_retransmit_delay(u16_t delay)
 	}
 
 	esb_cfg.retransmit_delay = delay;
+#ifdef CONFIG_NRF_ESB_ADAPTIVE_RETRANSMIT
+	adaptive.base_delay = delay;
+#endif
+	adaptive_retransmit_reset();
 
 	return 0;
 }
@@ -1727,6 +3003,10 @@ int nrf_esb_set_retransmit_count(u16_t count)
 	}
 
 	esb_cfg.retransmit_count = count;
+#ifdef CONFIG_NRF_ESB_ADAPTIVE_RETRANSMIT
+	adaptive.base_count = count;
+#endif
+	adaptive_retransmit_reset();
 
 	return 0;
 }
@@ -1756,3 +3036,110 @@ int nrf_esb_reuse_pid(u8_t pipe)
 	return 0;
 }
 
+#ifdef CONFIG_NRF_ESB_STATS
+int nrf_esb_get_pipe_stats(u8_t pipe, struct nrf_esb_pipe_stats *stats)
+{
+	if (!(pipe < CONFIG_NRF_ESB_PIPE_COUNT) || (stats == NULL)) {
+		return -EINVAL;
+	}
+
+	u32_t key = irq_lock();
+
+	*stats = pipe_stats[pipe].counters;
+	stats->rssi_avg = (pipe_stats[pipe].rssi_avg + 128) >> 8;
+	stats->tx_attempts_avg = pipe_stats[pipe].tx_attempts_avg;
+
+	irq_unlock(key);
+
+	return 0;
+}
+
+int nrf_esb_reset_pipe_stats(u8_t pipe)
+{
+	if (!(pipe < CONFIG_NRF_ESB_PIPE_COUNT)) {
+		return -EINVAL;
+	}
+
+	u32_t key = irq_lock();
+
+	memset(&pipe_stats[pipe], 0, sizeof(pipe_stats[pipe]));
+
+	irq_unlock(key);
+
+	return 0;
+}
+#endif
+
+#ifdef CONFIG_NRF_ESB_LATENCY_TRACE
+static u32_t cycles_to_us(u64_t cycles)
+{
+	return (u32_t)(SYS_CLOCK_HW_CYCLES_TO_NS64(cycles) / NSEC_PER_USEC);
+}
+
+int nrf_esb_get_latency_stats(enum nrf_esb_latency_stage stage,
+			      struct nrf_esb_latency_stats *stats)
+{
+	if (!(stage < NRF_ESB_LATENCY_STAGE_COUNT) || (stats == NULL)) {
+		return -EINVAL;
+	}
+
+	u32_t key = irq_lock();
+	struct latency_stage entry = latency_stages[stage];
+
+	irq_unlock(key);
+
+	stats->count = entry.count;
+	stats->min_us = cycles_to_us(entry.min);
+	stats->max_us = cycles_to_us(entry.max);
+	stats->avg_us = (entry.count > 0) ?
+			cycles_to_us(entry.sum / entry.count) : 0;
+
+	return 0;
+}
+
+void nrf_esb_reset_latency_stats(void)
+{
+	u32_t key = irq_lock();
+
+	memset(latency_stages, 0, sizeof(latency_stages));
+
+	irq_unlock(key);
+}
+
+#ifdef CONFIG_PROFILER
+void nrf_esb_log_latency_stats(void)
+{
+	static u16_t profiler_event_id;
+	static bool profiler_event_registered;
+
+	if (!profiler_event_registered) {
+		const char *labels[] = {"stage", "count", "min_us", "avg_us",
+					"max_us"};
+		enum profiler_arg types[] = {PROFILER_ARG_U32,
+					     PROFILER_ARG_U32,
+					     PROFILER_ARG_U32,
+					     PROFILER_ARG_U32,
+					     PROFILER_ARG_U32};
+
+		profiler_event_id = profiler_register_event_type(
+			"esb_latency", labels, types, ARRAY_SIZE(types));
+		profiler_event_registered = true;
+	}
+
+	for (u32_t stage = 0; stage < NRF_ESB_LATENCY_STAGE_COUNT; stage++) {
+		struct nrf_esb_latency_stats stats;
+		struct log_event_buf buf;
+
+		nrf_esb_get_latency_stats(stage, &stats);
+
+		profiler_log_start(&buf);
+		profiler_log_encode_u32(&buf, stage);
+		profiler_log_encode_u32(&buf, stats.count);
+		profiler_log_encode_u32(&buf, stats.min_us);
+		profiler_log_encode_u32(&buf, stats.avg_us);
+		profiler_log_encode_u32(&buf, stats.max_us);
+		profiler_log_send(&buf, profiler_event_id);
+	}
+}
+#endif /* CONFIG_PROFILER */
+#endif /* CONFIG_NRF_ESB_LATENCY_TRACE */
@@ -0,0 +1,296 @@
+/*
+ * Copyright (c) 2018 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+#include <errno.h>
+#include <irq.h>
+#include <misc/byteorder.h>
+#include <nrf_esb.h>
+#include <nrf_esb_frag.h>
+#include <stddef.h>
+#include <string.h>
+#include <toolchain.h>
+
+/* Fragment header: flags and message sequence number in the first byte,
+ * followed by the offset of the fragment in the message (little endian).
+ */
+#define FRAG_HDR_FIRST BIT(7)
+#define FRAG_HDR_LAST BIT(6)
+#define FRAG_HDR_SEQ_MSK 0x3F
+
+#define FRAG_TX_BUF_COUNT CONFIG_NRF_ESB_TX_FIFO_SIZE
+
+BUILD_ASSERT_MSG(CONFIG_NRF_ESB_MAX_PAYLOAD_LENGTH > NRF_ESB_FRAG_HEADER_SIZE,
+		 "Payloads are too small for fragmentation");
+
+/* Message being sent. */
+static struct {
+	const u8_t *data;
+	size_t length;
+	size_t offset;		/* Offset of the next fragment to queue. */
+	u8_t pipe;
+	u8_t seq;
+	u8_t pending;		/* Fragments queued but not yet released. */
+	bool noack;
+	bool active;
+} tx;
+
+/* Fragment buffers lent to the ESB module. */
+static struct nrf_esb_payload tx_buf[FRAG_TX_BUF_COUNT];
+static u8_t tx_buf_free[FRAG_TX_BUF_COUNT];
+static u8_t tx_buf_free_count;
+static bool tx_buf_lent[FRAG_TX_BUF_COUNT];
+
+/* Message being reassembled on each pipe. */
+struct rx_message {
+	u8_t data[CONFIG_NRF_ESB_FRAG_MAX_MESSAGE_SIZE];
+	size_t length;
+	u8_t seq;
+	bool active;
+};
+
+static struct rx_message rx_message[CONFIG_NRF_ESB_PIPE_COUNT];
+
+static nrf_esb_frag_event_handler_t event_handler;
+
+static void tx_buf_reset(void)
+{
+	for (size_t i = 0; i < FRAG_TX_BUF_COUNT; i++) {
+		tx_buf_free[i] = i;
+		tx_buf_lent[i] = false;
+	}
+	tx_buf_free_count = FRAG_TX_BUF_COUNT;
+	tx.pending = 0;
+}
+
+/* Queue fragments of the current message until the TX FIFO is full. */
+static int tx_fill(void)
+{
+	while (tx.active && (tx.offset < tx.length) &&
+	       (tx_buf_free_count > 0)) {
+		u8_t index = tx_buf_free[tx_buf_free_count - 1];
+		struct nrf_esb_payload *payload = &tx_buf[index];
+		size_t len = min(tx.length - tx.offset,
+				 (size_t)NRF_ESB_FRAG_DATA_SIZE);
+		u8_t flags = 0;
+		int err;
+
+		if (tx.offset == 0) {
+			flags |= FRAG_HDR_FIRST;
+		}
+		if (tx.offset + len == tx.length) {
+			flags |= FRAG_HDR_LAST;
+		}
+
+		payload->pipe = tx.pipe;
+		payload->noack = tx.noack;
+		payload->length = NRF_ESB_FRAG_HEADER_SIZE + len;
+		payload->data[0] = flags | tx.seq;
+		sys_put_le16(tx.offset, &payload->data[1]);
+		memcpy(&payload->data[NRF_ESB_FRAG_HEADER_SIZE],
+		       &tx.data[tx.offset], len);
+
+		err = nrf_esb_write_payload_nocopy(payload);
+		if (err == -ENOMEM) {
+			/* More fragments are queued when this one is
+			 * released.
+			 */
+			break;
+		} else if (err) {
+			return err;
+		}
+
+		tx_buf_lent[index] = true;
+		tx_buf_free_count--;
+		tx.pending++;
+		tx.offset += len;
+	}
+
+	return 0;
+}
+
+static void tx_done(enum nrf_esb_frag_evt_id evt_id)
+{
+	struct nrf_esb_frag_evt event = {
+		.evt_id = evt_id,
+		.pipe = tx.pipe,
+		.data = tx.data,
+		.length = tx.length,
+	};
+
+	tx.active = false;
+	tx.seq = (tx.seq + 1) & FRAG_HDR_SEQ_MSK;
+
+	if (event_handler != NULL) {
+		event_handler(&event);
+	}
+}
+
+static bool tx_process(const struct nrf_esb_evt *event)
+{
+	ptrdiff_t index = event->payload - tx_buf;
+
+	if ((event->payload == NULL) || (index < 0) ||
+	    (index >= FRAG_TX_BUF_COUNT)) {
+		return false;
+	}
+
+	/* A buffer that is not lent anymore has been reclaimed by
+	 * nrf_esb_frag_init, so its release must not be counted again.
+	 */
+	if (!tx_buf_lent[index]) {
+		return true;
+	}
+
+	tx_buf_lent[index] = false;
+	tx_buf_free[tx_buf_free_count++] = index;
+	tx.pending--;
+
+	if (!tx.active) {
+		return true;
+	}
+
+	if (event->evt_id == NRF_ESB_EVENT_TX_FAILED) {
+		/* The remaining fragments are useless to the receiver. The
+		 * flush returns the lent buffers in TX failed events.
+		 */
+		nrf_esb_flush_tx();
+		tx_done(NRF_ESB_FRAG_EVENT_TX_FAILED);
+	} else if (tx_fill()) {
+		nrf_esb_flush_tx();
+		tx_done(NRF_ESB_FRAG_EVENT_TX_FAILED);
+	} else if ((tx.offset == tx.length) && (tx.pending == 0)) {
+		tx_done(NRF_ESB_FRAG_EVENT_TX_SUCCESS);
+	}
+
+	return true;
+}
+
+static void rx_fragment(const struct nrf_esb_payload *payload)
+{
+	struct rx_message *msg = &rx_message[payload->pipe];
+	const u8_t *data = &payload->data[NRF_ESB_FRAG_HEADER_SIZE];
+	size_t len = payload->length - NRF_ESB_FRAG_HEADER_SIZE;
+	u8_t flags = payload->data[0];
+	u8_t seq = flags & FRAG_HDR_SEQ_MSK;
+	u16_t offset = sys_get_le16(&payload->data[1]);
+
+	if (flags & FRAG_HDR_FIRST) {
+		/* A new message discards any incomplete one. */
+		msg->active = true;
+		msg->seq = seq;
+		msg->length = 0;
+	}
+
+	/* Fragments arrive in order, so a gap means that a fragment has
+	 * been lost and the message cannot be completed.
+	 */
+	if (!msg->active || (seq != msg->seq) || (offset != msg->length) ||
+	    (len > sizeof(msg->data) - msg->length)) {
+		msg->active = false;
+		return;
+	}
+
+	memcpy(&msg->data[msg->length], data, len);
+	msg->length += len;
+
+	if (flags & FRAG_HDR_LAST) {
+		struct nrf_esb_frag_evt event = {
+			.evt_id = NRF_ESB_FRAG_EVENT_RX_RECEIVED,
+			.pipe = payload->pipe,
+			.data = msg->data,
+			.length = msg->length,
+		};
+
+		msg->active = false;
+
+		if (event_handler != NULL) {
+			event_handler(&event);
+		}
+	}
+}
+
+static void rx_process(void)
+{
+	/* Only used from the ESB event interrupt, kept off its stack. */
+	static struct nrf_esb_payload payload;
+
+	while (nrf_esb_read_rx_payload(&payload) == 0) {
+		if ((payload.length > NRF_ESB_FRAG_HEADER_SIZE) &&
+		    (payload.pipe < CONFIG_NRF_ESB_PIPE_COUNT)) {
+			rx_fragment(&payload);
+		}
+	}
+}
+
+int nrf_esb_frag_init(nrf_esb_frag_event_handler_t handler)
+{
+	u32_t key = irq_lock();
+
+	event_handler = handler;
+	tx.active = false;
+	tx_buf_reset();
+
+	for (size_t pipe = 0; pipe < CONFIG_NRF_ESB_PIPE_COUNT; pipe++) {
+		rx_message[pipe].active = false;
+	}
+
+	irq_unlock(key);
+
+	return 0;
+}
+
+int nrf_esb_frag_send(u8_t pipe, const u8_t *data, size_t length,
+		      bool noack)
+{
+	int err;
+
+	if ((data == NULL) || (pipe >= CONFIG_NRF_ESB_PIPE_COUNT)) {
+		return -EINVAL;
+	}
+	if ((length == 0) || (length > CONFIG_NRF_ESB_FRAG_MAX_MESSAGE_SIZE)) {
+		return -EMSGSIZE;
+	}
+
+	u32_t key = irq_lock();
+
+	/* Buffers of an aborted message may not all be released yet. */
+	if (tx.active || (tx.pending > 0)) {
+		irq_unlock(key);
+		return -EBUSY;
+	}
+
+	tx.data = data;
+	tx.length = length;
+	tx.offset = 0;
+	tx.pipe = pipe;
+	tx.noack = noack;
+	tx.active = true;
+
+	err = tx_fill();
+	if (err || (tx.pending == 0)) {
+		/* Nothing has been queued, so the message is not started. */
+		tx.active = false;
+		irq_unlock(key);
+		return err ? err : -ENOMEM;
+	}
+
+	irq_unlock(key);
+
+	return 0;
+}
+
+bool nrf_esb_frag_process_event(const struct nrf_esb_evt *event)
+{
+	switch (event->evt_id) {
+	case NRF_ESB_EVENT_TX_SUCCESS:
+	case NRF_ESB_EVENT_TX_FAILED:
+		return tx_process(event);
+	case NRF_ESB_EVENT_RX_RECEIVED:
+		rx_process();
+		return true;
+	default:
+		return false;
+	}
+}
@@ -18,22 +18,14 @@
 #include "mqtt_internal.h"
 #include "mqtt_os.h"
 
-/** Number of buffers needed per client - one for RX and one for TX */
-#define BUFFER_COUNT_PER_CLIENT 2
-
-/** Total number of buffers needed by the module. */
-#define TOTAL_BUFFER_COUNT (BUFFER_COUNT_PER_CLIENT * MQTT_MAX_CLIENTS)
-
 /** MQTT Client table. */
 static struct mqtt_client *mqtt_client[MQTT_MAX_CLIENTS];
 
-/** Mutex used by MQTT implementation. */
-struct k_mutex mqtt_mutex;
-
-/** Memory slab submitted to the MQTT memory management.*/
-struct k_mem_slab mqtt_slab;
-static char __aligned(4) mqtt_slab_buffer[TOTAL_BUFFER_COUNT *
-					  MQTT_MAX_PACKET_LENGTH];
+/** Mutex protecting the client table. Client instances are protected by
+ *  their own mutex, which may be held when this mutex is taken, not the
+ *  other way around.
+ */
+static struct k_mutex mqtt_table_mutex;
 
 static u32_t get_client_index(struct mqtt_client *client)
 {
@@ -49,31 +41,25 @@ static u32_t get_client_index(struct mqtt_client *client)
 static void client_free(struct mqtt_client *client)
 {
 	MQTT_STATE_INIT(client);
-
-	/* Free memory used for TX packets and reset the pointer. */
-	if (client->tx_buf != NULL) {
-		mqtt_free(client->tx_buf);
-		client->tx_buf = NULL;
-	}
-
-	if (client->rx_buf != NULL) {
-		mqtt_free(client->rx_buf);
-		client->rx_buf = NULL;
-	}
 }
 
-static void client_init(struct mqtt_client *client)
+static void client_init(struct mqtt_client *client, u8_t *rx_buf,
+			u32_t rx_buf_size, u8_t *tx_buf, u32_t tx_buf_size)
 {
 	memset(client, 0, sizeof(*client));
 
 	MQTT_STATE_INIT(client);
 
+	mqtt_mutex_init(client);
+
 	client->protocol_version = MQTT_VERSION_3_1_1;
 	client->clean_session = 1;
+	client->keepalive = MQTT_KEEPALIVE;
 
-	/* Allocate buffer packets in TX and RX path. */
-	client->tx_buf = mqtt_malloc(MQTT_MAX_PACKET_LENGTH);
-	client->rx_buf = mqtt_malloc(MQTT_MAX_PACKET_LENGTH);
+	client->rx_buf = rx_buf;
+	client->rx_buf_size = rx_buf_size;
+	client->tx_buf = tx_buf;
+	client->tx_buf_size = tx_buf_size;
 }
 
 /**@brief Notifies event to the application.
@@ -87,11 +73,11 @@ void event_notify(struct mqtt_client *client, const struct mqtt_evt *evt,
 	const mqtt_evt_cb_t evt_cb = client->evt_cb;
 
 	if (evt_cb != NULL) {
-		mqtt_mutex_unlock();
+		mqtt_mutex_unlock(client);
 
 		evt_cb(client, evt);
 
-		mqtt_mutex_lock();
+		mqtt_mutex_lock(client);
 	}
 }
 
@@ -102,14 +88,19 @@ void event_notify(struct mqtt_client *client, const struct mqtt_evt *evt,
  */
 static void disconnect_event_notify(struct mqtt_client *client, int result)
 {
-	const u32_t client_index = get_client_index(client);
+	u32_t client_index;
 	struct mqtt_evt evt;
 
 	/* Remove the client from internal table. */
+	k_mutex_lock(&mqtt_table_mutex, K_FOREVER);
+
+	client_index = get_client_index(client);
 	if (client_index != MQTT_MAX_CLIENTS) {
 		mqtt_client[client_index] = NULL;
 	}
 
+	k_mutex_unlock(&mqtt_table_mutex);
+
 	/* Determine appropriate event to generate. */
 	if (MQTT_VERIFY_STATE(client, MQTT_STATE_CONNECTED) ||
 	    MQTT_VERIFY_STATE(client, MQTT_STATE_DISCONNECTING)) {
@@ -153,32 +144,74 @@ static int client_disconnect(struct mqtt_client *client, int result)
 	return err_code;
 }
 
-static int client_connect(struct mqtt_client *client)
+/**@brief Sends the connection request to the broker once the transport is
+ *        connected.
+ *
+ * @param[in] client Identifies the client for which the procedure is requested.
+ *
+ * @retval 0 or an error code indicating reason for failure.
+ */
+static int client_connect_request_send(struct mqtt_client *client)
 {
-	int err_code = mqtt_transport_connect(client);
+	int err_code;
 	const u8_t *packet;
 	u32_t packetlen;
 
+	MQTT_SET_STATE(client, MQTT_STATE_TCP_CONNECTED);
+
+	err_code = connect_request_encode(client, &packet, &packetlen);
+
 	if (err_code == 0) {
-		MQTT_SET_STATE(client, MQTT_STATE_TCP_CONNECTED);
+		/* Send MQTT identification message to broker. */
+		MQTT_SET_STATE(client, MQTT_STATE_PENDING_WRITE);
 
-		err_code = connect_request_encode(client, &packet, &packetlen);
+		err_code = mqtt_transport_write(client, packet, packetlen);
 
-		if (err_code == 0) {
-			/* Send MQTT identification message to broker. */
-			MQTT_SET_STATE(client, MQTT_STATE_PENDING_WRITE);
+		MQTT_RESET_STATE(client, MQTT_STATE_PENDING_WRITE);
+	}
 
-			err_code = mqtt_transport_write(client, packet,
-							packetlen);
+	if (err_code == 0) {
+		client->last_activity = mqtt_sys_tick_in_ms_get();
+	} else {
+		client_abort(client);
+	}
 
-			MQTT_RESET_STATE(client, MQTT_STATE_PENDING_WRITE);
-		}
+	return err_code;
+}
 
-		if (err_code == 0) {
-			client->last_activity = mqtt_sys_tick_in_ms_get();
-		} else {
-			client_abort(client);
-		}
+static int client_connect(struct mqtt_client *client, bool shall_block)
+{
+	int err_code;
+
+	client->rx_buf_datalen = 0;
+	client->rx_payload_remaining = 0;
+	client->ping_pending = 0;
+	client->keepalive_interval = client->keepalive;
+
+#if defined(CONFIG_MQTT_LIB_PUBLISH_COALESCING)
+	client->coalesce_len = 0;
+#endif
+
+#if defined(CONFIG_MQTT_LIB_PROTOCOL_V5)
+	/* Topic aliases do not survive the connection. */
+	memset(client->topic_alias, 0, sizeof(client->topic_alias));
+	client->topic_alias_max = 0;
+	client->topic_alias_next = 0;
+#endif
+
+	err_code = mqtt_transport_connect(client, shall_block);
+
+	if (err_code == -EINPROGRESS) {
+		/* Completed by client_connect_continue. */
+		MQTT_SET_STATE(client, MQTT_STATE_TCP_CONNECTING);
+
+		MQTT_TRC("Connect in progress");
+
+		return 0;
+	}
+
+	if (err_code == 0) {
+		err_code = client_connect_request_send(client);
 	}
 
 	MQTT_TRC("Connect completed");
@@ -186,14 +219,108 @@ static int client_connect(struct mqtt_client *client)
 	return err_code;
 }
 
-static int client_read(struct mqtt_client *client)
+/**@brief Advances a nonblocking connection of the client. Once the transport
+ *        is connected, the connection request is sent to the broker.
+ *
+ * @param[in] client Identifies the client for which the procedure is requested.
+ *
+ * @retval 0 or an error code indicating reason for failure.
+ */
+static int client_connect_continue(struct mqtt_client *client)
+{
+	struct mqtt_evt evt = {
+		.type = MQTT_EVT_TRANSPORT_CONNECTED,
+		.result = 0
+	};
+	int err_code;
+
+	err_code = mqtt_transport_connect_continue(client);
+	if (err_code == -EINPROGRESS) {
+		return 0;
+	}
+
+	MQTT_RESET_STATE(client, MQTT_STATE_TCP_CONNECTING);
+
+	if (err_code != 0) {
+		/* The transport is closed already. */
+		disconnect_event_notify(client, err_code);
+		return err_code;
+	}
+
+	err_code = client_connect_request_send(client);
+	if (err_code == 0) {
+		event_notify(client, &evt, MQTT_EVT_FLAG_NONE);
+	}
+
+	return err_code;
+}
+
+#if defined(CONFIG_MQTT_LIB_PUBLISH_STREAMING)
+/**@brief Gets the number of bytes to read from the transport. Reading stops at
+ *        the end of each frame, so that the payload of a Publish packet is
+ *        left on the transport for the application.
+ *
+ * @param[in] client Identifies the client for which the procedure is requested.
+ * @param[out] length Number of bytes to read.
+ *
+ * @retval 0 or an error code indicating reason for failure.
+ */
+static int client_read_length_get(struct mqtt_client *client, u32_t *length)
 {
-	u32_t data_len = MQTT_MAX_PACKET_LENGTH - client->rx_buf_datalen;
+	u32_t offset;
+	u32_t frame_length;
+	u32_t packet_length;
+	int err_code;
+
+	if (client->rx_payload_remaining > 0) {
+		/* Skip payload that was not read by the application. */
+		*length = min(client->rx_payload_remaining,
+			      client->rx_buf_size);
+		return 0;
+	}
+
+	err_code = frame_length_decode(client, client->rx_buf,
+				       client->rx_buf_datalen, &offset,
+				       &frame_length, &packet_length);
+	if ((err_code != 0) && (err_code != -EAGAIN)) {
+		return err_code;
+	}
+
+	if (frame_length > client->rx_buf_size) {
+		return -EMSGSIZE;
+	}
+
+	*length = frame_length - client->rx_buf_datalen;
+
+	return 0;
+}
+#endif /* CONFIG_MQTT_LIB_PUBLISH_STREAMING */
+
+/**@brief Reads data from the transport and handles the received packets.
+ *
+ * @param[in] client Identifies the client for which the procedure is requested.
+ *
+ * @retval Number of bytes read, 0 if no data was read or an error code
+ *         indicating reason for failure.
+ */
+static int client_read_chunk(struct mqtt_client *client)
+{
+	u32_t data_len = client->rx_buf_size - client->rx_buf_datalen;
 	int err_code = 0;
 
+#if defined(CONFIG_MQTT_LIB_PUBLISH_STREAMING)
+	err_code = client_read_length_get(client, &data_len);
+	if (err_code < 0) {
+		MQTT_TRC("Cannot handle received data, error = %d, "
+			 "closing connection", err_code);
+		client_disconnect(client, -EIO);
+		return -EIO;
+	}
+#endif
+
 	err_code = mqtt_transport_read(client,
 				       client->rx_buf + client->rx_buf_datalen,
-				       &data_len);
+				       &data_len, false);
 
 	if (err_code < 0) {
 		if (err_code == -EAGAIN) {
@@ -209,6 +336,10 @@ static int client_read(struct mqtt_client *client)
 			/* Receiving 0 bytes indicates an orderly shutdown. */
 			MQTT_TRC("Received end of stream, closing connection");
 			err_code = client_disconnect(client, 0);
+		} else if (client->rx_payload_remaining > 0) {
+			/* Discard payload not read by the application. */
+			client->rx_payload_remaining -= data_len;
+			err_code = data_len;
 		} else {
 			u32_t processed_length = 0;
 
@@ -233,6 +364,8 @@ static int client_read(struct mqtt_client *client)
 					    client->rx_buf + processed_length,
 					    client->rx_buf_datalen);
 				}
+
+				err_code = data_len;
 			}
 		}
 	}
@@ -240,11 +373,74 @@ static int client_read(struct mqtt_client *client)
 	return err_code;
 }
 
-static int client_write(struct mqtt_client *client, const u8_t *data,
-			u32_t datalen)
+static int client_read(struct mqtt_client *client)
+{
+	int err_code = client_read_chunk(client);
+
+#if defined(CONFIG_MQTT_LIB_PUBLISH_STREAMING)
+	/* Frames are read one by one, continue until all the data available
+	 * on the transport is handled.
+	 */
+	while (err_code > 0) {
+		err_code = client_read_chunk(client);
+	}
+#endif
+
+	return (err_code < 0) ? err_code : 0;
+}
+
+#if defined(CONFIG_MQTT_LIB_PUBLISH_COALESCING)
+/**@brief Writes the coalesced publish messages to the transport.
+ *
+ * @param[in] client Identifies the client for which the procedure is requested.
+ *
+ * @retval 0 or an error code indicating reason for failure.
+ */
+static int client_coalesce_flush(struct mqtt_client *client)
 {
 	int err_code;
 
+	if (client->coalesce_len == 0) {
+		return 0;
+	}
+
+	MQTT_TRC("[%p]: Transport writing %d coalesced bytes.", client,
+		 client->coalesce_len);
+
+	MQTT_SET_STATE(client, MQTT_STATE_PENDING_WRITE);
+
+	err_code = mqtt_transport_write(client, client->coalesce_buf,
+					client->coalesce_len);
+
+	MQTT_RESET_STATE(client, MQTT_STATE_PENDING_WRITE);
+
+	client->coalesce_len = 0;
+
+	if (err_code != 0) {
+		MQTT_TRC("TCP write failed, errno = %d, "
+			 "closing connection", errno);
+		client_disconnect(client, err_code);
+		return -EIO;
+	}
+
+	client->last_activity = mqtt_sys_tick_in_ms_get();
+
+	return 0;
+}
+#endif /* CONFIG_MQTT_LIB_PUBLISH_COALESCING */
+
+int client_write(struct mqtt_client *client, const u8_t *data,
+		 u32_t datalen)
+{
+	int err_code;
+
+#if defined(CONFIG_MQTT_LIB_PUBLISH_COALESCING)
+	/* Keep the order of packets, coalesced messages are sent first. */
+	if (client_coalesce_flush(client) != 0) {
+		return -EIO;
+	}
+#endif
+
 	MQTT_TRC("[%p]: Transport writing %d bytes.", client, datalen);
 
 	MQTT_SET_STATE(client, MQTT_STATE_PENDING_WRITE);
@@ -266,34 +462,70 @@ static int client_write(struct mqtt_client *client, const u8_t *data,
 	return 0;
 }
 
-int mqtt_init(void)
+int client_write_msg(struct mqtt_client *client, struct msghdr *message)
 {
-	mqtt_mutex_init();
+	int err_code;
 
-	mqtt_mutex_lock();
+#if defined(CONFIG_MQTT_LIB_PUBLISH_COALESCING)
+	/* Keep the order of packets, coalesced messages are sent first. */
+	if (client_coalesce_flush(client) != 0) {
+		return -EIO;
+	}
+#endif
 
-	memset(mqtt_client, 0, sizeof(mqtt_client));
+	MQTT_TRC("[%p]: Transport writing message.", client);
 
-	k_mem_slab_init(&mqtt_slab, mqtt_slab_buffer,
-			MQTT_MAX_PACKET_LENGTH, TOTAL_BUFFER_COUNT);
+	MQTT_SET_STATE(client, MQTT_STATE_PENDING_WRITE);
 
-	mqtt_mutex_unlock();
+	err_code = mqtt_transport_write_msg(client, message);
+
+	MQTT_RESET_STATE(client, MQTT_STATE_PENDING_WRITE);
+
+	if (err_code != 0) {
+		MQTT_TRC("TCP write failed, errno = %d, "
+			 "closing connection", errno);
+		client_disconnect(client, err_code);
+		return -EIO;
+	}
+
+	MQTT_TRC("[%p]: Transport write complete.", client);
+	client->last_activity = mqtt_sys_tick_in_ms_get();
 
 	return 0;
 }
 
-void mqtt_client_init(struct mqtt_client *client)
+int mqtt_init(void)
 {
-	NULL_PARAM_CHECK_VOID(client);
+	k_mutex_init(&mqtt_table_mutex);
 
-	mqtt_mutex_lock();
+	memset(mqtt_client, 0, sizeof(mqtt_client));
 
-	client_init(client);
+#if defined(CONFIG_MQTT_LIB_QUEUE)
+	return queue_init();
+#else
+	return 0;
+#endif
+}
+
+void mqtt_client_init(struct mqtt_client *client, u8_t *rx_buf,
+		      u32_t rx_buf_size, u8_t *tx_buf, u32_t tx_buf_size)
+{
+	NULL_PARAM_CHECK_VOID(client);
+	NULL_PARAM_CHECK_VOID(rx_buf);
+	NULL_PARAM_CHECK_VOID(tx_buf);
 
-	mqtt_mutex_unlock();
+	client_init(client, rx_buf, rx_buf_size, tx_buf, tx_buf_size);
 }
 
-int mqtt_connect(struct mqtt_client *client)
+/**@brief Registers the client and starts connecting it to the broker.
+ *
+ * @param[in] client Identifies the client for which the procedure is requested.
+ * @param[in] shall_block If false, return once the transport connection is
+ *                        initiated.
+ *
+ * @retval 0 or an error code indicating reason for failure.
+ */
+static int connect_start(struct mqtt_client *client, bool shall_block)
 {
 	/* Look for a free instance if available. */
 	int err_code;
@@ -302,7 +534,14 @@ int mqtt_connect(struct mqtt_client *client)
 	NULL_PARAM_CHECK(client);
 	NULL_PARAM_CHECK(client->client_id.utf8);
 
-	mqtt_mutex_lock();
+	if ((client->tx_buf_size <= MQTT_FIXED_HEADER_EXTENDED_SIZE) ||
+	    (client->rx_buf_size <= MQTT_FIXED_HEADER_EXTENDED_SIZE)) {
+		return -EINVAL;
+	}
+
+	mqtt_mutex_lock(client);
+
+	k_mutex_lock(&mqtt_table_mutex, K_FOREVER);
 
 	for (client_index = 0; client_index < MQTT_MAX_CLIENTS;
 	     client_index++) {
@@ -313,25 +552,47 @@ int mqtt_connect(struct mqtt_client *client)
 		}
 	}
 
-	if ((client_index == MQTT_MAX_CLIENTS) || (client->tx_buf == NULL) ||
-	    (client->rx_buf == NULL)) {
+	k_mutex_unlock(&mqtt_table_mutex);
+
+	if (client_index == MQTT_MAX_CLIENTS) {
 		client_free(client);
 		err_code = -ENOMEM;
 	} else {
-		err_code = client_connect(client);
+		err_code = client_connect(client, shall_block);
 		if (err_code != 0) {
 			/* Free the instance. */
 			client_free(client);
+
+			k_mutex_lock(&mqtt_table_mutex, K_FOREVER);
 			mqtt_client[client_index] = NULL;
+			k_mutex_unlock(&mqtt_table_mutex);
+
 			err_code = -ECONNREFUSED;
 		}
 	}
 
-	mqtt_mutex_unlock();
+	mqtt_mutex_unlock(client);
 
 	return err_code;
 }
 
+int mqtt_connect(struct mqtt_client *client)
+{
+	return connect_start(client, true);
+}
+
+int mqtt_connect_async(struct mqtt_client *client)
+{
+#if defined(CONFIG_NET_SOCKETS_OFFLOAD)
+	/* Offloaded sockets have no fcntl to make them nonblocking. */
+	NULL_PARAM_CHECK(client);
+
+	return -ENOTSUP;
+#else
+	return connect_start(client, false);
+#endif
+}
+
 static int verify_tx_state(const struct mqtt_client *client)
 {
 	if (MQTT_VERIFY_STATE(client, MQTT_STATE_PENDING_WRITE)) {
@@ -345,12 +606,215 @@ static int verify_tx_state(const struct mqtt_client *client)
 	return 0;
 }
 
-int mqtt_publish(struct mqtt_client *client,
-		 const struct mqtt_publish_param *param)
+#if defined(CONFIG_MQTT_LIB_PROTOCOL_V5)
+/**@brief Gets the outbound topic alias for a topic. Topics without an alias
+ *        are mapped to a free alias, or take over the aliases in turn
+ *        when all aliases accepted by the broker are in use.
+ *
+ * @param[in] client Identifies the client publishing on the topic.
+ * @param[in] topic Topic of the message.
+ * @param[out] mapped Set if the broker already knows the alias, so the topic
+ *                    need not be sent.
+ *
+ * @return Topic alias, or 0 if no alias is to be used.
+ */
+static u16_t client_topic_alias_get(struct mqtt_client *client,
+				    const struct mqtt_utf8 *topic,
+				    bool *mapped)
+{
+	u16_t count = min(client->topic_alias_max,
+			  ARRAY_SIZE(client->topic_alias));
+	u16_t free_index = count;
+	u16_t index;
+
+	*mapped = false;
+
+	if ((client->protocol_version != MQTT_VERSION_5_0) ||
+	    (topic->size == 0) ||
+	    (topic->size > sizeof(client->topic_alias[0].topic))) {
+		return 0;
+	}
+
+	for (index = 0; index < count; index++) {
+		struct mqtt_topic_alias *alias = &client->topic_alias[index];
+
+		if ((alias->size == topic->size) &&
+		    (memcmp(alias->topic, topic->utf8, topic->size) == 0)) {
+			*mapped = true;
+			return index + 1;
+		}
+
+		if ((alias->size == 0) && (free_index == count)) {
+			free_index = index;
+		}
+	}
+
+	if (count == 0) {
+		/* Broker does not accept topic aliases. */
+		return 0;
+	}
+
+	if (free_index == count) {
+		free_index = client->topic_alias_next;
+		client->topic_alias_next = (free_index + 1) % count;
+	}
+
+	memcpy(client->topic_alias[free_index].topic, topic->utf8,
+	       topic->size);
+	client->topic_alias[free_index].size = topic->size;
+
+	return free_index + 1;
+}
+#endif /* CONFIG_MQTT_LIB_PROTOCOL_V5 */
+
+int client_publish(struct mqtt_client *client,
+		   const struct mqtt_publish_param *param)
 {
 	int err_code;
 	const u8_t *packet;
 	u32_t packetlen;
+	u16_t topic_alias = 0;
+
+#if defined(CONFIG_MQTT_LIB_PAYLOAD_CODEC)
+	const struct mqtt_payload_codec *codec = client->payload_codec;
+	struct mqtt_publish_param encoded_param;
+
+	if ((codec != NULL) && (codec->encode != NULL)) {
+		/* The payload length is part of the fixed header, so the
+		 * payload is transformed before the header is encoded.
+		 */
+		encoded_param = *param;
+		err_code = codec->encode(codec->ctx, &param->message.topic,
+					 &param->message.payload,
+					 &encoded_param.message.payload);
+		if (err_code != 0) {
+			MQTT_TRC("Payload encoding failed: %d", err_code);
+			return err_code;
+		}
+
+		param = &encoded_param;
+	}
+#endif /* CONFIG_MQTT_LIB_PAYLOAD_CODEC */
+
+#if defined(CONFIG_MQTT_LIB_PROTOCOL_V5)
+	struct mqtt_publish_param aliased_param;
+	bool mapped;
+
+	topic_alias = client_topic_alias_get(client,
+					     &param->message.topic.topic,
+					     &mapped);
+	if (mapped) {
+		/* Topic is sent as a zero length string. */
+		aliased_param = *param;
+		aliased_param.message.topic.topic.size = 0;
+		param = &aliased_param;
+	}
+#endif
+
+	err_code = publish_encode(client, param, topic_alias, &packet,
+				  &packetlen);
+
+#if defined(CONFIG_MQTT_LIB_PROTOCOL_V5)
+	if ((err_code != 0) && (topic_alias != 0) && !mapped) {
+		/* The broker never learns the new alias. */
+		client->topic_alias[topic_alias - 1].size = 0;
+	}
+#endif
+
+#if defined(CONFIG_MQTT_LIB_PUBLISH_COALESCING)
+	if (err_code == 0) {
+		const u32_t length = packetlen + param->message.payload.len;
+
+		if (length > sizeof(client->coalesce_buf) -
+			     client->coalesce_len) {
+			err_code = client_coalesce_flush(client);
+			if (err_code != 0) {
+				return err_code;
+			}
+		}
+
+		/* Larger messages are sent directly. */
+		if (length <= sizeof(client->coalesce_buf)) {
+			u8_t *dst = client->coalesce_buf + client->coalesce_len;
+
+			if (client->coalesce_len == 0) {
+				client->coalesce_timestamp =
+					mqtt_sys_tick_in_ms_get();
+			}
+
+			memcpy(dst, packet, packetlen);
+			memcpy(dst + packetlen, param->message.payload.data,
+			       param->message.payload.len);
+			client->coalesce_len += length;
+
+			return 0;
+		}
+	}
+#endif /* CONFIG_MQTT_LIB_PUBLISH_COALESCING */
+
+	if (err_code == 0) {
+		struct iovec io_vector[2] = {
+			{
+				.iov_base = (void *)packet,
+				.iov_len = packetlen
+			},
+			{
+				.iov_base = param->message.payload.data,
+				.iov_len = param->message.payload.len
+			}
+		};
+		struct msghdr msg = {
+			.msg_iov = io_vector,
+			.msg_iovlen = ARRAY_SIZE(io_vector)
+		};
+
+		err_code = client_write_msg(client, &msg);
+	}
+
+	return err_code;
+}
+
+#if defined(CONFIG_MQTT_LIB_QUEUE)
+static void client_queue_replay(struct mqtt_client *client)
+{
+	struct mqtt_publish_param param;
+	int err_code;
+
+	for (u32_t i = 0; i < CONFIG_MQTT_QUEUE_REPLAY_BATCH; i++) {
+		if (verify_tx_state(client) != 0) {
+			break;
+		}
+
+		err_code = queue_peek(&param);
+		if (err_code == -ENOENT) {
+			break;
+		}
+
+		if (err_code == 0) {
+			err_code = client_publish(client, &param);
+
+			/* Transport errors close the connection, the message
+			 * is sent again once reconnected.
+			 */
+			if ((err_code == -EIO) || (err_code == -EBUSY)) {
+				break;
+			}
+		}
+
+		if (err_code != 0) {
+			MQTT_ERR("Dropping queued message, error %d",
+				 err_code);
+		}
+
+		queue_pop();
+	}
+}
+#endif
+
+int mqtt_publish(struct mqtt_client *client,
+		 const struct mqtt_publish_param *param)
+{
+	int err_code;
 
 	NULL_PARAM_CHECK(client);
 	NULL_PARAM_CHECK(param);
@@ -360,24 +824,71 @@ int mqtt_publish(struct mqtt_client *client,
 		 param->message.topic.topic.size,
 		 param->message.payload.len);
 
-	mqtt_mutex_lock();
+	mqtt_mutex_lock(client);
 
 	err_code = verify_tx_state(client);
+
+#if defined(CONFIG_MQTT_LIB_QUEUE)
+	/* Keep the order of messages queued while disconnected. */
+	if ((err_code == -ENOTCONN) ||
+	    ((err_code == 0) && !queue_is_empty())) {
+		err_code = queue_store(client, param);
+	} else
+#endif
 	if (err_code == 0) {
-		err_code = publish_encode(client, param, &packet, &packetlen);
+		err_code = client_publish(client, param);
+	}
 
-		if (err_code == 0) {
-			err_code = client_write(client, packet, packetlen);
+	mqtt_mutex_unlock(client);
+
+	MQTT_TRC("[CID %p]:[State 0x%02x]: << result 0x%08x",
+			 client, client->state, err_code);
+
+	return err_code;
+}
+
+#if defined(CONFIG_MQTT_LIB_INFLIGHT)
+int mqtt_publish_tracked(struct mqtt_client *client,
+			 const struct mqtt_publish_param *param,
+			 mqtt_publish_done_cb_t cb, void *user_data)
+{
+	int err_code;
+	struct mqtt_inflight *entry;
+
+	NULL_PARAM_CHECK(client);
+	NULL_PARAM_CHECK(param);
+
+	if (param->message.topic.qos == MQTT_QOS_0_AT_MOST_ONCE) {
+		return -EINVAL;
+	}
+
+	MQTT_TRC("[CID %p]:[State 0x%02x]: >> Topic size 0x%08x, "
+		 "Data size 0x%08x", client, client->state,
+		 param->message.topic.topic.size,
+		 param->message.payload.len);
+
+	mqtt_mutex_lock(client);
+
+	err_code = verify_tx_state(client);
+	if (err_code == 0) {
+		err_code = inflight_add(client, param, cb, user_data, &entry);
+	}
+
+	if (err_code == 0) {
+		err_code = client_publish(client, &entry->param);
+		if (err_code != 0) {
+			inflight_remove(client, entry);
 		}
 	}
 
-	mqtt_mutex_unlock();
+	mqtt_mutex_unlock(client);
 
 	MQTT_TRC("[CID %p]:[State 0x%02x]: << result 0x%08x",
 			 client, client->state, err_code);
 
 	return err_code;
 }
+#endif /* CONFIG_MQTT_LIB_INFLIGHT */
 
 int mqtt_publish_qos1_ack(struct mqtt_client *client,
 			  const struct mqtt_puback_param *param)
@@ -392,7 +903,7 @@ int mqtt_publish_qos1_ack(struct mqtt_client *client,
 	MQTT_TRC("[CID %p]:[State 0x%02x]: >> Message id 0x%04x",
 		 client, client->state, param->message_id);
 
-	mqtt_mutex_lock();
+	mqtt_mutex_lock(client);
 
 	err_code = verify_tx_state(client);
 	if (err_code == 0) {
@@ -404,7 +915,7 @@ int mqtt_publish_qos1_ack(struct mqtt_client *client,
 		}
 	}
 
-	mqtt_mutex_unlock();
+	mqtt_mutex_unlock(client);
 
 	MQTT_TRC("[CID %p]:[State 0x%02x]: << result 0x%08x",
 		 client, client->state, err_code);
@@ -425,7 +936,7 @@ int mqtt_publish_qos2_receive(struct mqtt_client *client,
 	MQTT_TRC("[CID %p]:[State 0x%02x]: >> Message id 0x%04x",
 		 client, client->state, param->message_id);
 
-	mqtt_mutex_lock();
+	mqtt_mutex_lock(client);
 
 	err_code = verify_tx_state(client);
 	if (err_code == 0) {
@@ -437,7 +948,7 @@ int mqtt_publish_qos2_receive(struct mqtt_client *client,
 		}
 	}
 
-	mqtt_mutex_unlock();
+	mqtt_mutex_unlock(client);
 
 	MQTT_TRC("[CID %p]:[State 0x%02x]: << result 0x%08x",
 		 client, client->state, err_code);
@@ -458,7 +969,7 @@ int mqtt_publish_qos2_release(struct mqtt_client *client,
 	MQTT_TRC("[CID %p]:[State 0x%02x]: >> Message id 0x%04x",
 		 client, client->state, param->message_id);
 
-	mqtt_mutex_lock();
+	mqtt_mutex_lock(client);
 
 	err_code = verify_tx_state(client);
 	if (err_code == 0) {
@@ -470,7 +981,7 @@ int mqtt_publish_qos2_release(struct mqtt_client *client,
 		}
 	}
 
-	mqtt_mutex_unlock();
+	mqtt_mutex_unlock(client);
 
 	MQTT_TRC("[CID %p]:[State 0x%02x]: << result 0x%08x",
 		 client, client->state, err_code);
@@ -491,7 +1002,7 @@ int mqtt_publish_qos2_complete(struct mqtt_client *client,
 	MQTT_TRC("[CID %p]:[State 0x%02x]: >> Message id 0x%04x",
 		 client, client->state, param->message_id);
 
-	mqtt_mutex_lock();
+	mqtt_mutex_lock(client);
 
 	err_code = verify_tx_state(client);
 	if (err_code == 0) {
@@ -503,7 +1014,7 @@ int mqtt_publish_qos2_complete(struct mqtt_client *client,
 		}
 	}
 
-	mqtt_mutex_unlock();
+	mqtt_mutex_unlock(client);
 
 	MQTT_TRC("[CID %p]:[State 0x%02x]: << result 0x%08x",
 		 client, client->state, err_code);
@@ -519,7 +1030,7 @@ int mqtt_disconnect(struct mqtt_client *client)
 
 	NULL_PARAM_CHECK(client);
 
-	mqtt_mutex_lock();
+	mqtt_mutex_lock(client);
 
 	err_code = verify_tx_state(client);
 	if (err_code == 0) {
@@ -535,7 +1046,7 @@ int mqtt_disconnect(struct mqtt_client *client)
 		}
 	}
 
-	mqtt_mutex_unlock();
+	mqtt_mutex_unlock(client);
 
 	return err_code;
 }
@@ -554,7 +1065,7 @@ int mqtt_subscribe(struct mqtt_client *client,
 		 "topic count 0x%04x", client, client->state,
 		 param->message_id, param->list_count);
 
-	mqtt_mutex_lock();
+	mqtt_mutex_lock(client);
 
 	err_code = verify_tx_state(client);
 	if (err_code == 0) {
@@ -568,7 +1079,7 @@ int mqtt_subscribe(struct mqtt_client *client,
 	MQTT_TRC("[CID %p]:[State 0x%02x]: << result 0x%08x",
 		 client, client->state, err_code);
 
-	mqtt_mutex_unlock();
+	mqtt_mutex_unlock(client);
 
 	return err_code;
 }
@@ -583,7 +1094,7 @@ int mqtt_unsubscribe(struct mqtt_client *client,
 	NULL_PARAM_CHECK(client);
 	NULL_PARAM_CHECK(param);
 
-	mqtt_mutex_lock();
+	mqtt_mutex_lock(client);
 
 	err_code = verify_tx_state(client);
 	if (err_code == 0) {
@@ -595,7 +1106,7 @@ int mqtt_unsubscribe(struct mqtt_client *client,
 		}
 	}
 
-	mqtt_mutex_unlock();
+	mqtt_mutex_unlock(client);
 
 	return err_code;
 }
@@ -608,7 +1119,7 @@ int mqtt_ping(struct mqtt_client *client)
 
 	NULL_PARAM_CHECK(client);
 
-	mqtt_mutex_lock();
+	mqtt_mutex_lock(client);
 
 	err_code = verify_tx_state(client);
 	if (err_code == 0) {
@@ -617,55 +1128,167 @@ int mqtt_ping(struct mqtt_client *client)
 		if (err_code == 0) {
 			err_code = client_write(client, packet, packetlen);
 		}
+
+		if ((err_code == 0) && !client->ping_pending) {
+			/* The response is awaited from the first request. */
+			client->ping_pending = 1;
+			client->ping_timestamp = mqtt_sys_tick_in_ms_get();
+		}
 	}
 
-	mqtt_mutex_unlock();
+	mqtt_mutex_unlock(client);
 
 	return err_code;
 }
 
-int mqtt_abort(struct mqtt_client *client)
+int mqtt_flush(struct mqtt_client *client)
+{
+	int err_code;
+
+	NULL_PARAM_CHECK(client);
+
+	mqtt_mutex_lock(client);
+
+	err_code = verify_tx_state(client);
+
+#if defined(CONFIG_MQTT_LIB_PUBLISH_COALESCING)
+	if (err_code == 0) {
+		err_code = client_coalesce_flush(client);
+	}
+#endif
+
+	mqtt_mutex_unlock(client);
+
+	return err_code;
+}
+
+#if defined(CONFIG_MQTT_LIB_PUBLISH_STREAMING)
+int mqtt_read_publish_payload(struct mqtt_client *client, void *buffer,
+			      u32_t length)
 {
-	mqtt_mutex_lock();
+	int err_code;
+
+	NULL_PARAM_CHECK(client);
+	NULL_PARAM_CHECK(buffer);
+
+	mqtt_mutex_lock(client);
+
+	if (length > client->rx_payload_remaining) {
+		length = client->rx_payload_remaining;
+	}
+
+	if (length == 0) {
+		err_code = 0;
+	} else {
+		err_code = mqtt_transport_read(client, buffer, &length, true);
+	}
+
+	if ((err_code == 0) && (length > 0)) {
+		client->rx_payload_remaining -= length;
+		err_code = length;
+	} else if ((err_code == 0) && (client->rx_payload_remaining > 0)) {
+		/* Connection closed, handled by the next mqtt_input call. */
+		err_code = -ENOTCONN;
+	}
+
+	mqtt_mutex_unlock(client);
 
+	return err_code;
+}
+#endif /* CONFIG_MQTT_LIB_PUBLISH_STREAMING */
+
+int mqtt_abort(struct mqtt_client *client)
+{
 	NULL_PARAM_CHECK(client);
 
+	mqtt_mutex_lock(client);
+
 	if (client->state != MQTT_STATE_IDLE) {
 		client_abort(client);
 	}
 
-	mqtt_mutex_unlock();
+	mqtt_mutex_unlock(client);
 
 	return 0;
 }
 
+/**@brief Copies the client table. The client mutex cannot be taken while
+ *        holding the table mutex, so procedures on all clients work on a
+ *        copy of the table.
+ *
+ * @param[out] clients Copy of the client table.
+ */
+static void clients_get(struct mqtt_client *clients[MQTT_MAX_CLIENTS])
+{
+	k_mutex_lock(&mqtt_table_mutex, K_FOREVER);
+	memcpy(clients, mqtt_client, sizeof(mqtt_client));
+	k_mutex_unlock(&mqtt_table_mutex);
+}
+
+/**@brief Checks whether the Ping Response awaited by a client is overdue. */
+static bool ping_response_overdue(struct mqtt_client *client)
+{
+	return client->ping_pending &&
+	       (mqtt_elapsed_time_in_ms_get(client->ping_timestamp) >=
+		CONFIG_MQTT_PING_RESPONSE_TIMEOUT);
+}
+
 int mqtt_live(void)
 {
+	struct mqtt_client *clients[MQTT_MAX_CLIENTS];
 	u32_t elapsed_time;
 	u32_t index;
 
-	mqtt_mutex_lock();
+	clients_get(clients);
 
 	for (index = 0; index < MQTT_MAX_CLIENTS; index++) {
-		struct mqtt_client *client = mqtt_client[index];
+		struct mqtt_client *client = clients[index];
 
-		if (client != NULL) {
-			if (MQTT_VERIFY_STATE(client,
-					      MQTT_STATE_DISCONNECTING)) {
-				client_disconnect(client, 0);
-			} else {
-				elapsed_time = mqtt_elapsed_time_in_ms_get(
-							client->last_activity);
+		if (client == NULL) {
+			continue;
+		}
 
-				if ((MQTT_KEEPALIVE > 0) &&
-				    (elapsed_time >= (MQTT_KEEPALIVE * 1000))) {
-					(void)mqtt_ping(client);
-				}
+		mqtt_mutex_lock(client);
+
+		if (MQTT_VERIFY_STATE(client, MQTT_STATE_DISCONNECTING)) {
+			client_disconnect(client, 0);
+		} else if (ping_response_overdue(client)) {
+			MQTT_ERR("[CID %p]: Ping Response timed out", client);
+			client_disconnect(client, -ETIMEDOUT);
+		} else if (MQTT_VERIFY_STATE(client,
+					     MQTT_STATE_TCP_CONNECTED)) {
+			elapsed_time = mqtt_elapsed_time_in_ms_get(
+						client->last_activity);
+
+			if ((client->keepalive_interval > 0) &&
+			    !client->ping_pending &&
+			    (elapsed_time >=
+			     (client->keepalive_interval * 1000U))) {
+				(void)mqtt_ping(client);
+			}
+
+#if defined(CONFIG_MQTT_LIB_INFLIGHT)
+			if (MQTT_VERIFY_STATE(client, MQTT_STATE_CONNECTED)) {
+				inflight_retransmit(client, false);
 			}
+#endif
+
+#if defined(CONFIG_MQTT_LIB_QUEUE)
+			client_queue_replay(client);
+#endif
+
+#if defined(CONFIG_MQTT_LIB_PUBLISH_COALESCING)
+			if ((client->coalesce_len > 0) &&
+			    (mqtt_elapsed_time_in_ms_get(
+					client->coalesce_timestamp) >=
+			     CONFIG_MQTT_COALESCE_FLUSH_TIMEOUT)) {
+				(void)client_coalesce_flush(client);
+			}
+#endif
 		}
-	}
 
-	mqtt_mutex_unlock();
+		mqtt_mutex_unlock(client);
+	}
 
 	return 0;
 }
@@ -676,19 +1299,222 @@ int mqtt_input(struct mqtt_client *client)
 
 	NULL_PARAM_CHECK(client);
 
-	mqtt_mutex_lock();
+	mqtt_mutex_lock(client);
 
 	MQTT_TRC("state:0x%08x", client->state);
 
 	if (MQTT_VERIFY_STATE(client, MQTT_STATE_DISCONNECTING)) {
 		err_code = client_disconnect(client, 0);
+	} else if (MQTT_VERIFY_STATE(client, MQTT_STATE_TCP_CONNECTING)) {
+		err_code = client_connect_continue(client);
 	} else if (MQTT_VERIFY_STATE(client, MQTT_STATE_TCP_CONNECTED)) {
 		err_code = client_read(client);
 	} else {
 		err_code = -EACCES;
 	}
 
-	mqtt_mutex_unlock();
+	mqtt_mutex_unlock(client);
 
 	return err_code;
 }
+
+/**@brief Returns the shortest of two timeouts, where K_FOREVER is the
+ *        longest.
+ */
+static s32_t timeout_min(s32_t timeout1, s32_t timeout2)
+{
+	if (timeout1 == K_FOREVER) {
+		return timeout2;
+	}
+
+	if (timeout2 == K_FOREVER) {
+		return timeout1;
+	}
+
+	return min(timeout1, timeout2);
+}
+
+/**@brief Gets the time until @ref mqtt_live has work to do for a client.
+ *
+ * @param[in] client Identifies the client for which the procedure is requested.
+ *
+ * @return Time in milliseconds, or K_FOREVER if nothing is due.
+ */
+static s32_t client_timeout_get(struct mqtt_client *client)
+{
+	s32_t timeout = K_FOREVER;
+
+	if (MQTT_VERIFY_STATE(client, MQTT_STATE_DISCONNECTING)) {
+		return 0;
+	}
+
+	if (MQTT_VERIFY_STATE(client, MQTT_STATE_TCP_CONNECTING)) {
+		/* Woken up by the transport. */
+		return K_FOREVER;
+	}
+
+	if (client->ping_pending) {
+		u32_t elapsed_time = mqtt_elapsed_time_in_ms_get(
+						client->ping_timestamp);
+
+		timeout = (elapsed_time >= CONFIG_MQTT_PING_RESPONSE_TIMEOUT) ?
+			  0 : CONFIG_MQTT_PING_RESPONSE_TIMEOUT - elapsed_time;
+	} else if (client->keepalive_interval > 0) {
+		u32_t keepalive_ms = client->keepalive_interval * 1000U;
+		u32_t elapsed_time = mqtt_elapsed_time_in_ms_get(
+						client->last_activity);
+
+		timeout = (elapsed_time >= keepalive_ms) ? 0 :
+			  keepalive_ms - elapsed_time;
+	}
+
+#if defined(CONFIG_MQTT_LIB_INFLIGHT)
+	if (MQTT_VERIFY_STATE(client, MQTT_STATE_CONNECTED)) {
+		timeout = timeout_min(timeout, inflight_timeout_get(client));
+	}
+#endif
+
+#if defined(CONFIG_MQTT_LIB_QUEUE)
+	/* Replay is only possible while the client can send. */
+	if ((verify_tx_state(client) == 0) && !queue_is_empty()) {
+		timeout = 0;
+	}
+#endif
+
+#if defined(CONFIG_MQTT_LIB_PUBLISH_COALESCING)
+	if (client->coalesce_len > 0) {
+		u32_t elapsed_time = mqtt_elapsed_time_in_ms_get(
+						client->coalesce_timestamp);
+		s32_t remaining =
+			(elapsed_time >= CONFIG_MQTT_COALESCE_FLUSH_TIMEOUT) ?
+			0 : CONFIG_MQTT_COALESCE_FLUSH_TIMEOUT - elapsed_time;
+
+		timeout = timeout_min(timeout, remaining);
+	}
+#endif
+
+	return timeout;
+}
+
+s32_t mqtt_live_timeout(struct mqtt_client *client)
+{
+	s32_t timeout;
+
+	NULL_PARAM_CHECK(client);
+
+	mqtt_mutex_lock(client);
+
+	if (MQTT_VERIFY_STATE(client, MQTT_STATE_TCP_CONNECTING |
+				      MQTT_STATE_TCP_CONNECTED |
+				      MQTT_STATE_DISCONNECTING)) {
+		timeout = client_timeout_get(client);
+	} else {
+		timeout = K_FOREVER;
+	}
+
+	mqtt_mutex_unlock(client);
+
+	return timeout;
+}
+
+/**@brief Waits for incoming data on the transport of any client, for the
+ *        transport of a connecting client to be ready, or until
+ *        @ref mqtt_live has work to do.
+ *
+ * @param[out] clients Clients that are polled.
+ * @param[out] fds Poll descriptors of the polled clients.
+ * @param[out] count Number of polled clients.
+ * @param[in] timeout Maximum time to wait, in milliseconds, or K_FOREVER.
+ *
+ * @retval Number of clients that are ready, 0 on timeout, or an error code
+ *         indicating reason for failure.
+ */
+static int clients_poll(struct mqtt_client *clients[MQTT_MAX_CLIENTS],
+			struct pollfd fds[MQTT_MAX_CLIENTS], u32_t *count,
+			s32_t timeout)
+{
+	struct mqtt_client *table[MQTT_MAX_CLIENTS];
+	int ret;
+
+	*count = 0;
+
+	clients_get(table);
+
+	for (u32_t index = 0; index < MQTT_MAX_CLIENTS; index++) {
+		struct mqtt_client *client = table[index];
+
+		if (client == NULL) {
+			continue;
+		}
+
+		mqtt_mutex_lock(client);
+
+		if (MQTT_VERIFY_STATE(client, MQTT_STATE_TCP_CONNECTING |
+					      MQTT_STATE_TCP_CONNECTED)) {
+			clients[*count] = client;
+			fds[*count].fd = mqtt_transport_socket(client);
+			fds[*count].revents = 0;
+
+			/* The socket is writable once it is connected. */
+			if (MQTT_VERIFY_STATE(client,
+					      MQTT_STATE_TCP_CONNECTING)) {
+				fds[*count].events = POLLOUT;
+			} else {
+				fds[*count].events = POLLIN;
+			}
+
+			(*count)++;
+		}
+
+		timeout = timeout_min(timeout, client_timeout_get(client));
+
+		mqtt_mutex_unlock(client);
+	}
+
+	if (*count == 0) {
+		return -ENOTCONN;
+	}
+
+	MQTT_TRC("Polling %d clients, timeout %d", *count, timeout);
+
+	ret = poll(fds, *count, timeout);
+	if (ret < 0) {
+		return -errno;
+	}
+
+	return ret;
+}
+
+int mqtt_wait(s32_t timeout)
+{
+	struct mqtt_client *clients[MQTT_MAX_CLIENTS];
+	struct pollfd fds[MQTT_MAX_CLIENTS];
+	u32_t count;
+
+	return clients_poll(clients, fds, &count, timeout);
+}
+
+int mqtt_run(s32_t timeout)
+{
+	struct mqtt_client *clients[MQTT_MAX_CLIENTS];
+	struct pollfd fds[MQTT_MAX_CLIENTS];
+	u32_t count;
+	int err_code;
+
+	err_code = clients_poll(clients, fds, &count, timeout);
+	if (err_code < 0) {
+		return err_code;
+	}
+
+	for (u32_t index = 0; index < count; index++) {
+		/* Closed or invalid sockets are detected on input as well,
+		 * errors are notified through the event callback.
+		 */
+		if (fds[index].revents &
+		    (POLLIN | POLLOUT | POLLERR | POLLHUP | POLLNVAL)) {
+			(void)mqtt_input(clients[index]);
+		}
+	}
+
+	return mqtt_live();
+}
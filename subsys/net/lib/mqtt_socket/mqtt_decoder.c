@@ -102,6 +102,54 @@ static int unpack_uint16(u16_t *val, u32_t buffer_len, u8_t *buffer,
 	return err_code;
 }
 
+#if defined(CONFIG_MQTT_LIB_PROTOCOL_V5)
+/**
+ * @brief Unpacks unsigned 32 bit value from the buffer from the offset
+ *        requested.
+ *
+ * @param[out] val Memory where the value is to be unpacked.
+ * @param[in] buffer_len Total size of the buffer. This shall not be zero.
+ * @param[in] buffer Buffer from which the value is to be unpacked.
+ * @param[inout] offset Offset on the buffer from where the value is to be
+ *                      unpacked. If the procedure is successful, the offset
+ *                      is incremented to point to the next read/unpack location
+ *                      on the buffer.
+ *
+ * @retval 0 if the procedure is successful.
+ * @retval -EINVAL if the offset is greater than or equal to the buffer length.
+ */
+static int unpack_uint32(u32_t *val, u32_t buffer_len, u8_t *buffer,
+			 u32_t *offset)
+{
+	int err_code = -EINVAL;
+
+	if (buffer_len > *offset) {
+		const u32_t available_len = buffer_len - *offset;
+
+		MQTT_TRC(">> BL:%08x, B:%p, O:%08x A:%08x", buffer_len, buffer,
+			 *offset, available_len);
+
+		if (available_len >= sizeof(u32_t)) {
+			/* Create unit32 value. */
+			*val = ((u32_t)buffer[*offset] << 24) |
+			       ((u32_t)buffer[*offset + 1] << 16) |
+			       ((u32_t)buffer[*offset + 2] << 8) |
+			       (u32_t)buffer[*offset + 3];
+
+			/* Increment offset. */
+			*offset += sizeof(u32_t);
+
+			/* Indicate success. */
+			err_code = 0;
+		}
+	}
+
+	MQTT_TRC("<< result:0x%08x val:0x%08x", err_code, *val);
+
+	return err_code;
+}
+#endif /* CONFIG_MQTT_LIB_PROTOCOL_V5 */
+
 /**
  * @brief Unpacks utf8 string from the buffer from the offset requested.
  *
@@ -233,6 +281,163 @@ int packet_length_decode(u8_t *buffer, u32_t buffer_len,
 	return 0;
 }
 
+#if defined(CONFIG_MQTT_LIB_PROTOCOL_V5)
+/**
+ * @brief Unpacks MQTT 5.0 properties from the buffer from the offset
+ *        requested.
+ *
+ * Properties the client does not act on are skipped.
+ *
+ * @param[out] connack CONNACK parameters to be filled from the properties,
+ *                     NULL if the properties do not belong to a CONNACK.
+ * @param[in] buffer_len Total size of the buffer.
+ * @param[in] buffer Buffer from which the properties are to be unpacked.
+ * @param[inout] offset Offset of the property length on the buffer. If the
+ *                      procedure is successful, the offset is incremented to
+ *                      point to the first byte after the properties.
+ *
+ * @retval 0 if the procedure is successful.
+ * @retval -EINVAL if the properties are malformed.
+ */
+static int unpack_properties(struct mqtt_connack_param *connack,
+			     u32_t buffer_len, u8_t *buffer, u32_t *offset)
+{
+	u32_t properties_len;
+	u32_t end;
+	int err_code;
+
+	err_code = packet_length_decode(buffer, buffer_len, &properties_len,
+					offset);
+	if (err_code != 0) {
+		return err_code;
+	}
+
+	if (properties_len > buffer_len - *offset) {
+		return -EINVAL;
+	}
+
+	end = *offset + properties_len;
+
+	while ((err_code == 0) && (*offset < end)) {
+		struct mqtt_utf8 str;
+		u8_t id, u8_val;
+		u16_t u16_val;
+		u32_t u32_val;
+
+		err_code = unpack_uint8(&id, end, buffer, offset);
+		if (err_code != 0) {
+			break;
+		}
+
+		MQTT_TRC("Property: 0x%02x", id);
+
+		switch (id) {
+		case MQTT_PROP_PAYLOAD_FORMAT_INDICATOR:
+		case MQTT_PROP_REQUEST_PROBLEM_INFORMATION:
+		case MQTT_PROP_REQUEST_RESPONSE_INFORMATION:
+		case MQTT_PROP_MAXIMUM_QOS:
+		case MQTT_PROP_RETAIN_AVAILABLE:
+		case MQTT_PROP_WILDCARD_SUBSCRIPTION_AVAILABLE:
+		case MQTT_PROP_SUBSCRIPTION_IDENTIFIER_AVAILABLE:
+		case MQTT_PROP_SHARED_SUBSCRIPTION_AVAILABLE:
+			err_code = unpack_uint8(&u8_val, end, buffer, offset);
+			break;
+
+		case MQTT_PROP_SERVER_KEEP_ALIVE:
+			err_code = unpack_uint16(&u16_val, end, buffer, offset);
+			if ((err_code == 0) && (connack != NULL)) {
+				connack->server_keep_alive = u16_val;
+			}
+			break;
+
+		case MQTT_PROP_RECEIVE_MAXIMUM:
+		case MQTT_PROP_TOPIC_ALIAS:
+			err_code = unpack_uint16(&u16_val, end, buffer, offset);
+			break;
+
+		case MQTT_PROP_TOPIC_ALIAS_MAXIMUM:
+			err_code = unpack_uint16(&u16_val, end, buffer, offset);
+			if ((err_code == 0) && (connack != NULL)) {
+				connack->topic_alias_max = u16_val;
+			}
+			break;
+
+		case MQTT_PROP_MESSAGE_EXPIRY_INTERVAL:
+		case MQTT_PROP_WILL_DELAY_INTERVAL:
+		case MQTT_PROP_MAXIMUM_PACKET_SIZE:
+			err_code = unpack_uint32(&u32_val, end, buffer, offset);
+			break;
+
+		case MQTT_PROP_SESSION_EXPIRY_INTERVAL:
+			err_code = unpack_uint32(&u32_val, end, buffer, offset);
+			if ((err_code == 0) && (connack != NULL)) {
+				connack->session_expiry_interval = u32_val;
+			}
+			break;
+
+		case MQTT_PROP_SUBSCRIPTION_IDENTIFIER:
+			err_code = packet_length_decode(buffer, end, &u32_val,
+							offset);
+			break;
+
+		case MQTT_PROP_USER_PROPERTY:
+			/* Name of the name-value pair. */
+			err_code = unpack_utf8_str(&str, end, buffer, offset);
+			if (err_code != 0) {
+				break;
+			}
+
+			/* The value follows the name. */
+			/* fall through */
+		case MQTT_PROP_CONTENT_TYPE:
+		case MQTT_PROP_RESPONSE_TOPIC:
+		case MQTT_PROP_CORRELATION_DATA:
+		case MQTT_PROP_ASSIGNED_CLIENT_IDENTIFIER:
+		case MQTT_PROP_AUTHENTICATION_METHOD:
+		case MQTT_PROP_AUTHENTICATION_DATA:
+		case MQTT_PROP_RESPONSE_INFORMATION:
+		case MQTT_PROP_SERVER_REFERENCE:
+		case MQTT_PROP_REASON_STRING:
+			/* Binary data is length prefixed like a string. */
+			err_code = unpack_utf8_str(&str, end, buffer, offset);
+			break;
+
+		default:
+			err_code = -EINVAL;
+			break;
+		}
+	}
+
+	MQTT_TRC("<< result:0x%08x properties len:0x%08x", err_code,
+		 properties_len);
+
+	return err_code;
+}
+
+/**@brief Unpacks the Reason Code of an MQTT 5.0 publish acknowledgment
+ *        (PUBACK, PUBREC, PUBREL or PUBCOMP). The Reason Code is omitted
+ *        by the broker when it is Success and there are no properties.
+ *        The properties following the Reason Code are ignored.
+ *
+ * @param[out] reason_code Memory where the Reason Code is to be unpacked.
+ * @param[in] buffer_len Total size of the buffer.
+ * @param[in] buffer Buffer from which the Reason Code is to be unpacked.
+ * @param[inout] offset Offset on the buffer after the message id.
+ *
+ * @return 0 if the procedure is successful, an error code otherwise.
+ */
+static int unpack_ack_reason_code(u8_t *reason_code, u32_t buffer_len,
+				  u8_t *buffer, u32_t *offset)
+{
+	if (buffer_len == *offset) {
+		*reason_code = 0;
+		return 0;
+	}
+
+	return unpack_uint8(reason_code, buffer_len, buffer, offset);
+}
+#endif /* CONFIG_MQTT_LIB_PROTOCOL_V5 */
+
 int connect_ack_decode(const struct mqtt_client *client, u8_t *data,
 		       u32_t datalen, u32_t offset,
 		       struct mqtt_connack_param *param)
@@ -242,7 +447,7 @@ int connect_ack_decode(const struct mqtt_client *client, u8_t *data,
 
 	err_code = unpack_uint8(&flags, datalen, data, &offset);
 	if (err_code == 0) {
-		if (client->protocol_version == MQTT_VERSION_3_1_1) {
+		if (client->protocol_version != MQTT_VERSION_3_1_0) {
 			param->session_present_flag =
 				flags & MQTT_CONNACK_FLAG_SESSION_PRESENT;
 
@@ -257,10 +462,23 @@ int connect_ack_decode(const struct mqtt_client *client, u8_t *data,
 		param->return_code = (enum mqtt_conn_return_code)ret_code;
 	}
 
+#if defined(CONFIG_MQTT_LIB_PROTOCOL_V5)
+	/* Values that apply when the broker does not send the property. */
+	param->session_expiry_interval = client->session_expiry_interval;
+	param->topic_alias_max = 0;
+	param->server_keep_alive = client->keepalive;
+
+	if ((err_code == 0) &&
+	    (client->protocol_version == MQTT_VERSION_5_0)) {
+		err_code = unpack_properties(param, datalen, data, &offset);
+	}
+#endif
+
 	return err_code;
 }
 
-int publish_decode(u8_t *data, u32_t datalen, u32_t offset,
+int publish_decode(const struct mqtt_client *client, u8_t *data,
+		   u32_t datalen, u32_t offset,
 		   struct mqtt_publish_param *param)
 {
 	int err_code;
@@ -282,6 +500,13 @@ int publish_decode(u8_t *data, u32_t datalen, u32_t offset,
 		}
 	}
 
+#if defined(CONFIG_MQTT_LIB_PROTOCOL_V5)
+	if ((err_code == 0) &&
+	    (client->protocol_version == MQTT_VERSION_5_0)) {
+		err_code = unpack_properties(NULL, datalen, data, &offset);
+	}
+#endif
+
 	if (err_code == 0) {
 		err_code = unpack_data(&param->message.payload,
 					  datalen, data, &offset);
@@ -299,34 +524,86 @@ int publish_decode(u8_t *data, u32_t datalen, u32_t offset,
 int publish_ack_decode(u8_t *data, u32_t datalen, u32_t offset,
 		       struct mqtt_puback_param *param)
 {
-	return unpack_uint16(&param->message_id, datalen, data, &offset);
+	int err_code;
+
+	err_code = unpack_uint16(&param->message_id, datalen, data, &offset);
+
+#if defined(CONFIG_MQTT_LIB_PROTOCOL_V5)
+	if (err_code == 0) {
+		err_code = unpack_ack_reason_code(&param->reason_code, datalen,
+						  data, &offset);
+	}
+#endif
+
+	return err_code;
 }
 
 int publish_receive_decode(u8_t *data, u32_t datalen, u32_t offset,
 			   struct mqtt_pubrec_param *param)
 {
-	return unpack_uint16(&param->message_id, datalen, data, &offset);
+	int err_code;
+
+	err_code = unpack_uint16(&param->message_id, datalen, data, &offset);
+
+#if defined(CONFIG_MQTT_LIB_PROTOCOL_V5)
+	if (err_code == 0) {
+		err_code = unpack_ack_reason_code(&param->reason_code, datalen,
+						  data, &offset);
+	}
+#endif
+
+	return err_code;
 }
 
 int publish_release_decode(u8_t *data, u32_t datalen, u32_t offset,
 			   struct mqtt_pubrel_param *param)
 {
-	return unpack_uint16(&param->message_id, datalen, data, &offset);
+	int err_code;
+
+	err_code = unpack_uint16(&param->message_id, datalen, data, &offset);
+
+#if defined(CONFIG_MQTT_LIB_PROTOCOL_V5)
+	if (err_code == 0) {
+		err_code = unpack_ack_reason_code(&param->reason_code, datalen,
+						  data, &offset);
+	}
+#endif
+
+	return err_code;
 }
 
 int publish_complete_decode(u8_t *data, u32_t datalen, u32_t offset,
 			    struct mqtt_pubcomp_param *param)
 {
-	return unpack_uint16(&param->message_id, datalen, data, &offset);
+	int err_code;
+
+	err_code = unpack_uint16(&param->message_id, datalen, data, &offset);
+
+#if defined(CONFIG_MQTT_LIB_PROTOCOL_V5)
+	if (err_code == 0) {
+		err_code = unpack_ack_reason_code(&param->reason_code, datalen,
+						  data, &offset);
+	}
+#endif
+
+	return err_code;
 }
 
-int subscribe_ack_decode(u8_t *data, u32_t datalen, u32_t offset,
+int subscribe_ack_decode(const struct mqtt_client *client, u8_t *data,
+			 u32_t datalen, u32_t offset,
 			 struct mqtt_suback_param *param)
 {
 	int err_code;
 
 	err_code = unpack_uint16(&param->message_id, datalen, data, &offset);
 
+#if defined(CONFIG_MQTT_LIB_PROTOCOL_V5)
+	if ((err_code == 0) &&
+	    (client->protocol_version == MQTT_VERSION_5_0)) {
+		err_code = unpack_properties(NULL, datalen, data, &offset);
+	}
+#endif
+
 	if (err_code == 0) {
 		err_code = unpack_data(&param->return_codes, datalen,
 					  data, &offset);
@@ -335,8 +612,20 @@ int subscribe_ack_decode(u8_t *data, u32_t datalen, u32_t offset,
 	return err_code;
 }
 
-int unsubscribe_ack_decode(u8_t *data, u32_t datalen, u32_t offset,
+int unsubscribe_ack_decode(const struct mqtt_client *client, u8_t *data,
+			   u32_t datalen, u32_t offset,
 			   struct mqtt_unsuback_param *param)
 {
-	return unpack_uint16(&param->message_id, datalen, data, &offset);
+	int err_code;
+
+	err_code = unpack_uint16(&param->message_id, datalen, data, &offset);
+
+#if defined(CONFIG_MQTT_LIB_PROTOCOL_V5)
+	if ((err_code == 0) &&
+	    (client->protocol_version == MQTT_VERSION_5_0)) {
+		err_code = unpack_properties(NULL, datalen, data, &offset);
+	}
+#endif
+
+	return err_code;
 }
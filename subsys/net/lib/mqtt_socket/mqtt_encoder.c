@@ -127,88 +127,93 @@ static int pack_uint16(u16_t val, u32_t buffer_len, u8_t *buffer,
 	return err_code;
 }
 
+#if defined(CONFIG_MQTT_LIB_PROTOCOL_V5)
 /**
- * @brief Packs utf8 string to the buffer at the offset requested.
+ * @brief Packs unsigned 32 bit value to the buffer at the offset requested.
  *
- * @param[in] str UTF-8 string and its length to be packed.
- * @param[in] buffer_len Total size of the buffer on which string is to be
+ * @param[in] val Value to be packed.
+ * @param[in] buffer_len Total size of the buffer on which value is to be
  *                       packed. This shall not be zero.
- * @param[out] buffer Buffer where the string is to be packed.
- * @param[inout] offset Offset on the buffer where the string is to be packed.
+ * @param[out] buffer Buffer where the value is to be packed.
+ * @param[inout] offset Offset on the buffer where the value is to be packed.
  *                      If the procedure is successful, the offset is
  *                      incremented to point to the next write/pack location on
  *                      the buffer.
  *
  * @retval 0 if the procedure is successful.
  * @retval -EINVAL if the offset is greater than or equal to the buffer length
- *                 minus the size of unsigned 16 bit integer.
- * @retval -ENOMEM if there is no room on the buffer to pack the string.
+ *                 minus the size of unsigned 32 bit integer.
  */
-static int pack_utf8_str(const struct mqtt_utf8 *str, u32_t buffer_len,
-			 u8_t *buffer, u32_t *offset)
+static int pack_uint32(u32_t val, u32_t buffer_len, u8_t *buffer,
+		       u32_t *offset)
 {
 	int err_code = -EINVAL;
 
 	if (buffer_len > *offset) {
 		const u32_t available_len = buffer_len - *offset;
 
-		MQTT_TRC(">> USL:%08x BL:%08x, B:%p, O:%08x A:%08x",
-			 GET_UT8STR_BUFFER_SIZE(str), buffer_len,
-			 buffer, *offset, available_len);
+		MQTT_TRC(">> V:%08x BL:%08x, B:%p, O:%08x A:%08x", val,
+			 buffer_len, buffer, *offset, available_len);
 
-		if (available_len >= GET_UT8STR_BUFFER_SIZE(str)) {
-			/* Length followed by string. */
-			err_code = pack_uint16(str->size, buffer_len,
-					       buffer, offset);
+		if (available_len >= sizeof(u32_t)) {
+			/* Pack value. */
+			buffer[*offset] = (val >> 24) & 0xFF;
+			buffer[*offset + 1] = (val >> 16) & 0xFF;
+			buffer[*offset + 2] = (val >> 8) & 0xFF;
+			buffer[*offset + 3] = val & 0xFF;
 
-			if (err_code == 0) {
-				memcpy(&buffer[*offset], str->utf8,
-				       str->size);
+			/* Increment offset. */
+			*offset += sizeof(u32_t);
 
-				*offset += str->size;
-			}
-		} else {
-			err_code = -ENOMEM;
+			/* Indicate success. */
+			err_code = 0;
 		}
 	}
 
 	return err_code;
 }
+#endif /* CONFIG_MQTT_LIB_PROTOCOL_V5 */
 
 /**
- * @brief Packs binary string to the buffer at the offset requested.
+ * @brief Packs utf8 string to the buffer at the offset requested.
  *
- * @param[in] str Binary string and its length to be packed.
+ * @param[in] str UTF-8 string and its length to be packed.
  * @param[in] buffer_len Total size of the buffer on which string is to be
- *                       packed.
- * @param[in] buffer Buffer where the string is to be packed.
+ *                       packed. This shall not be zero.
+ * @param[out] buffer Buffer where the string is to be packed.
  * @param[inout] offset Offset on the buffer where the string is to be packed.
  *                      If the procedure is successful, the offset is
  *                      incremented to point to the next write/pack location on
  *                      the buffer.
  *
  * @retval 0 if the procedure is successful.
- * @retval -EINVAL if the offset is greater than or equal to the buffer length.
+ * @retval -EINVAL if the offset is greater than or equal to the buffer length
+ *                 minus the size of unsigned 16 bit integer.
  * @retval -ENOMEM if there is no room on the buffer to pack the string.
  */
-static int pack_data(const struct mqtt_binstr *str, u32_t buffer_len,
-		     u8_t *buffer, u32_t *offset)
+static int pack_utf8_str(const struct mqtt_utf8 *str, u32_t buffer_len,
+			 u8_t *buffer, u32_t *offset)
 {
 	int err_code = -EINVAL;
 
 	if (buffer_len > *offset) {
 		const u32_t available_len = buffer_len - *offset;
 
-		MQTT_TRC(">> BSL:%08x BL:%08x, B:%p, O:%08x A:%08x",
-			 GET_BINSTR_BUFFER_SIZE(str), buffer_len,
+		MQTT_TRC(">> USL:%08x BL:%08x, B:%p, O:%08x A:%08x",
+			 GET_UT8STR_BUFFER_SIZE(str), buffer_len,
 			 buffer, *offset, available_len);
 
-		if (available_len >= GET_BINSTR_BUFFER_SIZE(str)) {
-			memcpy(&buffer[*offset], str->data,
-			       str->len);
+		if (available_len >= GET_UT8STR_BUFFER_SIZE(str)) {
+			/* Length followed by string. */
+			err_code = pack_uint16(str->size, buffer_len,
+					       buffer, offset);
 
-			*offset += str->len;
-			err_code = 0;
+			if (err_code == 0) {
+				memcpy(&buffer[*offset], str->utf8,
+				       str->size);
+
+				*offset += str->size;
+			}
 		} else {
 			err_code = -ENOMEM;
 		}
@@ -307,7 +312,7 @@ static u32_t mqtt_encode_fixed_header(u8_t message_type, u32_t length,
 
 		/* Reset offset. */
 		offset = 0;
-		(void)pack_uint8(message_type, MQTT_MAX_PACKET_LENGTH,
+		(void)pack_uint8(message_type, MQTT_FIXED_HEADER_EXTENDED_SIZE,
 				 mqtt_header, &offset);
 		packet_length_encode(length, mqtt_header, &offset);
 
@@ -339,6 +344,114 @@ static int zero_len_str_encode(u32_t buffer_len, u8_t *buffer,
 	return pack_uint16(0x0000, buffer_len, buffer, offset);
 }
 
+#if defined(CONFIG_MQTT_LIB_PROTOCOL_V5)
+/**
+ * @brief Encodes an empty MQTT 5.0 property list if the client uses
+ *        MQTT 5.0. Nothing is encoded for older protocol versions.
+ *
+ * @param[in] client Identifies the client for which the packet is encoded.
+ * @param[in] buffer_len Total size of the buffer on which the property list
+ *                       will be encoded. This shall not be zero.
+ * @param[out] buffer Buffer where the property list is to be encoded.
+ * @param[inout] offset Offset on the buffer where the property list is to be
+ *                      encoded. If the procedure is successful, the offset is
+ *                      incremented to point to the next write/pack location
+ *                      on the buffer.
+ *
+ * @retval 0 if the procedure is successful.
+ * @retval -EINVAL if the offset is greater than or equal to the buffer length.
+ */
+static int zero_len_properties_encode(const struct mqtt_client *client,
+				      u32_t buffer_len, u8_t *buffer,
+				      u32_t *offset)
+{
+	if (client->protocol_version != MQTT_VERSION_5_0) {
+		return 0;
+	}
+
+	return pack_uint8(0x00, buffer_len, buffer, offset);
+}
+
+/**
+ * @brief Encodes the MQTT 5.0 properties of the connect request.
+ *
+ * @param[in] client Identifies the client for which the packet is encoded.
+ * @param[in] buffer_len Total size of the buffer on which the properties
+ *                       will be encoded. This shall not be zero.
+ * @param[out] buffer Buffer where the properties are to be encoded.
+ * @param[inout] offset Offset on the buffer where the properties are to be
+ *                      encoded. If the procedure is successful, the offset is
+ *                      incremented to point to the next write/pack location
+ *                      on the buffer.
+ *
+ * @retval 0 if the procedure is successful.
+ * @retval -EINVAL if there is no room on the buffer for the properties.
+ */
+static int connect_properties_encode(const struct mqtt_client *client,
+				     u32_t buffer_len, u8_t *buffer,
+				     u32_t *offset)
+{
+	int err_code;
+
+	if (client->session_expiry_interval == 0) {
+		/* Session ends when the connection is closed. */
+		return pack_uint8(0x00, buffer_len, buffer, offset);
+	}
+
+	err_code = pack_uint8(sizeof(u8_t) + sizeof(u32_t), buffer_len,
+			      buffer, offset);
+	if (err_code == 0) {
+		err_code = pack_uint8(MQTT_PROP_SESSION_EXPIRY_INTERVAL,
+				      buffer_len, buffer, offset);
+	}
+
+	if (err_code == 0) {
+		err_code = pack_uint32(client->session_expiry_interval,
+				       buffer_len, buffer, offset);
+	}
+
+	return err_code;
+}
+
+/**
+ * @brief Encodes the MQTT 5.0 properties of a publish message.
+ *
+ * @param[in] topic_alias Topic alias to be encoded, 0 for none.
+ * @param[in] buffer_len Total size of the buffer on which the properties
+ *                       will be encoded. This shall not be zero.
+ * @param[out] buffer Buffer where the properties are to be encoded.
+ * @param[inout] offset Offset on the buffer where the properties are to be
+ *                      encoded. If the procedure is successful, the offset is
+ *                      incremented to point to the next write/pack location
+ *                      on the buffer.
+ *
+ * @retval 0 if the procedure is successful.
+ * @retval -EINVAL if there is no room on the buffer for the properties.
+ */
+static int publish_properties_encode(u16_t topic_alias, u32_t buffer_len,
+				     u8_t *buffer, u32_t *offset)
+{
+	int err_code;
+
+	if (topic_alias == 0) {
+		return pack_uint8(0x00, buffer_len, buffer, offset);
+	}
+
+	err_code = pack_uint8(sizeof(u8_t) + sizeof(u16_t), buffer_len,
+			      buffer, offset);
+	if (err_code == 0) {
+		err_code = pack_uint8(MQTT_PROP_TOPIC_ALIAS, buffer_len,
+				      buffer, offset);
+	}
+
+	if (err_code == 0) {
+		err_code = pack_uint16(topic_alias, buffer_len, buffer, offset);
+	}
+
+	return err_code;
+}
+#endif /* CONFIG_MQTT_LIB_PROTOCOL_V5 */
+
 /**
  * @brief Encodes and sends messages that contain only message id in
  *        the variable header.
@@ -358,6 +471,7 @@ static int mqtt_message_id_only_enc(const struct mqtt_client *client,
 	u32_t offset = 0;
 	u32_t mqtt_packetlen = 0;
 	u8_t *payload;
+	const u32_t buffer_len = MQTT_MAX_VARIABLE_HEADER_N_PAYLOAD(client);
 
 	/* Message id zero is not permitted by spec. */
 	if (message_id == 0) {
@@ -365,10 +479,10 @@ static int mqtt_message_id_only_enc(const struct mqtt_client *client,
 	}
 
 	payload = &client->tx_buf[MQTT_FIXED_HEADER_EXTENDED_SIZE];
-	memset(payload, 0, MQTT_MAX_VARIABLE_HEADER_N_PAYLOAD);
+	memset(payload, 0, buffer_len);
 
 	err_code = pack_uint16(message_id,
-			       MQTT_MAX_VARIABLE_HEADER_N_PAYLOAD,
+			       buffer_len,
 			       payload, &offset);
 
 	if (err_code == 0) {
@@ -395,28 +509,30 @@ int connect_request_encode(const struct mqtt_client *client,
 	u8_t connect_flags = client->clean_session << 1;
 	int err_code;
 	const struct mqtt_utf8 *mqtt_proto_desc;
+	const u32_t buffer_len = MQTT_MAX_VARIABLE_HEADER_N_PAYLOAD(client);
 
-	if (client->protocol_version == MQTT_VERSION_3_1_1) {
-		mqtt_proto_desc = &mqtt_3_1_1_proto_desc;
-	} else {
+	if (client->protocol_version == MQTT_VERSION_3_1_0) {
 		mqtt_proto_desc = &mqtt_3_1_0_proto_desc;
+	} else {
+		/* MQTT 3.1.1 and 5.0 share the protocol name. */
+		mqtt_proto_desc = &mqtt_3_1_1_proto_desc;
 	}
 
-	memset(payload, 0, MQTT_MAX_VARIABLE_HEADER_N_PAYLOAD);
+	memset(payload, 0, buffer_len);
 
 	/* Pack protocol description. */
 	MQTT_TRC("Encoding Protocol Description. Str:%s Size:%08x.",
 		 mqtt_proto_desc->utf8, mqtt_proto_desc->size);
 
 	err_code = pack_utf8_str(
-		mqtt_proto_desc, MQTT_MAX_VARIABLE_HEADER_N_PAYLOAD,
+		mqtt_proto_desc, buffer_len,
 		payload, &offset);
 	if (err_code == 0) {
 		MQTT_TRC("Encoding Protocol Version %02x.",
 			 client->protocol_version);
 		/* Pack protocol version. */
 		err_code = pack_uint8(client->protocol_version,
-				      MQTT_MAX_VARIABLE_HEADER_N_PAYLOAD,
+				      buffer_len,
 				      payload, &offset);
 	}
 
@@ -428,13 +544,21 @@ int connect_request_encode(const struct mqtt_client *client,
 	offset++;
 
 	if (err_code == 0) {
-		MQTT_TRC("Encoding Keep Alive Time %04x.", MQTT_KEEPALIVE);
+		MQTT_TRC("Encoding Keep Alive Time %04x.", client->keepalive);
 		/* Pack keep alive time. */
-		err_code = pack_uint16(MQTT_KEEPALIVE,
-				       MQTT_MAX_VARIABLE_HEADER_N_PAYLOAD,
+		err_code = pack_uint16(client->keepalive,
+				       buffer_len,
 				       payload, &offset);
 	}
 
+#if defined(CONFIG_MQTT_LIB_PROTOCOL_V5)
+	if ((err_code == 0) &&
+	    (client->protocol_version == MQTT_VERSION_5_0)) {
+		err_code = connect_properties_encode(client, buffer_len,
+						     payload, &offset);
+	}
+#endif
+
 	if (err_code == 0) {
 		MQTT_TRC("Encoding Client Id. Str:%s Size:%08x.",
 			 client->client_id.utf8,
@@ -442,7 +566,7 @@ int connect_request_encode(const struct mqtt_client *client,
 
 		/* Pack client id */
 		err_code = pack_utf8_str(&client->client_id,
-					 MQTT_MAX_VARIABLE_HEADER_N_PAYLOAD,
+					 buffer_len,
 					 payload, &offset);
 	}
 
@@ -456,10 +580,20 @@ int connect_request_encode(const struct mqtt_client *client,
 			/* Set Will topic in connect flags. */
 			connect_flags |= MQTT_CONNECT_FLAG_WILL_TOPIC;
 
-			err_code = pack_utf8_str(
-				&client->will_topic->topic,
-				MQTT_MAX_VARIABLE_HEADER_N_PAYLOAD,
-				payload, &offset);
+#if defined(CONFIG_MQTT_LIB_PROTOCOL_V5)
+			/* Will properties. */
+			err_code = zero_len_properties_encode(client,
+							      buffer_len,
+							      payload,
+							      &offset);
+#endif
+
+			if (err_code == 0) {
+				err_code = pack_utf8_str(
+					&client->will_topic->topic,
+					buffer_len,
+					payload, &offset);
+			}
 
 			if (err_code == 0) {
 				/* QoS is always 1 as of now. */
@@ -476,13 +610,13 @@ int connect_request_encode(const struct mqtt_client *client,
 
 					err_code = pack_utf8_str(
 					    client->will_message,
-					    MQTT_MAX_VARIABLE_HEADER_N_PAYLOAD,
+					    buffer_len,
 					    payload, &offset);
 				} else {
 					MQTT_TRC("Encoding Zero Length Will "
 						 "Message.");
 					err_code = zero_len_str_encode(
-					    MQTT_MAX_VARIABLE_HEADER_N_PAYLOAD,
+					    buffer_len,
 					    payload, &offset);
 				}
 			}
@@ -500,7 +634,7 @@ int connect_request_encode(const struct mqtt_client *client,
 
 			err_code = pack_utf8_str(
 				client->user_name,
-				MQTT_MAX_VARIABLE_HEADER_N_PAYLOAD,
+				buffer_len,
 				payload, &offset);
 
 			if (err_code == 0) {
@@ -515,7 +649,7 @@ int connect_request_encode(const struct mqtt_client *client,
 						MQTT_CONNECT_FLAG_PASSWORD;
 					err_code = pack_utf8_str(
 					    client->password,
-					    MQTT_MAX_VARIABLE_HEADER_N_PAYLOAD,
+					    buffer_len,
 					    payload, &offset);
 				}
 			}
@@ -550,13 +684,14 @@ int connect_request_encode(const struct mqtt_client *client,
 }
 
 int publish_encode(const struct mqtt_client *client,
-		   const struct mqtt_publish_param *param,
+		   const struct mqtt_publish_param *param, u16_t topic_alias,
 		   const u8_t **packet, u32_t *packet_length)
 {
 	int err_code = -ENOTCONN;
 	u32_t offset = 0;
 	u32_t mqtt_packetlen = 0;
 	u8_t *payload;
+	const u32_t buffer_len = MQTT_MAX_VARIABLE_HEADER_N_PAYLOAD(client);
 
 	/* Message id zero is not permitted by spec. */
 	if ((param->message.topic.qos) && (param->message_id == 0)) {
@@ -564,27 +699,37 @@ int publish_encode(const struct mqtt_client *client,
 	}
 
 	payload = &client->tx_buf[MQTT_FIXED_HEADER_EXTENDED_SIZE];
-	memset(payload, 0, MQTT_MAX_VARIABLE_HEADER_N_PAYLOAD);
 
 	/* Pack topic. */
 	err_code = pack_utf8_str(&param->message.topic.topic,
-				 MQTT_MAX_VARIABLE_HEADER_N_PAYLOAD,
+				 buffer_len,
 				 payload, &offset);
 
 	if (err_code == 0) {
 		if (param->message.topic.qos) {
 			err_code = pack_uint16(
 				param->message_id,
-				MQTT_MAX_VARIABLE_HEADER_N_PAYLOAD,
+				buffer_len,
 				payload, &offset);
 		}
 	}
 
-	if (err_code == 0) {
-		/* Pack message on the topic. */
-		err_code = pack_data(&param->message.payload,
-					MQTT_MAX_VARIABLE_HEADER_N_PAYLOAD,
-					payload, &offset);
+#if defined(CONFIG_MQTT_LIB_PROTOCOL_V5)
+	if ((err_code == 0) &&
+	    (client->protocol_version == MQTT_VERSION_5_0)) {
+		err_code = publish_properties_encode(topic_alias, buffer_len,
+						     payload, &offset);
+	}
+#else
+	(void)topic_alias;
+#endif
+
+	/* The message on the topic is not copied, it is sent by the caller
+	 * right after the encoded header. Only account for its length.
+	 */
+	if ((err_code == 0) &&
+	    (param->message.payload.len > MQTT_MAX_PAYLOAD_SIZE - offset)) {
+		err_code = -EMSGSIZE;
 	}
 
 	if (err_code == 0) {
@@ -592,11 +737,11 @@ int publish_encode(const struct mqtt_client *client,
 			MQTT_PKT_TYPE_PUBLISH, param->dup_flag,
 			param->message.topic.qos, param->retain_flag);
 
-		mqtt_packetlen = mqtt_encode_fixed_header(message_type,
-							  offset,
-							  &payload);
+		mqtt_packetlen = mqtt_encode_fixed_header(
+			message_type, offset + param->message.payload.len,
+			&payload);
 
-		*packet_length = mqtt_packetlen;
+		*packet_length = mqtt_packetlen - param->message.payload.len;
 		*packet = payload;
 	} else {
 		*packet_length = 0;
@@ -670,6 +815,7 @@ int subscribe_encode(const struct mqtt_client *client,
 	u32_t count = 0;
 	u32_t mqtt_packetlen = 0;
 	u8_t *payload;
+	const u32_t buffer_len = MQTT_MAX_VARIABLE_HEADER_N_PAYLOAD(client);
 
 	/* Message id zero is not permitted by spec. */
 	if (param->message_id == 0) {
@@ -677,21 +823,29 @@ int subscribe_encode(const struct mqtt_client *client,
 	}
 
 	payload = &client->tx_buf[MQTT_FIXED_HEADER_EXTENDED_SIZE];
-	memset(payload, 0, MQTT_MAX_VARIABLE_HEADER_N_PAYLOAD);
+	memset(payload, 0, buffer_len);
 
 	err_code = pack_uint16(param->message_id,
-			       MQTT_MAX_VARIABLE_HEADER_N_PAYLOAD,
+			       buffer_len,
 			       payload, &offset);
+
+#if defined(CONFIG_MQTT_LIB_PROTOCOL_V5)
+	if (err_code == 0) {
+		err_code = zero_len_properties_encode(client, buffer_len,
+						      payload, &offset);
+	}
+#endif
+
 	if (err_code == 0) {
 		do {
 			err_code = pack_utf8_str(
 				&param->list[count].topic,
-				MQTT_MAX_VARIABLE_HEADER_N_PAYLOAD,
+				buffer_len,
 				payload, &offset);
 			if (err_code == 0) {
 				err_code = pack_uint8(
 				    param->list[count].qos,
-				    MQTT_MAX_VARIABLE_HEADER_N_PAYLOAD,
+				    buffer_len,
 				    payload, &offset);
 			}
 			count++;
@@ -729,20 +883,28 @@ int unsubscribe_encode(const struct mqtt_client *client,
 	u32_t offset = 0;
 	u32_t mqtt_packetlen = 0;
 	u8_t *payload;
+	const u32_t buffer_len = MQTT_MAX_VARIABLE_HEADER_N_PAYLOAD(client);
 
 	payload = &client->tx_buf[MQTT_FIXED_HEADER_EXTENDED_SIZE];
-	memset(payload, 0, MQTT_MAX_VARIABLE_HEADER_N_PAYLOAD);
+	memset(payload, 0, buffer_len);
 
 	err_code = pack_uint16(param->message_id,
-			       MQTT_MAX_VARIABLE_HEADER_N_PAYLOAD,
+			       buffer_len,
 			       payload,
 			       &offset);
 
+#if defined(CONFIG_MQTT_LIB_PROTOCOL_V5)
+	if (err_code == 0) {
+		err_code = zero_len_properties_encode(client, buffer_len,
+						      payload, &offset);
+	}
+#endif
+
 	if (err_code == 0) {
 		do {
 			err_code = pack_utf8_str(
 				&param->list[count].topic,
-				MQTT_MAX_VARIABLE_HEADER_N_PAYLOAD,
+				buffer_len,
 				payload, &offset);
 			count++;
 		} while ((err_code == 0) &&
@@ -0,0 +1,320 @@
+/*
+ * Copyright (c) 2018 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+/** @file mqtt_inflight.c
+ *
+ * @brief Tracking and retransmission of QoS 1 and QoS 2 publish messages
+ *        awaiting acknowledgment from the broker.
+ */
+
+#define LOG_MODULE_NAME net_mqtt_inflight
+#define NET_LOG_LEVEL CONFIG_MQTT_LOG_LEVEL
+
+#include "mqtt_internal.h"
+#include "mqtt_os.h"
+
+/**@brief Retransmission timeout in milliseconds, 0 to retransmit only when
+ *        the connection is established again.
+ */
+#define MQTT_INFLIGHT_TIMEOUT_MS \
+	(CONFIG_MQTT_INFLIGHT_RETRANSMIT_TIMEOUT * 1000)
+
+static struct mqtt_inflight *inflight_find(struct mqtt_client *client,
+					   u16_t message_id)
+{
+	for (u32_t i = 0; i < ARRAY_SIZE(client->inflight); i++) {
+		struct mqtt_inflight *entry = &client->inflight[i];
+
+		if ((entry->state != MQTT_INFLIGHT_FREE) &&
+		    (entry->param.message_id == message_id)) {
+			return entry;
+		}
+	}
+
+	return NULL;
+}
+
+static struct mqtt_inflight *inflight_free_find(struct mqtt_client *client)
+{
+	for (u32_t i = 0; i < ARRAY_SIZE(client->inflight); i++) {
+		if (client->inflight[i].state == MQTT_INFLIGHT_FREE) {
+			return &client->inflight[i];
+		}
+	}
+
+	return NULL;
+}
+
+static u16_t inflight_message_id_alloc(struct mqtt_client *client)
+{
+	do {
+		client->inflight_message_id++;
+
+		/* Message id zero is not permitted by spec. */
+		if (client->inflight_message_id == 0) {
+			client->inflight_message_id = 1;
+		}
+	} while (inflight_find(client, client->inflight_message_id) != NULL);
+
+	return client->inflight_message_id;
+}
+
+/**@brief Sends the message of an in-flight entry again. Publish messages are
+ *        sent with the DUP flag set, and Publish Release is sent for QoS 2
+ *        messages already received by the broker.
+ *
+ * @param[in] client Identifies the client for which the procedure is requested.
+ * @param[in] entry In-flight entry to retransmit.
+ *
+ * @retval 0 or an error code indicating reason for failure.
+ */
+static int inflight_send(struct mqtt_client *client,
+			 struct mqtt_inflight *entry)
+{
+	const u8_t *packet;
+	u32_t packetlen;
+	int err_code;
+
+	if (entry->state == MQTT_INFLIGHT_PUBCOMP) {
+		const struct mqtt_pubrel_param param = {
+			.message_id = entry->param.message_id
+		};
+
+		err_code = publish_release_encode(client, &param, &packet,
+						  &packetlen);
+		if (err_code == 0) {
+			err_code = client_write(client, packet, packetlen);
+		}
+	} else {
+		/* Sent like the first time, through the payload codec. */
+		entry->param.dup_flag = 1;
+
+		err_code = client_publish(client, &entry->param);
+	}
+
+	if (err_code == 0) {
+		entry->timestamp = mqtt_sys_tick_in_ms_get();
+	}
+
+	return err_code;
+}
+
+/**@brief Releases an in-flight entry and notifies the application. */
+static void inflight_complete(struct mqtt_client *client,
+			      struct mqtt_inflight *entry, int result)
+{
+	const mqtt_publish_done_cb_t cb = entry->cb;
+	void *user_data = entry->user_data;
+	const u16_t message_id = entry->param.message_id;
+
+	entry->state = MQTT_INFLIGHT_FREE;
+
+	MQTT_TRC("[CID %p]: Message id 0x%04x complete, result %d", client,
+		 message_id, result);
+
+	if (cb != NULL) {
+		mqtt_mutex_unlock(client);
+
+		cb(client, message_id, result, user_data);
+
+		mqtt_mutex_lock(client);
+	}
+}
+
+int inflight_add(struct mqtt_client *client,
+		 const struct mqtt_publish_param *param,
+		 mqtt_publish_done_cb_t cb, void *user_data,
+		 struct mqtt_inflight **entry)
+{
+	struct mqtt_inflight *free_entry;
+
+	if ((param->message_id != 0) &&
+	    (inflight_find(client, param->message_id) != NULL)) {
+		return -EALREADY;
+	}
+
+	free_entry = inflight_free_find(client);
+	if (free_entry == NULL) {
+		return -ENOMEM;
+	}
+
+	free_entry->param = *param;
+	free_entry->cb = cb;
+	free_entry->user_data = user_data;
+	free_entry->timestamp = mqtt_sys_tick_in_ms_get();
+
+	if (param->message_id == 0) {
+		free_entry->param.message_id =
+			inflight_message_id_alloc(client);
+	}
+
+	if (param->message.topic.qos == MQTT_QOS_1_AT_LEAST_ONCE) {
+		free_entry->state = MQTT_INFLIGHT_PUBACK;
+	} else {
+		free_entry->state = MQTT_INFLIGHT_PUBREC;
+	}
+
+	*entry = free_entry;
+
+	return 0;
+}
+
+void inflight_remove(struct mqtt_client *client, struct mqtt_inflight *entry)
+{
+	ARG_UNUSED(client);
+
+	entry->state = MQTT_INFLIGHT_FREE;
+}
+
+void inflight_retransmit(struct mqtt_client *client, bool all)
+{
+	for (u32_t i = 0; i < ARRAY_SIZE(client->inflight); i++) {
+		struct mqtt_inflight *entry = &client->inflight[i];
+
+		if (entry->state == MQTT_INFLIGHT_FREE) {
+			continue;
+		}
+
+		if (!all && ((MQTT_INFLIGHT_TIMEOUT_MS == 0) ||
+			     (mqtt_elapsed_time_in_ms_get(entry->timestamp) <
+			      MQTT_INFLIGHT_TIMEOUT_MS))) {
+			continue;
+		}
+
+		MQTT_TRC("[CID %p]: Retransmitting message id 0x%04x", client,
+			 entry->param.message_id);
+
+		if (inflight_send(client, entry) != 0) {
+			/* Retried on next timeout or connection. */
+			MQTT_ERR("Failed to retransmit message id 0x%04x",
+				 entry->param.message_id);
+			break;
+		}
+	}
+}
+
+s32_t inflight_timeout_get(struct mqtt_client *client)
+{
+	s32_t timeout = K_FOREVER;
+
+	if (MQTT_INFLIGHT_TIMEOUT_MS == 0) {
+		return K_FOREVER;
+	}
+
+	for (u32_t i = 0; i < ARRAY_SIZE(client->inflight); i++) {
+		struct mqtt_inflight *entry = &client->inflight[i];
+		u32_t elapsed_time;
+		s32_t remaining;
+
+		if (entry->state == MQTT_INFLIGHT_FREE) {
+			continue;
+		}
+
+		elapsed_time = mqtt_elapsed_time_in_ms_get(entry->timestamp);
+		remaining = (elapsed_time >= MQTT_INFLIGHT_TIMEOUT_MS) ? 0 :
+			    MQTT_INFLIGHT_TIMEOUT_MS - elapsed_time;
+
+		if ((timeout == K_FOREVER) || (remaining < timeout)) {
+			timeout = remaining;
+		}
+	}
+
+	return timeout;
+}
+
+/**@brief Gets the completion result of an acknowledgment event.
+ *
+ * @param[in] evt PUBACK, PUBREC or PUBCOMP event.
+ *
+ * @retval 0 if the broker accepted the message.
+ * @retval -EPERM if the broker rejected the message with an MQTT 5.0 Reason
+ *         Code.
+ */
+static int inflight_ack_result(const struct mqtt_evt *evt)
+{
+#if defined(CONFIG_MQTT_LIB_PROTOCOL_V5)
+	u8_t reason_code;
+
+	switch (evt->type) {
+	case MQTT_EVT_PUBACK:
+		reason_code = evt->param.puback.reason_code;
+		break;
+
+	case MQTT_EVT_PUBREC:
+		reason_code = evt->param.pubrec.reason_code;
+		break;
+
+	case MQTT_EVT_PUBCOMP:
+		reason_code = evt->param.pubcomp.reason_code;
+		break;
+
+	default:
+		reason_code = 0;
+		break;
+	}
+
+	if (reason_code >= MQTT_REASON_CODE_FAILURE) {
+		return -EPERM;
+	}
+#else
+	ARG_UNUSED(evt);
+#endif
+
+	return 0;
+}
+
+void inflight_event_handle(struct mqtt_client *client,
+			   const struct mqtt_evt *evt)
+{
+	struct mqtt_inflight *entry;
+	int result;
+
+	switch (evt->type) {
+	case MQTT_EVT_CONNACK:
+		if (evt->param.connack.return_code ==
+					MQTT_CONNECTION_ACCEPTED) {
+			inflight_retransmit(client, true);
+		}
+		break;
+
+	case MQTT_EVT_PUBACK:
+		entry = inflight_find(client, evt->param.puback.message_id);
+		if ((entry != NULL) && (entry->state == MQTT_INFLIGHT_PUBACK)) {
+			inflight_complete(client, entry,
+					  inflight_ack_result(evt));
+		}
+		break;
+
+	case MQTT_EVT_PUBREC:
+		entry = inflight_find(client, evt->param.pubrec.message_id);
+		if ((entry == NULL) || (entry->state == MQTT_INFLIGHT_PUBACK)) {
+			break;
+		}
+
+		result = inflight_ack_result(evt);
+		if (result != 0) {
+			/* The exchange ends, the message is not released. */
+			inflight_complete(client, entry, result);
+		} else {
+			/* Release the message, also when PUBREC is repeated. */
+			entry->state = MQTT_INFLIGHT_PUBCOMP;
+			(void)inflight_send(client, entry);
+		}
+		break;
+
+	case MQTT_EVT_PUBCOMP:
+		entry = inflight_find(client, evt->param.pubcomp.message_id);
+		if ((entry != NULL) &&
+		    (entry->state == MQTT_INFLIGHT_PUBCOMP)) {
+			inflight_complete(client, entry,
+					  inflight_ack_result(evt));
+		}
+		break;
+
+	default:
+		break;
+	}
+}
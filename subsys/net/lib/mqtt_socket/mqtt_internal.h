@@ -12,10 +12,12 @@
 #ifndef MQTT_INTERNAL_H_
 #define MQTT_INTERNAL_H_
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <string.h>
 
 #include <net/mqtt_socket.h>
+#include <net/socket.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -29,11 +31,6 @@ extern "C" {
  */
 #define MQTT_KEEPALIVE CONFIG_MQTT_KEEPALIVE
 
-/**@brief Maximum MQTT packet size that can be sent (including the fixed and
- *        variable header).
- */
-#define MQTT_MAX_PACKET_LENGTH CONFIG_MQTT_MAX_PACKET_LENGTH
-
 /**@brief Fixed header minimum size. Remaining length size is 1 in this case. */
 #define MQTT_FIXED_HEADER_SIZE 2
 
@@ -73,15 +70,49 @@ extern "C" {
 
 #define MQTT_CONNACK_FLAG_SESSION_PRESENT 0x01
 
+/**@brief MQTT 5.0 property identifiers. */
+#define MQTT_PROP_PAYLOAD_FORMAT_INDICATOR          0x01
+#define MQTT_PROP_MESSAGE_EXPIRY_INTERVAL           0x02
+#define MQTT_PROP_CONTENT_TYPE                      0x03
+#define MQTT_PROP_RESPONSE_TOPIC                    0x08
+#define MQTT_PROP_CORRELATION_DATA                  0x09
+#define MQTT_PROP_SUBSCRIPTION_IDENTIFIER           0x0B
+#define MQTT_PROP_SESSION_EXPIRY_INTERVAL           0x11
+#define MQTT_PROP_ASSIGNED_CLIENT_IDENTIFIER        0x12
+#define MQTT_PROP_SERVER_KEEP_ALIVE                 0x13
+#define MQTT_PROP_AUTHENTICATION_METHOD             0x15
+#define MQTT_PROP_AUTHENTICATION_DATA               0x16
+#define MQTT_PROP_REQUEST_PROBLEM_INFORMATION       0x17
+#define MQTT_PROP_WILL_DELAY_INTERVAL               0x18
+#define MQTT_PROP_REQUEST_RESPONSE_INFORMATION      0x19
+#define MQTT_PROP_RESPONSE_INFORMATION              0x1A
+#define MQTT_PROP_SERVER_REFERENCE                  0x1C
+#define MQTT_PROP_REASON_STRING                     0x1F
+#define MQTT_PROP_RECEIVE_MAXIMUM                   0x21
+#define MQTT_PROP_TOPIC_ALIAS_MAXIMUM               0x22
+#define MQTT_PROP_TOPIC_ALIAS                       0x23
+#define MQTT_PROP_MAXIMUM_QOS                       0x24
+#define MQTT_PROP_RETAIN_AVAILABLE                  0x25
+#define MQTT_PROP_USER_PROPERTY                     0x26
+#define MQTT_PROP_MAXIMUM_PACKET_SIZE               0x27
+#define MQTT_PROP_WILDCARD_SUBSCRIPTION_AVAILABLE   0x28
+#define MQTT_PROP_SUBSCRIPTION_IDENTIFIER_AVAILABLE 0x29
+#define MQTT_PROP_SHARED_SUBSCRIPTION_AVAILABLE     0x2A
+
+/**@brief Lowest MQTT 5.0 Reason Code indicating a failure. */
+#define MQTT_REASON_CODE_FAILURE 0x80
+
 /**@brief Size of mandatory header of MQTT packet. */
 #define MQTT_PKT_HEADER_SIZE 2
 
 /**@brief Maximum payload size of MQTT packet. */
 #define MQTT_MAX_PAYLOAD_SIZE 0x0FFFFFFF
 
-/**@brief Maximum size of variable and payload in the packet. */
-#define MQTT_MAX_VARIABLE_HEADER_N_PAYLOAD \
-	(MQTT_MAX_PACKET_LENGTH - MQTT_FIXED_HEADER_EXTENDED_SIZE)
+/**@brief Maximum size of variable and payload in the packet, given the TX
+ *        buffer of the client.
+ */
+#define MQTT_MAX_VARIABLE_HEADER_N_PAYLOAD(CLIENT) \
+	((CLIENT)->tx_buf_size - MQTT_FIXED_HEADER_EXTENDED_SIZE)
 
 /**@brief Computes total size needed to pack a UTF8 string. */
 #define GET_UT8STR_BUFFER_SIZE(STR) (sizeof(u16_t) + (STR)->size)
@@ -166,6 +197,21 @@ enum mqtt_state {
 	MQTT_STATE_DISCONNECTING        = 0x00000010
 };
 
+/**@brief States of an in-flight publish message. */
+enum mqtt_inflight_state {
+	/** Entry is unused. */
+	MQTT_INFLIGHT_FREE    = 0x00,
+
+	/** QoS 1 message awaiting Publish Ack. */
+	MQTT_INFLIGHT_PUBACK  = 0x01,
+
+	/** QoS 2 message awaiting Publish Receive. */
+	MQTT_INFLIGHT_PUBREC  = 0x02,
+
+	/** QoS 2 message released, awaiting Publish Complete. */
+	MQTT_INFLIGHT_PUBCOMP = 0x03
+};
+
 /**@brief Notify application about MQTT event.
  *
  * @param[in] client Identifies the client for which event occurred.
@@ -188,6 +234,28 @@ void event_notify(struct mqtt_client *client, const struct mqtt_evt *evt,
 u32_t mqtt_handle_rx_data(struct mqtt_client *client, u8_t *data,
 			  u32_t datalen);
 
+/**@brief Decodes the length of the frame at the start of the received data.
+ *        A frame is a complete MQTT packet, except for Publish packets in
+ *        streaming mode, where the frame ends with the variable header and
+ *        the payload is left on the transport.
+ *
+ * @param[in] client Identifies the client for which the data was received.
+ * @param[in] data MQTT data received.
+ * @param[in] datalen Length of data received.
+ * @param[out] offset Offset of the first byte after MQTT fixed header.
+ * @param[out] frame_length Length of the frame. If more data is needed to
+ *                          decode it, the length of data that shall be
+ *                          received before trying again.
+ * @param[out] packet_length Length of the MQTT packet.
+ *
+ * @retval 0 if the procedure is successful.
+ * @retval -EAGAIN if more data is needed to decode the frame length.
+ * @retval -EINVAL if the packet is malformed.
+ */
+int frame_length_decode(const struct mqtt_client *client, u8_t *data,
+			u32_t datalen, u32_t *offset, u32_t *frame_length,
+			u32_t *packet_length);
+
 /**@brief Constructs/encodes Connect packet.
  *
  * @param[in] client Identifies the client for which the procedure is requested.
@@ -203,17 +271,21 @@ u32_t mqtt_handle_rx_data(struct mqtt_client *client, u8_t *data,
 int connect_request_encode(const struct mqtt_client *client,
 			   const u8_t **packet, u32_t *packet_length);
 
-/**@brief Constructs/encodes Publish packet.
+/**@brief Constructs/encodes Publish packet, except for the message on the
+ *        topic. The message shall be sent directly after the encoded fixed
+ *        and variable header.
  *
  * @param[in] client Identifies the client for which packet is encoded.
    @param[in] param Publish message parameters.
- * @param[out] packet Pointer to the MQTT Publish message.
- * @param[out] packet_length Length of the Publish message.
+ * @param[in] topic_alias Topic alias to send with an MQTT 5.0 message, 0 for
+ *                        none. The topic may then be empty.
+ * @param[out] packet Pointer to the MQTT Publish message header.
+ * @param[out] packet_length Length of the Publish message header.
  *
  * @return 0 if the procedure is successful, an error code otherwise.
  */
 int publish_encode(const struct mqtt_client *client,
-		   const struct mqtt_publish_param *param,
+		   const struct mqtt_publish_param *param, u16_t topic_alias,
 		   const u8_t **packet, u32_t *packet_length);
 
 /**@brief Constructs/encodes Publish Ack packet.
@@ -348,6 +420,7 @@ int connect_ack_decode(const struct mqtt_client *client, u8_t *data,
 
 /**@brief Decode MQTT Publish packet.
  *
+ * @param[in] client Identifies the client for which the packet was received.
  * @param[in] data Buffer containing message to decode.
  * @param[in] datalen Length of the message.
  * @param[in] offset Offset of the first byte after MQTT fixed header.
@@ -355,7 +428,8 @@ int connect_ack_decode(const struct mqtt_client *client, u8_t *data,
  *
  * @return 0 if the procedure is successful, an error code otherwise.
  */
-int publish_decode(u8_t *data, u32_t datalen, u32_t offset,
+int publish_decode(const struct mqtt_client *client, u8_t *data,
+		   u32_t datalen, u32_t offset,
 		   struct mqtt_publish_param *param);
 
 /**@brief Decode MQTT Publish Ack packet.
@@ -408,6 +482,7 @@ int publish_complete_decode(u8_t *data, u32_t datalen, u32_t offset,
 
 /**@brief Decode MQTT Subscribe packet.
  *
+ * @param[in] client Identifies the client for which the packet was received.
  * @param[in] data Buffer containing message to decode.
  * @param[in] datalen Length of the message.
  * @param[in] offset Offset of the first byte after MQTT fixed header.
@@ -415,11 +490,13 @@ int publish_complete_decode(u8_t *data, u32_t datalen, u32_t offset,
  *
  * @return 0 if the procedure is successful, an error code otherwise.
  */
-int subscribe_ack_decode(u8_t *data, u32_t datalen, u32_t offset,
+int subscribe_ack_decode(const struct mqtt_client *client, u8_t *data,
+			 u32_t datalen, u32_t offset,
 			 struct mqtt_suback_param *param);
 
 /**@brief Decode MQTT Unsubscribe packet.
  *
+ * @param[in] client Identifies the client for which the packet was received.
  * @param[in] data Buffer containing message to decode.
  * @param[in] datalen Length of the message.
  * @param[in] offset Offset of the first byte after MQTT fixed header.
@@ -427,9 +504,145 @@ int subscribe_ack_decode(u8_t *data, u32_t datalen, u32_t offset,
  *
  * @return 0 if the procedure is successful, an error code otherwise.
  */
-int unsubscribe_ack_decode(u8_t *data, u32_t datalen, u32_t offset,
+int unsubscribe_ack_decode(const struct mqtt_client *client, u8_t *data,
+			   u32_t datalen, u32_t offset,
 			   struct mqtt_unsuback_param *param);
 
+/**@brief Writes a packet to the transport of the client, after the coalesced
+ *        publish messages. The connection is closed if the write fails.
+ *
+ * @param[in] client Identifies the client for which the procedure is requested.
+ * @param[in] data Packet to write.
+ * @param[in] datalen Length of the packet.
+ *
+ * @retval 0 if the procedure is successful.
+ * @retval -EIO if the write failed.
+ */
+int client_write(struct mqtt_client *client, const u8_t *data,
+		 u32_t datalen);
+
+/**@brief Writes a packet made of I/O vectors to the transport of the client,
+ *        after the coalesced publish messages. The connection is closed if
+ *        the write fails.
+ *
+ * @param[in] client Identifies the client for which the procedure is requested.
+ * @param[in] message Message with the I/O vectors to write.
+ *
+ * @retval 0 if the procedure is successful.
+ * @retval -EIO if the write failed.
+ */
+int client_write_msg(struct mqtt_client *client, struct msghdr *message);
+
+/**@brief Encodes and writes a publish message, or adds it to the coalesced
+ *        messages. The payload codec and the topic aliases of the client
+ *        are applied.
+ *
+ * @param[in] client Identifies the client for which the procedure is requested.
+ * @param[in] param Publish message parameters.
+ *
+ * @return 0 if the procedure is successful, an error code otherwise.
+ */
+int client_publish(struct mqtt_client *client,
+		   const struct mqtt_publish_param *param);
+
+#if defined(CONFIG_MQTT_LIB_INFLIGHT)
+/**@brief Adds a publish message to the in-flight window of the client.
+ *
+ * @param[in] client Identifies the client sending the message.
+ * @param[in] param Publish message parameters. A message id is allocated if
+ *                  message_id is 0.
+ * @param[in] cb Completion callback.
+ * @param[in] user_data User data passed to the completion callback.
+ * @param[out] entry In-flight entry of the message.
+ *
+ * @retval 0 if the procedure is successful.
+ * @retval -ENOMEM if the in-flight window is full.
+ * @retval -EALREADY if a message with the same id is already in flight.
+ */
+int inflight_add(struct mqtt_client *client,
+		 const struct mqtt_publish_param *param,
+		 mqtt_publish_done_cb_t cb, void *user_data,
+		 struct mqtt_inflight **entry);
+
+/**@brief Removes a message from the in-flight window without notification.
+ *
+ * @param[in] client Identifies the client that sent the message.
+ * @param[in] entry In-flight entry of the message.
+ */
+void inflight_remove(struct mqtt_client *client, struct mqtt_inflight *entry);
+
+/**@brief Retransmits in-flight messages.
+ *
+ * @param[in] client Identifies the client for which the procedure is requested.
+ * @param[in] all Retransmit all messages if true, otherwise only messages
+ *                for which the retransmission timeout expired.
+ */
+void inflight_retransmit(struct mqtt_client *client, bool all);
+
+/**@brief Gets the time until the next retransmission of an in-flight message.
+ *
+ * @param[in] client Identifies the client for which the procedure is requested.
+ *
+ * @return Time in milliseconds, or K_FOREVER if no retransmission is pending.
+ */
+s32_t inflight_timeout_get(struct mqtt_client *client);
+
+/**@brief Updates the in-flight window on a received MQTT event, before the
+ *        event is notified to the application.
+ *
+ * @param[in] client Identifies the client for which the event occurred.
+ * @param[in] evt MQTT event.
+ */
+void inflight_event_handle(struct mqtt_client *client,
+			   const struct mqtt_evt *evt);
+#endif /* CONFIG_MQTT_LIB_INFLIGHT */
+
+#if defined(CONFIG_MQTT_LIB_QUEUE)
+/**@brief Initializes the persistent queue of publish messages.
+ *
+ * @return 0 if the procedure is successful, an error code otherwise.
+ */
+int queue_init(void);
+
+/**@brief Checks if the persistent queue has messages left to send.
+ *
+ * @return true if all queued messages are sent, false otherwise.
+ */
+bool queue_is_empty(void);
+
+/**@brief Appends a publish message to the persistent queue. The oldest
+ *        messages are dropped if the queue is full. Messages that the client
+ *        could not encode are rejected.
+ *
+ * @param[in] client Identifies the client that replays the message.
+ * @param[in] param Publish message parameters.
+ *
+ * @retval 0 if the procedure is successful.
+ * @retval -EINVAL if the message has a QoS above 0 and no message ID.
+ * @retval -EMSGSIZE if the message exceeds CONFIG_MQTT_QUEUE_MAX_MESSAGE_SIZE.
+ * @retval -ENOMEM if the topic does not fit in the transmit buffer, or the
+ *         message could not be stored.
+ * @retval -EIO if the message could not be stored.
+ */
+int queue_store(const struct mqtt_client *client,
+		const struct mqtt_publish_param *param);
+
+/**@brief Reads the next message to send from the persistent queue.
+ *
+ * @param[out] param Publish message parameters. Topic and payload are valid
+ *                   until the next call to the queue.
+ *
+ * @retval 0 if the procedure is successful.
+ * @retval -ENOENT if there are no messages left to send.
+ * @retval -EBADMSG or -EIO if the message could not be read. The message
+ *         shall be dropped with @ref queue_pop.
+ */
+int queue_peek(struct mqtt_publish_param *param);
+
+/**@brief Marks the message returned by @ref queue_peek as sent. */
+void queue_pop(void);
+#endif /* CONFIG_MQTT_LIB_QUEUE */
+
 #ifdef __cplusplus
 }
 #endif
@@ -9,7 +9,7 @@
  * @brief MQTT Client depends on certain OS specific functionality. The needed
  *        methods are mapped here and should be implemented based on OS in use.
  *
- * @details Memory management, mutex, logging and wall clock are the needed
+ * @details Mutex, logging and wall clock are the needed
  *          functionality for MQTT module. The needed interfaces are defined
  *          in the OS. OS specific port of the interface shall be provided.
  *
@@ -29,71 +29,43 @@
 extern "C" {
 #endif
 
-extern struct k_mutex mqtt_mutex;
-extern struct k_mem_slab mqtt_slab;
-
 /**@brief Method to get trace logs from the module. */
 #define MQTT_TRC(...) NET_DBG(__VA_ARGS__)
 
 /**@brief Method to error logs from the module. */
 #define MQTT_ERR(...) NET_ERR(__VA_ARGS__)
 
-/**@brief Initialize the mutex for the module, if any.
+/**@brief Initialize the mutex of a client instance.
+ *
+ * @details This method is called during client initialization
+ *          @ref mqtt_client_init.
  *
- * @details This method is called during module initialization @ref mqtt_init.
+ * @param[in] client Client instance.
  */
-static inline void mqtt_mutex_init(void)
+static inline void mqtt_mutex_init(struct mqtt_client *client)
 {
-	k_mutex_init(&mqtt_mutex);
+	k_mutex_init(&client->mutex);
 }
 
-/**@brief Acquire lock on the module specific mutex, if any.
+/**@brief Acquire lock on the mutex of a client instance.
  *
  * @details This is assumed to be a blocking method until the acquisition
  *          of the mutex succeeds.
- */
-static inline void mqtt_mutex_lock(void)
-{
-	(void)k_mutex_lock(&mqtt_mutex, K_FOREVER);
-}
-
-/**@brief Release the lock on the module specific mutex, if any.
- */
-static inline void mqtt_mutex_unlock(void)
-{
-	k_mutex_unlock(&mqtt_mutex);
-}
-
-/**@brief Method to allocate memory for internal use in the module.
- *
- * @param[in] size Size of memory requested.
  *
- * @retval A valid pointer on success, NULL otherwise.
+ * @param[in] client Client instance.
  */
-static inline void *mqtt_malloc(size_t size)
+static inline void mqtt_mutex_lock(struct mqtt_client *client)
 {
-	void *mem;
-
-	if (size != MQTT_MAX_PACKET_LENGTH) {
-		return NULL;
-	}
-
-	if (k_mem_slab_alloc(&mqtt_slab, (void **)&mem, K_NO_WAIT) < 0) {
-		return NULL;
-	}
-
-	return mem;
+	(void)k_mutex_lock(&client->mutex, K_FOREVER);
 }
 
-/**@brief Method to free any allocated memory for internal use in the module.
+/**@brief Release the lock on the mutex of a client instance.
  *
- * @param[in] ptr Memory to be freed.
+ * @param[in] client Client instance.
  */
-static inline void mqtt_free(void *ptr)
+static inline void mqtt_mutex_unlock(struct mqtt_client *client)
 {
-	void *mem = ptr;
-
-	k_mem_slab_free(&mqtt_slab, (void **)&mem);
+	k_mutex_unlock(&client->mutex);
 }
 
 /**@brief Method to get the sys tick or a wall clock in millisecond resolution.
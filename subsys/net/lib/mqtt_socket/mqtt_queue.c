@@ -0,0 +1,225 @@
+/*
+ * Copyright (c) 2018 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+/** @file mqtt_queue.c
+ *
+ * @brief Persistent queue of publish messages sent while disconnected.
+ *
+ * @details Messages are appended to a flash circular buffer on the storage
+ *          partition and replayed in order once the client is connected.
+ *          Sectors are erased when all their messages are sent, or when the
+ *          queue is full, in which case the oldest messages are dropped.
+ *          Messages sent but not yet erased are replayed again after reset.
+ */
+
+#define LOG_MODULE_NAME net_mqtt_queue
+#define NET_LOG_LEVEL CONFIG_MQTT_LOG_LEVEL
+
+#include <flash_map.h>
+#include <fcb.h>
+
+#include "mqtt_internal.h"
+#include "mqtt_os.h"
+
+#define MQTT_QUEUE_FLASH_AREA_ID DT_FLASH_AREA_STORAGE_ID
+#define MQTT_QUEUE_MAGIC 0x5154514d /* "MQTQ" */
+#define MQTT_QUEUE_VERSION 1
+
+/**@brief Header of a message stored in the queue, followed by the topic and
+ *        the payload.
+ */
+struct queue_record {
+	u16_t message_id;
+	u16_t topic_len;
+	u8_t qos;
+	u8_t retain;
+} __packed;
+
+static struct flash_sector queue_sectors[CONFIG_MQTT_QUEUE_SECTOR_COUNT];
+static struct fcb queue_fcb;
+
+/** Last message sent. No message sent since the queue was emptied if
+ *  fe_sector is NULL.
+ */
+static struct fcb_entry queue_cursor;
+
+/** Message returned by queue_peek, sent next. */
+static struct fcb_entry queue_next;
+
+/** Message being stored or replayed, padded to the flash write alignment. */
+static u8_t __aligned(4) queue_buf[CONFIG_MQTT_QUEUE_MAX_MESSAGE_SIZE + 8];
+
+static int queue_next_get(struct fcb_entry *loc)
+{
+	*loc = queue_cursor;
+
+	return fcb_getnext(&queue_fcb, loc);
+}
+
+static void queue_oldest_drop(void)
+{
+	if (queue_cursor.fe_sector == queue_fcb.f_oldest) {
+		/* Restart from the new oldest message. */
+		queue_cursor.fe_sector = NULL;
+	}
+
+	(void)fcb_rotate(&queue_fcb);
+}
+
+int queue_init(void)
+{
+	u32_t sector_count = ARRAY_SIZE(queue_sectors);
+	int err_code;
+
+	err_code = flash_area_get_sectors(MQTT_QUEUE_FLASH_AREA_ID,
+					  &sector_count, queue_sectors);
+	if (err_code != 0) {
+		MQTT_ERR("Failed to get queue sectors, error %d", err_code);
+		return err_code;
+	}
+
+	queue_fcb.f_magic = MQTT_QUEUE_MAGIC;
+	queue_fcb.f_version = MQTT_QUEUE_VERSION;
+	queue_fcb.f_sector_cnt = sector_count;
+	queue_fcb.f_scratch_cnt = 0;
+	queue_fcb.f_sectors = queue_sectors;
+
+	err_code = fcb_init(MQTT_QUEUE_FLASH_AREA_ID, &queue_fcb);
+	if (err_code != 0) {
+		MQTT_ERR("Failed to initialize queue, error %d", err_code);
+		return -EIO;
+	}
+
+	queue_cursor.fe_sector = NULL;
+
+	return 0;
+}
+
+bool queue_is_empty(void)
+{
+	struct fcb_entry loc;
+
+	return queue_next_get(&loc) != 0;
+}
+
+int queue_store(const struct mqtt_client *client,
+		const struct mqtt_publish_param *param)
+{
+	const struct mqtt_utf8 *topic = &param->message.topic.topic;
+	const struct mqtt_binstr *payload = &param->message.payload;
+	const struct queue_record record = {
+		.message_id = param->message_id,
+		.topic_len = topic->size,
+		.qos = param->message.topic.qos,
+		.retain = param->retain_flag
+	};
+	const u32_t len = sizeof(record) + topic->size + payload->len;
+	const u8_t *packet;
+	u32_t packetlen;
+	struct fcb_entry loc;
+	int err_code;
+
+	if (len > CONFIG_MQTT_QUEUE_MAX_MESSAGE_SIZE) {
+		return -EMSGSIZE;
+	}
+
+	/* Messages that can not be encoded would block the replay. */
+	err_code = publish_encode(client, param, 0, &packet, &packetlen);
+	if (err_code != 0) {
+		return err_code;
+	}
+
+	err_code = fcb_append(&queue_fcb, len, &loc);
+	if (err_code != 0) {
+		MQTT_ERR("Queue full, dropping oldest messages");
+
+		queue_oldest_drop();
+
+		err_code = fcb_append(&queue_fcb, len, &loc);
+		if (err_code != 0) {
+			return -ENOMEM;
+		}
+	}
+
+	memcpy(queue_buf, &record, sizeof(record));
+	memcpy(queue_buf + sizeof(record), topic->utf8, topic->size);
+	memcpy(queue_buf + sizeof(record) + topic->size, payload->data,
+	       payload->len);
+
+	err_code = flash_area_write(queue_fcb.fap, FCB_ENTRY_FA_DATA_OFF(loc),
+				    queue_buf,
+				    ROUND_UP(len, queue_fcb.f_align));
+	if (err_code == 0) {
+		err_code = fcb_append_finish(&queue_fcb, &loc);
+	}
+
+	if (err_code != 0) {
+		MQTT_ERR("Failed to store message, error %d", err_code);
+		return -EIO;
+	}
+
+	return 0;
+}
+
+int queue_peek(struct mqtt_publish_param *param)
+{
+	struct queue_record record;
+	int err_code;
+
+	if (queue_next_get(&queue_next) != 0) {
+		return -ENOENT;
+	}
+
+	if ((queue_next.fe_data_len < sizeof(record)) ||
+	    (queue_next.fe_data_len > CONFIG_MQTT_QUEUE_MAX_MESSAGE_SIZE)) {
+		return -EBADMSG;
+	}
+
+	err_code = flash_area_read(queue_fcb.fap,
+				   FCB_ENTRY_FA_DATA_OFF(queue_next),
+				   queue_buf, queue_next.fe_data_len);
+	if (err_code != 0) {
+		return -EIO;
+	}
+
+	memcpy(&record, queue_buf, sizeof(record));
+
+	if (sizeof(record) + record.topic_len > queue_next.fe_data_len) {
+		return -EBADMSG;
+	}
+
+	memset(param, 0, sizeof(*param));
+	param->message_id = record.message_id;
+	param->retain_flag = record.retain;
+	param->message.topic.qos = record.qos;
+	param->message.topic.topic.utf8 = queue_buf + sizeof(record);
+	param->message.topic.topic.size = record.topic_len;
+	param->message.payload.data = queue_buf + sizeof(record) +
+				      record.topic_len;
+	param->message.payload.len = queue_next.fe_data_len -
+				     sizeof(record) - record.topic_len;
+
+	return 0;
+}
+
+void queue_pop(void)
+{
+	struct fcb_entry loc;
+
+	if ((queue_cursor.fe_sector != NULL) &&
+	    (queue_cursor.fe_sector != queue_next.fe_sector)) {
+		/* All messages of the oldest sector are sent. */
+		(void)fcb_rotate(&queue_fcb);
+	}
+
+	queue_cursor = queue_next;
+
+	if (queue_next_get(&loc) != 0) {
+		/* All messages are sent. */
+		(void)fcb_clear(&queue_fcb);
+		queue_cursor.fe_sector = NULL;
+	}
+}
@@ -15,6 +15,39 @@
  * @brief MQTT Received data handling.
  */
 
+#if defined(CONFIG_MQTT_LIB_PAYLOAD_CODEC)
+/**@brief Applies the payload codec of the client to a received message.
+ *
+ * @param[in] client Identifies the client that received the message.
+ * @param[inout] param Received message. The payload is left as received if
+ *                     the codec fails.
+ *
+ * @retval 0 or an error code indicating reason for failure.
+ */
+static int payload_decode(struct mqtt_client *client,
+			  struct mqtt_publish_param *param)
+{
+	const struct mqtt_payload_codec *codec = client->payload_codec;
+	struct mqtt_binstr payload = param->message.payload;
+	int err_code;
+
+	if ((codec == NULL) || (codec->decode == NULL)) {
+		return 0;
+	}
+
+	err_code = codec->decode(codec->ctx, &param->message.topic,
+				 &param->message.payload, &payload);
+	if (err_code != 0) {
+		MQTT_TRC("Payload decoding failed: %d", err_code);
+		return err_code;
+	}
+
+	param->message.payload = payload;
+
+	return 0;
+}
+#endif /* CONFIG_MQTT_LIB_PAYLOAD_CODEC */
+
 static int mqtt_handle_packet(struct mqtt_client *client, u8_t *data,
 			      u32_t datalen, u32_t offset)
 {
@@ -43,6 +76,13 @@ static int mqtt_handle_packet(struct mqtt_client *client, u8_t *data,
 				MQTT_SET_STATE(client, MQTT_STATE_CONNECTED);
 			}
 
+#if defined(CONFIG_MQTT_LIB_PROTOCOL_V5)
+			client->topic_alias_max =
+					evt.param.connack.topic_alias_max;
+			client->keepalive_interval =
+					evt.param.connack.server_keep_alive;
+#endif
+
 			evt.result = evt.param.connack.return_code;
 		} else {
 			evt.result = err_code;
@@ -54,10 +94,23 @@ static int mqtt_handle_packet(struct mqtt_client *client, u8_t *data,
 		MQTT_TRC("[CID %p]: Received MQTT_PKT_TYPE_PUBLISH", client);
 
 		evt.type = MQTT_EVT_PUBLISH;
-		err_code = publish_decode(data, datalen, offset,
+		err_code = publish_decode(client, data, datalen, offset,
 					  &evt.param.publish);
 		evt.result = err_code;
 
+#if defined(CONFIG_MQTT_LIB_PAYLOAD_CODEC)
+		if (err_code == 0) {
+			/* The packet is valid, so the connection is kept. */
+			evt.result = payload_decode(client, &evt.param.publish);
+		}
+#endif
+
+#if defined(CONFIG_MQTT_LIB_PUBLISH_STREAMING)
+		/* Payload is read by the application from the transport. */
+		evt.param.publish.message.payload.len =
+						client->rx_payload_remaining;
+#endif
+
 		MQTT_TRC("PUB QoS:%02x, message len %08x, topic len %08x",
 			 evt.param.publish.message.topic.qos,
 			 evt.param.publish.message.payload.len,
@@ -105,8 +158,8 @@ static int mqtt_handle_packet(struct mqtt_client *client, u8_t *data,
 		MQTT_TRC("[CID %p]: Received MQTT_PKT_TYPE_SUBACK!", client);
 
 		evt.type = MQTT_EVT_SUBACK;
-		err_code = subscribe_ack_decode(data, datalen, offset,
-						&evt.param.suback);
+		err_code = subscribe_ack_decode(client, data, datalen,
+						offset, &evt.param.suback);
 		evt.result = err_code;
 		break;
 
@@ -114,14 +167,16 @@ static int mqtt_handle_packet(struct mqtt_client *client, u8_t *data,
 		MQTT_TRC("[CID %p]: Received MQTT_PKT_TYPE_UNSUBACK!", client);
 
 		evt.type = MQTT_EVT_UNSUBACK;
-		err_code = unsubscribe_ack_decode(data, datalen, offset,
-						  &evt.param.unsuback);
+		err_code = unsubscribe_ack_decode(client, data, datalen,
+						  offset, &evt.param.unsuback);
 		evt.result = err_code;
 		break;
 
 	case MQTT_PKT_TYPE_PINGRSP:
 		MQTT_TRC("[CID %p]: Received MQTT_PKT_TYPE_PINGRSP!", client);
 
+		client->ping_pending = 0;
+
 		/* No notification of Ping response to application. */
 		notify_event = false;
 		break;
@@ -133,12 +188,109 @@ static int mqtt_handle_packet(struct mqtt_client *client, u8_t *data,
 	}
 
 	if (notify_event == true) {
+#if defined(CONFIG_MQTT_LIB_INFLIGHT)
+		if (err_code == 0) {
+			inflight_event_handle(client, &evt);
+		}
+#endif
 		event_notify(client, &evt, MQTT_EVT_FLAG_NONE);
 	}
 
 	return err_code;
 }
 
+int frame_length_decode(const struct mqtt_client *client, u8_t *data,
+			u32_t datalen, u32_t *offset, u32_t *frame_length,
+			u32_t *packet_length)
+{
+	u32_t remaining_length = 0;
+	int err_code;
+
+	*offset = 1; /* Skip first byte to offset MQTT packet length. */
+	*frame_length = MQTT_FIXED_HEADER_SIZE;
+
+	if (datalen < MQTT_FIXED_HEADER_SIZE) {
+		return -EAGAIN;
+	}
+
+	err_code = packet_length_decode(data, datalen, &remaining_length,
+					offset);
+	if ((err_code != 0) && (datalen < MQTT_FIXED_HEADER_EXTENDED_SIZE)) {
+		/* Remaining length continues in the next byte. */
+		*frame_length = datalen + 1;
+		return -EAGAIN;
+	}
+
+	if ((err_code != 0) || (*offset > MQTT_FIXED_HEADER_EXTENDED_SIZE)) {
+		return -EINVAL;
+	}
+
+	*packet_length = *offset + remaining_length;
+	*frame_length = *packet_length;
+
+#if defined(CONFIG_MQTT_LIB_PUBLISH_STREAMING)
+	if ((data[0] & 0xF0) == MQTT_PKT_TYPE_PUBLISH) {
+		/* The frame ends with the topic and the message id. */
+		u32_t header_length = *offset + sizeof(u16_t);
+
+		if (header_length > *packet_length) {
+			return -EINVAL;
+		}
+
+		if (datalen < header_length) {
+			*frame_length = header_length;
+			return -EAGAIN;
+		}
+
+		header_length += (data[*offset] << 8) | data[*offset + 1];
+
+		if (data[0] & MQTT_HEADER_QOS_MASK) {
+			header_length += sizeof(u16_t);
+		}
+
+		if (header_length > *packet_length) {
+			return -EINVAL;
+		}
+
+#if defined(CONFIG_MQTT_LIB_PROTOCOL_V5)
+		if (client->protocol_version == MQTT_VERSION_5_0) {
+			/* Properties are part of the header too. */
+			u32_t properties_offset = header_length;
+			u32_t properties_len;
+
+			if (datalen <= header_length) {
+				*frame_length = header_length + 1;
+				return -EAGAIN;
+			}
+
+			err_code = packet_length_decode(data, datalen,
+							&properties_len,
+							&properties_offset);
+			if (err_code != 0) {
+				if (datalen - header_length >=
+				    MQTT_FIXED_HEADER_EXTENDED_SIZE - 1) {
+					return -EINVAL;
+				}
+
+				*frame_length = datalen + 1;
+				return -EAGAIN;
+			}
+
+			header_length = properties_offset + properties_len;
+
+			if (header_length > *packet_length) {
+				return -EINVAL;
+			}
+		}
+#endif
+
+		*frame_length = header_length;
+	}
+#endif
+
+	return 0;
+}
+
 u32_t mqtt_handle_rx_data(struct mqtt_client *client, u8_t *data, u32_t datalen)
 {
 	int err_code = 0;
@@ -146,36 +298,46 @@ u32_t mqtt_handle_rx_data(struct mqtt_client *client, u8_t *data, u32_t datalen)
 
 	while (offset < datalen) {
 		u32_t start = offset;
-		u32_t remaining_length = 0;
-
-		offset = 1; /* Skip first byte to offset MQTT packet length. */
-		err_code = packet_length_decode(data + start, datalen - start,
-						&remaining_length, &offset);
-		if (err_code != 0) {
+		u32_t frame_length = 0;
+		u32_t packet_length = 0;
+
+		err_code = frame_length_decode(client, data + start,
+					       datalen - start, &offset,
+					       &frame_length, &packet_length);
+		if (err_code == -EAGAIN) {
+			/* Wait for the rest of the fixed header. */
+			return start;
+		} else if (err_code != 0) {
 			return datalen;
 		}
 
-		u32_t packet_length = offset + remaining_length;
-
-		if (packet_length > MQTT_MAX_PACKET_LENGTH) {
+		if (frame_length > client->rx_buf_size) {
 			/* We receiving data we cannot handle. */
 			return packet_length;
 		}
 
-		if (start + packet_length > datalen) {
+		if (start + frame_length > datalen) {
 			/* We may want to save this packet for later use.
 			 * This means we received a truncated packet.
 			 */
 			return start;
 		}
 
+		/* Non-zero only for PUBLISH packets in streaming mode. */
+		client->rx_payload_remaining = packet_length - frame_length;
+
 		err_code = mqtt_handle_packet(client, data + start,
-					      packet_length, offset);
+					      frame_length, offset);
 		if (err_code != 0) {
 			return packet_length;
 		}
 
-		offset = start + packet_length;
+		offset = start + frame_length;
+
+		if (client->rx_payload_remaining > 0) {
+			/* Rest of the payload is still on the transport. */
+			return offset;
+		}
 	}
 
 	return datalen;
@@ -0,0 +1,405 @@
+/*
+ * Copyright (c) 2018 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+/** @file mqtt_topic_trie.c
+ *
+ * @brief Trie of topic filters dispatching received publish messages.
+ *
+ * @details Each node holds one level of a filter and links to its first child
+ *          and its next sibling. Filters sharing leading levels share the
+ *          nodes of these levels. A topic is matched level by level, and a
+ *          + node continues the match with the next level of the topic, so
+ *          the topic is read once for each matching branch of the trie.
+ */
+
+#include <string.h>
+#include <errno.h>
+#include <net/mqtt_socket.h>
+
+#define TOPIC_LEVEL_SEPARATOR '/'
+#define TOPIC_WILDCARD_SINGLE '+'
+#define TOPIC_WILDCARD_MULTI '#'
+#define TOPIC_SYSTEM_PREFIX '$'
+
+/**@brief Finds the length of the first level of a topic or filter.
+ *
+ * @param[in] str Topic or filter.
+ * @param[in] len Length of the topic or filter.
+ * @param[out] last Set if the level is the last one.
+ *
+ * @retval Length of the level, without the separator.
+ */
+static u32_t level_len_get(const u8_t *str, u32_t len, bool *last)
+{
+	const u8_t *sep = memchr(str, TOPIC_LEVEL_SEPARATOR, len);
+
+	*last = (sep == NULL);
+
+	return (sep == NULL) ? len : (u32_t)(sep - str);
+}
+
+static bool level_is(const struct mqtt_topic_node *node, u8_t wildcard)
+{
+	return (node->level_len == 1) && (node->level[0] == wildcard);
+}
+
+static bool level_equals(const struct mqtt_topic_node *node,
+			 const u8_t *level, u32_t len)
+{
+	return (node->level_len == len) &&
+	       (memcmp(node->level, level, len) == 0);
+}
+
+/**@brief Checks that wildcards occupy a whole level and that # is the last
+ *        level of the filter.
+ */
+static bool filter_validate(const struct mqtt_utf8 *filter)
+{
+	const u8_t *str = filter->utf8;
+	u32_t len = filter->size;
+	bool last = false;
+
+	if ((str == NULL) || (len == 0)) {
+		return false;
+	}
+
+	while (!last) {
+		u32_t level_len = level_len_get(str, len, &last);
+
+		for (u32_t i = 0; i < level_len; i++) {
+			if ((str[i] != TOPIC_WILDCARD_SINGLE) &&
+			    (str[i] != TOPIC_WILDCARD_MULTI)) {
+				continue;
+			}
+
+			if (level_len != 1) {
+				return false;
+			}
+
+			if ((str[i] == TOPIC_WILDCARD_MULTI) && !last) {
+				return false;
+			}
+		}
+
+		if (!last) {
+			str += level_len + 1;
+			len -= level_len + 1;
+		}
+	}
+
+	return true;
+}
+
+static struct mqtt_topic_node *sibling_find(struct mqtt_topic_node *node,
+					    const u8_t *level, u32_t len)
+{
+	while ((node != NULL) && !level_equals(node, level, len)) {
+		node = node->sibling;
+	}
+
+	return node;
+}
+
+static struct mqtt_topic_node *node_alloc(struct mqtt_topic_trie *trie)
+{
+	for (u32_t i = 0; i < trie->node_count; i++) {
+		if (trie->nodes[i].level == NULL) {
+			return &trie->nodes[i];
+		}
+	}
+
+	return NULL;
+}
+
+static u32_t node_free_count(const struct mqtt_topic_trie *trie)
+{
+	u32_t count = 0;
+
+	for (u32_t i = 0; i < trie->node_count; i++) {
+		if (trie->nodes[i].level == NULL) {
+			count++;
+		}
+	}
+
+	return count;
+}
+
+/**@brief Counts the nodes to allocate to add a filter. */
+static u32_t filter_missing_count(const struct mqtt_topic_trie *trie,
+				  const struct mqtt_utf8 *filter)
+{
+	struct mqtt_topic_node *node = trie->root;
+	const u8_t *str = filter->utf8;
+	u32_t len = filter->size;
+	u32_t missing = 0;
+	bool last = false;
+
+	while (!last) {
+		u32_t level_len = level_len_get(str, len, &last);
+
+		if (missing == 0) {
+			node = sibling_find(node, str, level_len);
+		}
+
+		if (node == NULL) {
+			missing++;
+		} else {
+			node = node->child;
+		}
+
+		if (!last) {
+			str += level_len + 1;
+			len -= level_len + 1;
+		}
+	}
+
+	return missing;
+}
+
+/**@brief Finds a node ending a filter in the subtree of a node. Every node of
+ *        the trie has one, as nodes are freed when their subtree holds no
+ *        filter anymore.
+ */
+static const struct mqtt_topic_node *subtree_filter_find(
+				const struct mqtt_topic_node *node)
+{
+	if (node->handler != NULL) {
+		return node;
+	}
+
+	for (node = node->child; node != NULL; node = node->sibling) {
+		const struct mqtt_topic_node *found = subtree_filter_find(node);
+
+		if (found != NULL) {
+			return found;
+		}
+	}
+
+	return NULL;
+}
+
+/**@brief Removes a filter from the subtree linked by link.
+ *
+ * @details Nodes left without filter in their subtree are freed. Remaining
+ *          nodes pointing into the removed filter are moved to another
+ *          filter of their subtree, which has the same leading levels, so
+ *          that the removed filter can be released by the application.
+ *
+ * @param[inout] link Link to the first node of the level.
+ * @param[in] str Remaining levels of the filter.
+ * @param[in] len Length of the remaining levels.
+ * @param[out] removed Filter as registered with @ref mqtt_topic_trie_add.
+ *
+ * @retval 0 or -ENOENT if the filter is not registered.
+ */
+static int filter_remove(struct mqtt_topic_node **link,
+			 const u8_t *str, u32_t len,
+			 struct mqtt_utf8 *removed)
+{
+	struct mqtt_topic_node *node;
+	bool last;
+	u32_t level_len = level_len_get(str, len, &last);
+
+	while ((*link != NULL) && !level_equals(*link, str, level_len)) {
+		link = &(*link)->sibling;
+	}
+
+	node = *link;
+	if (node == NULL) {
+		return -ENOENT;
+	}
+
+	if (last) {
+		if (node->handler == NULL) {
+			return -ENOENT;
+		}
+
+		*removed = node->filter;
+
+		node->handler = NULL;
+		node->user_data = NULL;
+		node->filter.utf8 = NULL;
+		node->filter.size = 0;
+	} else {
+		int err_code = filter_remove(&node->child, str + level_len + 1,
+					     len - level_len - 1, removed);
+
+		if (err_code != 0) {
+			return err_code;
+		}
+	}
+
+	if ((node->handler == NULL) && (node->child == NULL)) {
+		*link = node->sibling;
+		memset(node, 0, sizeof(*node));
+	} else if ((node->level >= removed->utf8) &&
+		   (node->level < removed->utf8 + removed->size)) {
+		const struct mqtt_topic_node *other = subtree_filter_find(node);
+
+		node->level = other->filter.utf8 +
+			      (node->level - removed->utf8);
+	}
+
+	return 0;
+}
+
+/**@brief Calls the handler of a node, if any. */
+static int handler_call(const struct mqtt_topic_node *node,
+			struct mqtt_client *client,
+			const struct mqtt_publish_param *param)
+{
+	if (node->handler == NULL) {
+		return 0;
+	}
+
+	node->handler(client, param, node->user_data);
+
+	return 1;
+}
+
+/**@brief Matches the remaining levels of a topic against the nodes of a
+ *        level of the trie.
+ *
+ * @param[in] node First node of the level.
+ * @param[in] str Remaining levels of the topic.
+ * @param[in] len Length of the remaining levels.
+ * @param[in] first Set if str is the first level of the topic.
+ *
+ * @retval Number of handlers called.
+ */
+static int topic_match(const struct mqtt_topic_node *node,
+		       const u8_t *str, u32_t len, bool first,
+		       struct mqtt_client *client,
+		       const struct mqtt_publish_param *param)
+{
+	bool last;
+	u32_t level_len = level_len_get(str, len, &last);
+	bool system = first && (len > 0) && (str[0] == TOPIC_SYSTEM_PREFIX);
+	int count = 0;
+
+	for (; node != NULL; node = node->sibling) {
+		if (level_is(node, TOPIC_WILDCARD_MULTI)) {
+			if (!system) {
+				count += handler_call(node, client, param);
+			}
+			continue;
+		}
+
+		if (level_is(node, TOPIC_WILDCARD_SINGLE)) {
+			if (system) {
+				continue;
+			}
+		} else if (!level_equals(node, str, level_len)) {
+			continue;
+		}
+
+		if (!last) {
+			count += topic_match(node->child, str + level_len + 1,
+					     len - level_len - 1, false,
+					     client, param);
+			continue;
+		}
+
+		count += handler_call(node, client, param);
+
+		/* A filter ending with # also matches its parent level. */
+		for (const struct mqtt_topic_node *child = node->child;
+		     child != NULL; child = child->sibling) {
+			if (level_is(child, TOPIC_WILDCARD_MULTI)) {
+				count += handler_call(child, client, param);
+				break;
+			}
+		}
+	}
+
+	return count;
+}
+
+void mqtt_topic_trie_init(struct mqtt_topic_trie *trie,
+			  struct mqtt_topic_node *nodes, u32_t node_count)
+{
+	memset(nodes, 0, node_count * sizeof(*nodes));
+
+	trie->nodes = nodes;
+	trie->node_count = node_count;
+	trie->root = NULL;
+}
+
+int mqtt_topic_trie_add(struct mqtt_topic_trie *trie,
+			const struct mqtt_utf8 *filter,
+			mqtt_topic_handler_t handler, void *user_data)
+{
+	struct mqtt_topic_node **link = &trie->root;
+	struct mqtt_topic_node *node = NULL;
+	const u8_t *str = filter->utf8;
+	u32_t len = filter->size;
+	bool last = false;
+
+	if ((handler == NULL) || !filter_validate(filter)) {
+		return -EINVAL;
+	}
+
+	if (filter_missing_count(trie, filter) > node_free_count(trie)) {
+		return -ENOMEM;
+	}
+
+	while (!last) {
+		u32_t level_len = level_len_get(str, len, &last);
+
+		node = sibling_find(*link, str, level_len);
+		if (node == NULL) {
+			node = node_alloc(trie);
+			node->level = str;
+			node->level_len = level_len;
+			node->sibling = *link;
+			*link = node;
+		}
+
+		link = &node->child;
+
+		if (!last) {
+			str += level_len + 1;
+			len -= level_len + 1;
+		}
+	}
+
+	if (node->handler != NULL) {
+		return -EEXIST;
+	}
+
+	node->filter = *filter;
+	node->handler = handler;
+	node->user_data = user_data;
+
+	return 0;
+}
+
+int mqtt_topic_trie_remove(struct mqtt_topic_trie *trie,
+			   const struct mqtt_utf8 *filter)
+{
+	struct mqtt_utf8 removed;
+
+	if ((filter->utf8 == NULL) || (filter->size == 0)) {
+		return -ENOENT;
+	}
+
+	return filter_remove(&trie->root, filter->utf8, filter->size,
+			     &removed);
+}
+
+int mqtt_topic_trie_dispatch(const struct mqtt_topic_trie *trie,
+			     struct mqtt_client *client,
+			     const struct mqtt_publish_param *param)
+{
+	const struct mqtt_utf8 *topic = &param->message.topic.topic;
+
+	if (topic->utf8 == NULL) {
+		return 0;
+	}
+
+	return topic_match(trie->root, topic->utf8, topic->size, true,
+			   client, param);
+}
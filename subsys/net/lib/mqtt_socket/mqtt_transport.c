@@ -12,44 +12,66 @@
 #include "mqtt_transport.h"
 
 /* Transport handler functions for TCP socket transport. */
-extern int mqtt_client_tcp_connect(struct mqtt_client *client);
+extern int mqtt_client_tcp_connect(struct mqtt_client *client,
+				   bool shall_block);
+extern int mqtt_client_tcp_connect_continue(struct mqtt_client *client);
 extern int mqtt_client_tcp_write(struct mqtt_client *client, const u8_t *data,
 				 u32_t datalen);
+extern int mqtt_client_tcp_write_msg(struct mqtt_client *client,
+				     struct msghdr *message);
 extern int mqtt_client_tcp_read(struct mqtt_client *client, u8_t *data,
-				u32_t *datalen);
+				u32_t *datalen, bool shall_block);
 extern int mqtt_client_tcp_disconnect(struct mqtt_client *client);
+extern int mqtt_client_tcp_socket(struct mqtt_client *client);
 
 #if defined(CONFIG_MQTT_LIB_TLS)
 /* Transport handler functions for TLS socket transport. */
-extern int mqtt_client_tls_connect(struct mqtt_client *client);
+extern int mqtt_client_tls_connect(struct mqtt_client *client,
+				   bool shall_block);
+extern int mqtt_client_tls_connect_continue(struct mqtt_client *client);
 extern int mqtt_client_tls_write(struct mqtt_client *client, const u8_t *data,
 				 u32_t datalen);
+extern int mqtt_client_tls_write_msg(struct mqtt_client *client,
+				     struct msghdr *message);
 extern int mqtt_client_tls_read(struct mqtt_client *client, u8_t *data,
-				u32_t *datalen);
+				u32_t *datalen, bool shall_block);
 extern int mqtt_client_tls_disconnect(struct mqtt_client *client);
+extern int mqtt_client_tls_socket(struct mqtt_client *client);
 #endif /* CONFIG_MQTT_LIB_TLS */
 
 /**@brief Function pointer array for TCP/TLS transport handlers. */
 const struct transport_procedure transport_fn[MQTT_TRANSPORT_NUM] = {
 	{
 		mqtt_client_tcp_connect,
+		mqtt_client_tcp_connect_continue,
 		mqtt_client_tcp_write,
+		mqtt_client_tcp_write_msg,
 		mqtt_client_tcp_read,
 		mqtt_client_tcp_disconnect,
+		mqtt_client_tcp_socket,
 	},
 #if defined(CONFIG_MQTT_LIB_TLS)
 	{
 		mqtt_client_tls_connect,
+		mqtt_client_tls_connect_continue,
 		mqtt_client_tls_write,
+		mqtt_client_tls_write_msg,
 		mqtt_client_tls_read,
 		mqtt_client_tls_disconnect,
+		mqtt_client_tls_socket,
 	}
 #endif /* CONFIG_MQTT_LIB_TLS */
 };
 
-int mqtt_transport_connect(struct mqtt_client *client)
+int mqtt_transport_connect(struct mqtt_client *client, bool shall_block)
 {
-	return transport_fn[client->transport.type].connect(client);
+	return transport_fn[client->transport.type].connect(client,
+							    shall_block);
+}
+
+int mqtt_transport_connect_continue(struct mqtt_client *client)
+{
+	return transport_fn[client->transport.type].connect_continue(client);
 }
 
 int mqtt_transport_write(struct mqtt_client *client, const u8_t *data,
@@ -59,12 +81,25 @@ int mqtt_transport_write(struct mqtt_client *client, const u8_t *data,
 							  datalen);
 }
 
-int mqtt_transport_read(struct mqtt_client *client, u8_t *data, u32_t *datalen)
+int mqtt_transport_write_msg(struct mqtt_client *client,
+			     struct msghdr *message)
 {
-	return transport_fn[client->transport.type].read(client, data, datalen);
+	return transport_fn[client->transport.type].write_msg(client, message);
+}
+
+int mqtt_transport_read(struct mqtt_client *client, u8_t *data, u32_t *datalen,
+			bool shall_block)
+{
+	return transport_fn[client->transport.type].read(client, data, datalen,
+							 shall_block);
 }
 
 int mqtt_transport_disconnect(struct mqtt_client *client)
 {
 	return transport_fn[client->transport.type].disconnect(client);
 }
+
+int mqtt_transport_socket(struct mqtt_client *client)
+{
+	return transport_fn[client->transport.type].socket(client);
+}
@@ -12,26 +12,45 @@
 #ifndef MQTT_TRANSPORT_H_
 #define MQTT_TRANSPORT_H_
 
+#include <errno.h>
+#include <stdbool.h>
 #include <net/mqtt_socket.h>
+#include <net/socket.h>
+
+#if !defined(CONFIG_NET_SOCKETS_OFFLOAD)
+#include <fcntl.h>
+#endif
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 /**@brief Transport for handling transport connect procedure. */
-typedef int (*transport_connect_handler_t)(struct mqtt_client *client);
+typedef int (*transport_connect_handler_t)(struct mqtt_client *client,
+					   bool shall_block);
+
+/**@brief Transport handler advancing a nonblocking connect procedure. */
+typedef int (*transport_connect_continue_handler_t)(
+					struct mqtt_client *client);
 
 /**@brief Transport write handler. */
 typedef int (*transport_write_handler_t)(struct mqtt_client *client,
 					 const u8_t *data, u32_t datalen);
 
+/**@brief Transport write message handler, similar to POSIX sendmsg. */
+typedef int (*transport_write_msg_handler_t)(struct mqtt_client *client,
+					     struct msghdr *message);
+
 /**@brief Transport read handler. */
 typedef int (*transport_read_handler_t)(struct mqtt_client *client, u8_t *data,
-					u32_t *datalen);
+					u32_t *datalen, bool shall_block);
 
 /**@brief Transport disconnect handler. */
 typedef int (*transport_disconnect_handler_t)(struct mqtt_client *client);
 
+/**@brief Transport socket handler. */
+typedef int (*transport_socket_handler_t)(struct mqtt_client *client);
+
 /**@brief Transport procedure handlers. */
 struct transport_procedure {
 	/** Transport connect handler. Handles TCP connection callback based on
@@ -39,11 +58,21 @@ struct transport_procedure {
 	 */
 	transport_connect_handler_t connect;
 
+	/** Transport connect continue handler. Advances a nonblocking
+	 *  connection based on type of transport.
+	 */
+	transport_connect_continue_handler_t connect_continue;
+
 	/** Transport write handler. Handles transport write based on type of
 	 *  transport.
 	 */
 	transport_write_handler_t write;
 
+	/** Transport write message handler. Handles transport write of
+	 *  scattered data based on type of transport.
+	 */
+	transport_write_msg_handler_t write_msg;
+
 	/** Transport read handler. Handles transport read based on type of
 	 *  transport.
 	 */
@@ -53,15 +82,36 @@ struct transport_procedure {
 	 *  on type of transport.
 	 */
 	transport_disconnect_handler_t disconnect;
+
+	/** Transport socket handler. Provides the socket to poll based on
+	 *  type of transport.
+	 */
+	transport_socket_handler_t socket;
 };
 
 /**@brief Handles TCP Connection Complete for configured transport.
  *
  * @param[in] client Identifies the client on which the procedure is requested.
+ * @param[in] shall_block If false, return -EINPROGRESS instead of waiting
+ *                        for the connection to be established. The
+ *                        connection is then completed with
+ *                        @ref mqtt_transport_connect_continue.
  *
  * @retval 0 or an error code indicating reason for failure.
  */
-int mqtt_transport_connect(struct mqtt_client *client);
+int mqtt_transport_connect(struct mqtt_client *client, bool shall_block);
+
+/**@brief Advances a nonblocking connection on configured transport. Once the
+ *        connection is established, the transport is blocking again.
+ *
+ * @param[in] client Identifies the client on which the procedure is requested.
+ *
+ * @retval 0 if the connection is established.
+ * @retval -EINPROGRESS if the connection is still in progress.
+ * @retval Other error code if the connection failed. The transport is then
+ *         closed.
+ */
+int mqtt_transport_connect_continue(struct mqtt_client *client);
 
 /**@brief Handles write requests on configured transport.
  *
@@ -74,16 +124,30 @@ int mqtt_transport_connect(struct mqtt_client *client);
 int mqtt_transport_write(struct mqtt_client *client, const u8_t *data,
 			 u32_t datalen);
 
+/**@brief Handles write message requests on configured transport.
+ *
+ * @param[in] client Identifies the client on which the procedure is requested.
+ * @param[inout] message Message to be written on the transport. The I/O
+ *                       vectors of the message are consumed by the
+ *                       procedure.
+ *
+ * @retval 0 or an error code indicating reason for failure.
+ */
+int mqtt_transport_write_msg(struct mqtt_client *client,
+			     struct msghdr *message);
+
 /**@brief Handles read requests on configured transport.
  *
  * @param[in] client Identifies the client on which the procedure is requested.
  * @param[in] data Pointer where read data is to be fetched.
  * @param[inout] datalen Size of memory provided for the operation as input,
  *                       received data length as output.
+ * @param[in] shall_block If true, wait until data is available.
  *
  * @retval 0 or an error code indicating reason for failure.
  */
-int mqtt_transport_read(struct mqtt_client *client, u8_t *data, u32_t *datalen);
+int mqtt_transport_read(struct mqtt_client *client, u8_t *data, u32_t *datalen,
+			bool shall_block);
 
 /**@brief Handles transport disconnection requests on configured transport.
  *
@@ -93,6 +157,41 @@ int mqtt_transport_read(struct mqtt_client *client, u8_t *data, u32_t *datalen);
  */
 int mqtt_transport_disconnect(struct mqtt_client *client);
 
+/**@brief Gets the socket of the configured transport, to poll it for
+ *        incoming data.
+ *
+ * @param[in] client Identifies the client on which the procedure is requested.
+ *
+ * @retval Socket descriptor.
+ */
+int mqtt_transport_socket(struct mqtt_client *client);
+
+/**@brief Sets a transport socket to nonblocking or blocking mode.
+ *
+ * @param[in] sock Socket descriptor.
+ * @param[in] nonblock If true, the socket is set to nonblocking mode.
+ *
+ * @retval 0 if the procedure is successful.
+ * @retval -1 with errno set otherwise. Offloaded sockets have no fcntl, so
+ *         they can only be used in blocking mode and errno is set to
+ *         ENOTSUP.
+ */
+static inline int mqtt_sock_nonblock_set(int sock, bool nonblock)
+{
+#if defined(CONFIG_NET_SOCKETS_OFFLOAD)
+	ARG_UNUSED(sock);
+
+	if (nonblock) {
+		errno = ENOTSUP;
+		return -1;
+	}
+
+	return 0;
+#else
+	return fcntl(sock, F_SETFL, nonblock ? O_NONBLOCK : 0);
+#endif
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -16,15 +16,18 @@
 #include <net/socket.h>
 #include <net/mqtt_socket.h>
 
+#include "mqtt_transport.h"
 #include "mqtt_os.h"
 
 /**@brief Handles connect request for TCP socket transport.
  *
  * @param[in] client Identifies the client on which the procedure is requested.
+ * @param[in] shall_block If false, return -EINPROGRESS instead of waiting
+ *                        for the connection to be established.
  *
  * @retval 0 or an error code indicating reason for failure.
  */
-int mqtt_client_tcp_connect(struct mqtt_client *client)
+int mqtt_client_tcp_connect(struct mqtt_client *client, bool shall_block)
 {
 	const struct sockaddr *broker = client->broker;
 	int ret;
@@ -37,6 +40,13 @@ int mqtt_client_tcp_connect(struct mqtt_client *client)
 
 	MQTT_TRC("Created socket %d", client->transport.tcp.sock);
 
+	if (!shall_block) {
+		ret = mqtt_sock_nonblock_set(client->transport.tcp.sock, true);
+		if (ret < 0) {
+			goto error;
+		}
+	}
+
 	size_t peer_addr_size = sizeof(struct sockaddr_in6);
 
 	if (broker->sa_family == AF_INET) {
@@ -45,13 +55,71 @@ int mqtt_client_tcp_connect(struct mqtt_client *client)
 
 	ret = connect(client->transport.tcp.sock, client->broker,
 		      peer_addr_size);
+	if ((ret < 0) && !shall_block && (errno == EINPROGRESS)) {
+		MQTT_TRC("Connect in progress");
+		return -EINPROGRESS;
+	}
+
 	if (ret < 0) {
-		(void)close(client->transport.tcp.sock);
-		return -errno;
+		goto error;
+	}
+
+	if (!shall_block) {
+		ret = mqtt_sock_nonblock_set(client->transport.tcp.sock, false);
+		if (ret < 0) {
+			goto error;
+		}
+	}
+
+	MQTT_TRC("Connect completed");
+	return 0;
+
+error:
+	(void)close(client->transport.tcp.sock);
+	return -errno;
+}
+
+/**@brief Advances a nonblocking connect request on TCP socket transport.
+ *
+ * @param[in] client Identifies the client on which the procedure is requested.
+ *
+ * @retval 0 if the connection is established, -EINPROGRESS if it is still in
+ *         progress, or an error code indicating reason for failure.
+ */
+int mqtt_client_tcp_connect_continue(struct mqtt_client *client)
+{
+	const struct sockaddr *broker = client->broker;
+	int ret;
+
+	size_t peer_addr_size = sizeof(struct sockaddr_in6);
+
+	if (broker->sa_family == AF_INET) {
+		peer_addr_size = sizeof(struct sockaddr_in);
+	}
+
+	/* Connecting again reports the state of the pending connection. */
+	ret = connect(client->transport.tcp.sock, client->broker,
+		      peer_addr_size);
+	if ((ret < 0) && (errno != EISCONN)) {
+		if ((errno == EALREADY) || (errno == EINPROGRESS)) {
+			return -EINPROGRESS;
+		}
+
+		goto error;
+	}
+
+	/* The other transport procedures block. */
+	ret = mqtt_sock_nonblock_set(client->transport.tcp.sock, false);
+	if (ret < 0) {
+		goto error;
 	}
 
 	MQTT_TRC("Connect completed");
 	return 0;
+
+error:
+	(void)close(client->transport.tcp.sock);
+	return -errno;
 }
 
 /**@brief Handles write requests on TCP socket transport.
@@ -81,20 +149,94 @@ int mqtt_client_tcp_write(struct mqtt_client *client, const u8_t *data,
 	return 0;
 }
 
+/**@brief Handles write message requests on TCP socket transport.
+ *
+ * @param[in] client Identifies the client on which the procedure is requested.
+ * @param[inout] message Message to be written on the transport. The I/O
+ *                       vectors are advanced past the data sent.
+ *
+ * @retval 0 or an error code indicating reason for failure.
+ */
+#if defined(CONFIG_NET_SOCKETS_OFFLOAD)
+int mqtt_client_tcp_write_msg(struct mqtt_client *client,
+			      struct msghdr *message)
+{
+	int ret;
+
+	/* Offloaded sockets do not provide sendmsg(), so the I/O vectors are
+	 * sent one after the other.
+	 */
+	while (message->msg_iovlen > 0) {
+		ret = mqtt_client_tcp_write(client, message->msg_iov->iov_base,
+					    message->msg_iov->iov_len);
+		if (ret < 0) {
+			return ret;
+		}
+
+		message->msg_iov++;
+		message->msg_iovlen--;
+	}
+
+	return 0;
+}
+#else
+int mqtt_client_tcp_write_msg(struct mqtt_client *client,
+			      struct msghdr *message)
+{
+	size_t remaining = 0;
+	size_t sent;
+	int ret;
+
+	for (size_t i = 0; i < message->msg_iovlen; i++) {
+		remaining += message->msg_iov[i].iov_len;
+	}
+
+	while (remaining > 0) {
+		ret = sendmsg(client->transport.tcp.sock, message, 0);
+		if (ret < 0) {
+			return -errno;
+		}
+
+		remaining -= ret;
+		sent = ret;
+
+		/* Skip the data sent before the next attempt. */
+		while (sent > 0 && message->msg_iovlen > 0) {
+			struct iovec *vec = message->msg_iov;
+
+			if (sent < vec->iov_len) {
+				vec->iov_base = (u8_t *)vec->iov_base + sent;
+				vec->iov_len -= sent;
+				break;
+			}
+
+			sent -= vec->iov_len;
+			message->msg_iov++;
+			message->msg_iovlen--;
+		}
+	}
+
+	return 0;
+}
+#endif /* CONFIG_NET_SOCKETS_OFFLOAD */
+
 /**@brief Handles read requests on TCP socket transport.
  *
  * @param[in] client Identifies the client on which the procedure is requested.
  * @param[in] data Pointer where read data is to be fetched.
  * @param[inout] datalen Size of memory provided for the operation,
  *                       received data length as output.
+ * @param[in] shall_block If true, wait until data is available.
  *
  * @retval 0 or an error code indicating reason for failure.
  */
-int mqtt_client_tcp_read(struct mqtt_client *client, u8_t *data, u32_t *datalen)
+int mqtt_client_tcp_read(struct mqtt_client *client, u8_t *data, u32_t *datalen,
+			 bool shall_block)
 {
+	int flags = shall_block ? 0 : MSG_DONTWAIT;
 	int ret;
 
-	ret = recv(client->transport.tcp.sock, data, *datalen, MSG_DONTWAIT);
+	ret = recv(client->transport.tcp.sock, data, *datalen, flags);
 	if (ret < 0) {
 		return -errno;
 	}
@@ -122,3 +264,14 @@ int mqtt_client_tcp_disconnect(struct mqtt_client *client)
 
 	return 0;
 }
+
+/**@brief Gets the socket of the TCP socket transport.
+ *
+ * @param[in] client Identifies the client on which the procedure is requested.
+ *
+ * @retval Socket descriptor.
+ */
+int mqtt_client_tcp_socket(struct mqtt_client *client)
+{
+	return client->transport.tcp.sock;
+}
@@ -84,8 +84,15 @@ static char shadow_get_topic[NCT_SHADOW_GET_LEN + 1];
 #define NCT_CC_SUBSCRIBE_ID 1234
 #define NCT_DC_SUBSCRIBE_ID 8765
 
-#define NCT_RX_LIST 0
-#define NCT_TX_LIST 1
+/* Nodes of the control channel topics in the topic trie: the 6 levels of
+ * the accepted topic, the last level of the rejected topic and the 2 last
+ * levels of the update delta topic, which share the other levels.
+ */
+#define NCT_CC_TOPIC_NODE_COUNT (6 + 1 + 2)
+
+/* The data channel topic shares no levels with the control channel. */
+#define NCT_TOPIC_NODE_COUNT \
+	(NCT_CC_TOPIC_NODE_COUNT + CONFIG_NRF_CLOUD_DC_TOPIC_LEVELS_MAX)
 
 /* Forward declaration of the event handler registered with MQTT. */
 static void nct_mqtt_evt_handler(struct mqtt_client *client,
@@ -99,6 +106,19 @@ static struct nct {
 	struct mqtt_utf8 dc_tx_endp;
 	struct mqtt_utf8 dc_rx_endp;
 	u32_t message_id;
+	u8_t rx_buf[CONFIG_NRF_CLOUD_MQTT_BUFFER_SIZE];
+	u8_t tx_buf[CONFIG_NRF_CLOUD_MQTT_BUFFER_SIZE];
+	struct mqtt_topic_trie topics;
+	struct mqtt_topic_node topic_nodes[NCT_TOPIC_NODE_COUNT];
+#if defined(CONFIG_NRF_CLOUD_PERSISTENT_SESSIONS)
+	/* Subscriptions stored in the session on the broker. */
+	bool session_present;
+	bool cc_subscribed;
+	struct mqtt_utf8 dc_subscribed;
+	/* Subscriptions resumed from the session, notified by nct_process. */
+	bool cc_resumed;
+	bool dc_resumed;
+#endif /* defined(CONFIG_NRF_CLOUD_PERSISTENT_SESSIONS) */
 } nct;
 
 static const struct mqtt_topic nct_cc_rx_list[] = {
@@ -174,6 +194,7 @@ static u32_t dc_get_next_message_id(void)
 static void dc_endpoint_free(void)
 {
 	if (nct.dc_rx_endp.utf8 != NULL) {
+		(void)mqtt_topic_trie_remove(&nct.topics, &nct.dc_rx_endp);
 		nrf_cloud_free(nct.dc_rx_endp.utf8);
 	}
 	if (nct.dc_tx_endp.utf8 != NULL) {
@@ -182,6 +203,65 @@ static void dc_endpoint_free(void)
 	dc_endpoint_reset();
 }
 
+#if defined(CONFIG_NRF_CLOUD_PERSISTENT_SESSIONS)
+/* Remember the data channel topic subscribed in the session. */
+static void dc_subscribed_set(const struct mqtt_utf8 *topic)
+{
+	if (nct.dc_subscribed.utf8 != NULL) {
+		nrf_cloud_free(nct.dc_subscribed.utf8);
+	}
+
+	nct.dc_subscribed.utf8 = NULL;
+	nct.dc_subscribed.size = 0;
+
+	if ((topic == NULL) || (topic->utf8 == NULL)) {
+		return;
+	}
+
+	nct.dc_subscribed.utf8 = nrf_cloud_malloc(topic->size);
+	if (nct.dc_subscribed.utf8 == NULL) {
+		/* Subscribe again on the next connection. */
+		return;
+	}
+
+	memcpy(nct.dc_subscribed.utf8, topic->utf8, topic->size);
+	nct.dc_subscribed.size = topic->size;
+}
+
+/* Check if the data channel topic is subscribed in the session. */
+static bool dc_subscribed_match(const struct mqtt_utf8 *topic)
+{
+	return nct.session_present &&
+	       (nct.dc_subscribed.utf8 != NULL) &&
+	       (nct.dc_subscribed.size == topic->size) &&
+	       (memcmp(nct.dc_subscribed.utf8, topic->utf8,
+		       topic->size) == 0);
+}
+
+/* Notify subscriptions resumed from the session, as if acknowledged. */
+static void resumed_notify(void)
+{
+	struct nct_evt evt = {
+		.status = 0
+	};
+	int err = 0;
+
+	if (nct.cc_resumed) {
+		nct.cc_resumed = false;
+		evt.type = NCT_EVT_CC_CONNECTED;
+		err = nct_input(&evt);
+	} else if (nct.dc_resumed) {
+		nct.dc_resumed = false;
+		evt.type = NCT_EVT_DC_CONNECTED;
+		err = nct_input(&evt);
+	}
+
+	if (err != 0) {
+		LOG_ERR("nct_input: failed %d", err);
+	}
+}
+#endif /* defined(CONFIG_NRF_CLOUD_PERSISTENT_SESSIONS) */
+
 static u32_t dc_send(const struct nct_dc_data *dc_data, u8_t qos)
 {
 	if (dc_data == NULL) {
@@ -209,41 +289,66 @@ static u32_t dc_send(const struct nct_dc_data *dc_data, u8_t qos)
 	return mqtt_publish(&nct.client, &publish);
 }
 
-static bool strings_compare(const char *s1, const char *s2,
-			    u32_t s1_len, u32_t s2_len)
+/* Notify data received on a control channel topic. */
+static void cc_rx_handler(struct mqtt_client *client,
+			  const struct mqtt_publish_param *p,
+			  void *user_data)
 {
-	return (strncmp(s1, s2, min(s1_len, s2_len))) ? false : true;
+	struct nct_cc_data cc = {
+		.data.ptr = p->message.payload.data,
+		.data.len = p->message.payload.len,
+		.id = p->message_id,
+		.opcode = *(const u32_t *)user_data
+	};
+	struct nct_evt evt = {
+		.type = NCT_EVT_CC_RX_DATA,
+		.param.cc = &cc
+	};
+	int err = nct_input(&evt);
+
+	if (err != 0) {
+		LOG_ERR("nct_input: failed %d", err);
+	}
 }
 
-/* Verify if the topic is a control channel topic or not. */
-static bool control_channel_topic_match(u32_t list_id,
-					const struct mqtt_topic *topic,
-					enum nct_cc_opcode *opcode)
+/* Notify data received on the data channel topic. */
+static void dc_rx_handler(struct mqtt_client *client,
+			  const struct mqtt_publish_param *p,
+			  void *user_data)
 {
-	struct mqtt_topic *topic_list;
-	u32_t list_size;
-
-	if (list_id == NCT_RX_LIST) {
-		topic_list = (struct mqtt_topic *)nct_cc_rx_list;
-		list_size = ARRAY_SIZE(nct_cc_rx_list);
-	} else if (list_id == NCT_TX_LIST) {
-		topic_list = (struct mqtt_topic *)nct_cc_tx_list;
-		list_size = ARRAY_SIZE(nct_cc_tx_list);
-	} else {
-		return false;
+	struct nct_dc_data dc = {
+		.data.ptr = p->message.payload.data,
+		.data.len = p->message.payload.len,
+		.id = p->message_id
+	};
+	struct nct_evt evt = {
+		.type = NCT_EVT_DC_RX_DATA,
+		.param.dc = &dc
+	};
+	int err = nct_input(&evt);
+
+	if (err != 0) {
+		LOG_ERR("nct_input: failed %d", err);
 	}
+}
+
+/* Register the control channel topics for dispatching received data. */
+static int cc_topics_register(void)
+{
+	mqtt_topic_trie_init(&nct.topics, nct.topic_nodes,
+			     ARRAY_SIZE(nct.topic_nodes));
 
-	for (u32_t index = 0; index < list_size; index++) {
-		if (!strings_compare(
-			    topic->topic.utf8,
-			    topic_list[index].topic.utf8,
-			    topic->topic.size,
-			    topic_list[index].topic.size)) {
-			*opcode = nct_cc_rx_opcode_map[index];
-			return true;
+	for (u32_t index = 0; index < ARRAY_SIZE(nct_cc_rx_list); index++) {
+		int err = mqtt_topic_trie_add(
+			&nct.topics, &nct_cc_rx_list[index].topic,
+			cc_rx_handler, (void *)&nct_cc_rx_opcode_map[index]);
+
+		if (err != 0) {
+			return err;
 		}
 	}
-	return false;
+
+	return 0;
 }
 
 /* Function to get the client id */
@@ -344,6 +449,9 @@ static int nct_provision(void)
 	nct.tls_config.sec_tag_count = ARRAY_SIZE(sec_tag_list);
 	nct.tls_config.seg_tag_list = sec_tag_list;
 	nct.tls_config.hostname = NRF_CLOUD_HOSTNAME;
+#if defined(CONFIG_NRF_CLOUD_PERSISTENT_SESSIONS) && defined(TLS_SESSION_CACHE)
+	nct.tls_config.session_cache = TLS_SESSION_CACHE_ENABLED;
+#endif
 
 #if defined(CONFIG_NRF_CLOUD_PROVISION_CERTIFICATES)
 	{
@@ -398,13 +506,16 @@ static int nct_provision(void)
 /* Connect to MQTT broker. */
 int nct_mqtt_connect(void)
 {
-	mqtt_client_init(&nct.client);
+	mqtt_client_init(&nct.client, nct.rx_buf, sizeof(nct.rx_buf),
+			 nct.tx_buf, sizeof(nct.tx_buf));
 
 	nct.client.broker = (struct sockaddr *)&nct.broker;
 	nct.client.evt_cb = nct_mqtt_evt_handler;
 	nct.client.client_id.utf8 = (u8_t *)client_id_buf;
 	nct.client.client_id.size = strlen(client_id_buf);
 	nct.client.protocol_version = MQTT_VERSION_3_1_1;
+	nct.client.clean_session =
+		!IS_ENABLED(CONFIG_NRF_CLOUD_PERSISTENT_SESSIONS);
 	nct.client.password = NULL;
 	nct.client.user_name = NULL;
 	nct.client.transport.type = MQTT_TRANSPORT_SECURE;
@@ -423,13 +534,22 @@ static void nct_mqtt_evt_handler(struct mqtt_client *const mqtt_client,
 	struct nct_evt evt = {
 		.status = _mqtt_evt->result
 	};
-	struct nct_cc_data cc;
 	bool event_notify = false;
 
 	switch (_mqtt_evt->type) {
 	case MQTT_EVT_CONNACK: {
 		LOG_DBG("MQTT_EVT_CONNACK");
 
+#if defined(CONFIG_NRF_CLOUD_PERSISTENT_SESSIONS)
+		nct.session_present = (_mqtt_evt->result == 0) &&
+			_mqtt_evt->param.connack.session_present_flag;
+		if (!nct.session_present) {
+			/* The broker has forgotten the subscriptions. */
+			nct.cc_subscribed = false;
+			dc_subscribed_set(NULL);
+		}
+#endif /* defined(CONFIG_NRF_CLOUD_PERSISTENT_SESSIONS) */
+
 		evt.type = NCT_EVT_CONNECTED;
 		event_notify = true;
 		break;
@@ -441,21 +561,11 @@ static void nct_mqtt_evt_handler(struct mqtt_client *const mqtt_client,
 			p->message_id,
 			p->message.payload.len);
 
-		/* If the data arrives on one of the subscribed control channel
-		 * topic. Then we notify the same.
+		/* Notify data arriving on one of the subscribed control
+		 * channel or data channel topics.
 		 */
-		if (control_channel_topic_match(
-			NCT_RX_LIST, &p->message.topic, &cc.opcode)) {
-
-			cc.id = p->message_id;
-			cc.data.ptr = p->message.payload.data;
-			cc.data.len = p->message.payload.len;
-
-			evt.type = NCT_EVT_CC_RX_DATA;
-			evt.param.cc = &cc;
-			event_notify = true;
-		} else {
-			/* Try to match it with one of the data topics. */
+		if (mqtt_topic_trie_dispatch(&nct.topics, mqtt_client, p) == 0) {
+			LOG_DBG("No handler for the topic");
 		}
 
 		if (p->message.topic.qos == MQTT_QOS_1_AT_LEAST_ONCE) {
@@ -474,10 +584,18 @@ static void nct_mqtt_evt_handler(struct mqtt_client *const mqtt_client,
 			_mqtt_evt->result);
 
 		if (_mqtt_evt->param.suback.message_id == NCT_CC_SUBSCRIBE_ID) {
+#if defined(CONFIG_NRF_CLOUD_PERSISTENT_SESSIONS)
+			nct.cc_subscribed = (_mqtt_evt->result == 0);
+#endif
 			evt.type = NCT_EVT_CC_CONNECTED;
 			event_notify = true;
 		}
 		if (_mqtt_evt->param.suback.message_id == NCT_DC_SUBSCRIBE_ID) {
+#if defined(CONFIG_NRF_CLOUD_PERSISTENT_SESSIONS)
+			if (_mqtt_evt->result == 0) {
+				dc_subscribed_set(&nct.dc_rx_endp);
+			}
+#endif
 			evt.type = NCT_EVT_DC_CONNECTED;
 			event_notify = true;
 		}
@@ -505,6 +623,11 @@ static void nct_mqtt_evt_handler(struct mqtt_client *const mqtt_client,
 	case MQTT_EVT_DISCONNECT: {
 		LOG_DBG("MQTT_EVT_DISCONNECT: result=%d", _mqtt_evt->result);
 
+#if defined(CONFIG_NRF_CLOUD_PERSISTENT_SESSIONS)
+		nct.cc_resumed = false;
+		nct.dc_resumed = false;
+#endif
+
 		evt.type = NCT_EVT_DISCONNECTED;
 		event_notify = true;
 		break;
@@ -533,6 +656,11 @@ int nct_init(void)
 		return err;
 	}
 
+	err = cc_topics_register();
+	if (err) {
+		return err;
+	}
+
 	err = nct_provision();
 	if (err) {
 		return err;
@@ -618,6 +746,14 @@ int nct_cc_connect(void)
 		.message_id = NCT_CC_SUBSCRIBE_ID
 	};
 
+#if defined(CONFIG_NRF_CLOUD_PERSISTENT_SESSIONS)
+	if (nct.session_present && nct.cc_subscribed) {
+		LOG_DBG("Control channel subscriptions resumed");
+		nct.cc_resumed = true;
+		return 0;
+	}
+#endif
+
 	return mqtt_subscribe(&nct.client, &subscription_list);
 }
 
@@ -672,6 +808,10 @@ int nct_cc_disconnect(void)
 		.message_id = NCT_CC_SUBSCRIBE_ID
 	};
 
+#if defined(CONFIG_NRF_CLOUD_PERSISTENT_SESSIONS)
+	nct.cc_subscribed = false;
+#endif
+
 	return mqtt_unsubscribe(&nct.client, &subscription_list);
 }
 
@@ -722,6 +862,25 @@ int nct_dc_connect(void)
 		.message_id = NCT_DC_SUBSCRIBE_ID
 	};
 
+	/* Received data would be dropped without the topic in the trie. The
+	 * topic stays registered until the endpoint is freed.
+	 */
+	int err = mqtt_topic_trie_add(&nct.topics, &nct.dc_rx_endp,
+				      dc_rx_handler, NULL);
+
+	if ((err != 0) && (err != -EEXIST)) {
+		LOG_ERR("Data channel topic not registered %d", err);
+		return err;
+	}
+
+#if defined(CONFIG_NRF_CLOUD_PERSISTENT_SESSIONS)
+	if (dc_subscribed_match(&subscribe_topic.topic)) {
+		LOG_DBG("Data channel subscription resumed");
+		nct.dc_resumed = true;
+		return 0;
+	}
+#endif
+
 	return mqtt_subscribe(&nct.client, &subscription_list);
 }
 
@@ -745,6 +904,10 @@ int nct_dc_disconnect(void)
 		.message_id = NCT_DC_SUBSCRIBE_ID
 	};
 
+#if defined(CONFIG_NRF_CLOUD_PERSISTENT_SESSIONS)
+	dc_subscribed_set(NULL);
+#endif
+
 	return mqtt_unsubscribe(&nct.client, &subscription_list);
 }
 
@@ -760,4 +923,8 @@ void nct_process(void)
 {
 	mqtt_input(&nct.client);
 	mqtt_live();
+
+#if defined(CONFIG_NRF_CLOUD_PERSISTENT_SESSIONS)
+	resumed_notify();
+#endif
 }
@@ -24,6 +24,22 @@ enum nordic_command {
 	NORDIC_COMMAND_INFO	= 3
 };
 
+/* Event type ID reserved for timestamp epoch records. The record carries
+ * the full 64-bit timestamp (low word first, in the same position as the
+ * timestamp of regular events), so the host can place every following
+ * 32-bit event timestamp without guessing the number of counter wraps.
+ */
+#define PROFILER_NORDIC_EPOCH_ID	UCHAR_MAX
+
+#define PROFILER_NORDIC_EPOCH_PERIOD \
+	(((u64_t)CONFIG_PROFILER_NORDIC_EPOCH_PERIOD_MS * \
+	  CONFIG_SYS_CLOCK_HW_CYCLES_PER_SEC) / MSEC_PER_SEC)
+
+static u32_t timestamp_hi;
+static u32_t timestamp_last_lo;
+static u64_t epoch_last_sent;
+static bool epoch_pending;
+
 static char descr[CONFIG_MAX_NUMBER_OF_CUSTOM_EVENTS]
 		 [CONFIG_MAX_LENGTH_OF_CUSTOM_EVENTS_DESCRIPTIONS];
 static char *arg_types_encodings[] = {	"u8",  /* u8_t */
@@ -47,6 +63,39 @@ static k_tid_t protocol_thread_id;
 static K_THREAD_STACK_DEFINE(profiler_nordic_stack, 128);
 static struct k_thread profiler_nordic_thread;
 
+static u64_t timestamp_get(void)
+{
+	unsigned int key = irq_lock();
+	u32_t lo = k_cycle_get_32();
+
+	if (lo < timestamp_last_lo) {
+		timestamp_hi++;
+	}
+	timestamp_last_lo = lo;
+
+	u64_t timestamp = ((u64_t)timestamp_hi << 32) | lo;
+
+	irq_unlock(key);
+
+	return timestamp;
+}
+
+static void send_epoch(u64_t timestamp)
+{
+	u8_t record[sizeof(u8_t) + sizeof(timestamp)];
+
+	record[0] = PROFILER_NORDIC_EPOCH_ID;
+	sys_put_le64(timestamp, &record[1]);
+
+	u8_t num_bytes_send = SEGGER_RTT_Write(
+			CONFIG_PROFILER_NORDIC_RTT_CHANNEL_DATA,
+			record, sizeof(record));
+	__ASSERT_NO_MSG(num_bytes_send > 0);
+
+	epoch_last_sent = timestamp;
+	epoch_pending = false;
+}
+
 static void send_system_description(void)
 {
 	size_t num_bytes_send;
@@ -85,6 +134,7 @@ static void profiler_nordic_thread_fn(void)
 			command = (enum nordic_command)read_data;
 			switch (command) {
 			case NORDIC_COMMAND_START:
+				epoch_pending = true;
 				sending_events = true;
 				break;
 			case NORDIC_COMMAND_STOP:
@@ -98,6 +148,10 @@ static void profiler_nordic_thread_fn(void)
 				break;
 			}
 		}
+		/* Keep the 64-bit timestamp base up to date, also when no
+		 * events are logged.
+		 */
+		timestamp_get();
 		k_sleep(500);
 	}
 	k_sem_give(&profiler_sem);
@@ -106,6 +160,7 @@ static void profiler_nordic_thread_fn(void)
 int profiler_init(void)
 {
 	protocol_running = true;
+	epoch_pending = true;
 	if (IS_ENABLED(CONFIG_PROFILER_NORDIC_START_LOGGING_ON_SYSTEM_START)) {
 		sending_events = true;
 	}
@@ -199,7 +254,7 @@ void profiler_log_start(struct log_event_buf *buf)
 	/* Adding one to pointer to make space for event type ID */
 	__ASSERT_NO_MSG(sizeof(u8_t) <= CONFIG_PROFILER_CUSTOM_EVENT_BUF_LEN);
 	buf->payload = buf->payload_start + sizeof(u8_t);
-	profiler_log_encode_u32(buf, k_cycle_get_32());
+	profiler_log_encode_u32(buf, (u32_t)timestamp_get());
 }
 
 void profiler_log_encode_u32(struct log_event_buf *buf, u32_t data)
@@ -218,15 +273,28 @@ void profiler_log_add_mem_address(struct log_event_buf *buf,
 
 void profiler_log_send(struct log_event_buf *buf, u16_t event_type_id)
 {
-	__ASSERT_NO_MSG(event_type_id <= UCHAR_MAX);
+	__ASSERT_NO_MSG(event_type_id < PROFILER_NORDIC_EPOCH_ID);
 	if (sending_events) {
 		u8_t type_id = event_type_id & UCHAR_MAX;
 
 		buf->payload_start[0] = type_id;
+
+		/* Lock to make sure that epoch record precedes the event
+		 * it was sent for.
+		 */
+		unsigned int key = irq_lock();
+		u64_t now = timestamp_get();
+
+		if (epoch_pending ||
+		    (now - epoch_last_sent >= PROFILER_NORDIC_EPOCH_PERIOD)) {
+			send_epoch(now);
+		}
+
 		u8_t num_bytes_send = SEGGER_RTT_Write(
 				CONFIG_PROFILER_NORDIC_RTT_CHANNEL_DATA,
 				buf->payload_start,
 				buf->payload - buf->payload_start);
 		__ASSERT_NO_MSG(num_bytes_send > 0);
+		irq_unlock(key);
 	}
 }
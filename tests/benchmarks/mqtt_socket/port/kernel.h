@@ -0,0 +1,54 @@
+/*
+ * Copyright (c) 2018 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+/**
+ * @file
+ * @brief Kernel services used by the MQTT library, on top of POSIX threads
+ *        and clocks.
+ */
+
+#ifndef KERNEL_H_
+#define KERNEL_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <zephyr/types.h>
+
+#define K_NO_WAIT 0
+#define K_FOREVER (-1)
+
+#define ARRAY_SIZE(array) (sizeof(array) / sizeof((array)[0]))
+#define ARG_UNUSED(x) (void)(x)
+#define ROUND_UP(x, align) ((((x) + ((align) - 1)) / (align)) * (align))
+
+#ifndef min
+#define min(a, b) (((a) < (b)) ? (a) : (b))
+#endif
+
+#ifndef max
+#define max(a, b) (((a) > (b)) ? (a) : (b))
+#endif
+
+#define __packed __attribute__((__packed__))
+#define __aligned(x) __attribute__((__aligned__(x)))
+
+/** @brief Recursive mutex, as Zephyr mutexes. */
+struct k_mutex {
+	pthread_mutex_t mutex;
+};
+
+void k_mutex_init(struct k_mutex *mutex);
+int k_mutex_lock(struct k_mutex *mutex, s32_t timeout);
+void k_mutex_unlock(struct k_mutex *mutex);
+
+/** @brief Time since the first call, in milliseconds. */
+s64_t k_uptime_get(void);
+u32_t k_uptime_get_32(void);
+
+#endif /* KERNEL_H_ */
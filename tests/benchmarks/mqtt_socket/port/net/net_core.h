@@ -0,0 +1,16 @@
+/*
+ * Copyright (c) 2018 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#ifndef NET_CORE_H_
+#define NET_CORE_H_
+
+/* Logging would distort the measurements, so it is compiled out. */
+#define NET_DBG(...) do { } while (0)
+#define NET_INFO(...) do { } while (0)
+#define NET_WARN(...) do { } while (0)
+#define NET_ERR(...) do { } while (0)
+
+#endif /* NET_CORE_H_ */
@@ -0,0 +1,26 @@
+/*
+ * Copyright (c) 2018 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+/**
+ * @file
+ * @brief BSD sockets of the host, as used by the MQTT library with
+ *        CONFIG_NET_SOCKETS_POSIX_NAMES.
+ */
+
+#ifndef NET_SOCKET_H_
+#define NET_SOCKET_H_
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <poll.h>
+#include <unistd.h>
+
+#endif /* NET_SOCKET_H_ */
@@ -0,0 +1,13 @@
+/*
+ * Copyright (c) 2018 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#ifndef NET_TLS_CREDENTIALS_H_
+#define NET_TLS_CREDENTIALS_H_
+
+/* TLS is not supported by the host sockets, only the type is needed. */
+typedef int sec_tag_t;
+
+#endif /* NET_TLS_CREDENTIALS_H_ */
@@ -0,0 +1,58 @@
+/*
+ * Copyright (c) 2018 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#include <time.h>
+#include <kernel.h>
+
+void k_mutex_init(struct k_mutex *mutex)
+{
+	pthread_mutexattr_t attr;
+
+	pthread_mutexattr_init(&attr);
+	pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+	pthread_mutex_init(&mutex->mutex, &attr);
+	pthread_mutexattr_destroy(&attr);
+}
+
+int k_mutex_lock(struct k_mutex *mutex, s32_t timeout)
+{
+	if (timeout == K_NO_WAIT) {
+		return (pthread_mutex_trylock(&mutex->mutex) == 0) ? 0 : -EBUSY;
+	}
+
+	/* The benchmark is single threaded, so no other timeout is used. */
+	return -pthread_mutex_lock(&mutex->mutex);
+}
+
+void k_mutex_unlock(struct k_mutex *mutex)
+{
+	pthread_mutex_unlock(&mutex->mutex);
+}
+
+static s64_t uptime_ms(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (s64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+s64_t k_uptime_get(void)
+{
+	static s64_t start;
+
+	if (start == 0) {
+		start = uptime_ms();
+	}
+
+	return uptime_ms() - start;
+}
+
+u32_t k_uptime_get_32(void)
+{
+	return (u32_t)k_uptime_get();
+}
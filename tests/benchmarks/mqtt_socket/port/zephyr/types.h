@@ -0,0 +1,22 @@
+/*
+ * Copyright (c) 2018 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#ifndef ZEPHYR_TYPES_H_
+#define ZEPHYR_TYPES_H_
+
+#include <stdint.h>
+
+typedef int8_t s8_t;
+typedef int16_t s16_t;
+typedef int32_t s32_t;
+typedef int64_t s64_t;
+
+typedef uint8_t u8_t;
+typedef uint16_t u16_t;
+typedef uint32_t u32_t;
+typedef uint64_t u64_t;
+
+#endif /* ZEPHYR_TYPES_H_ */
@@ -0,0 +1,624 @@
+/*
+ * Copyright (c) 2018 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+/** @file main.c
+ *
+ * @brief Host benchmark of the MQTT library against a local broker.
+ *
+ * @details The client subscribes to its own topic, so every message it
+ *          publishes comes back from the broker. Three measurements are made:
+ *          - Codec: cycles spent encoding and decoding publish messages,
+ *            without transport.
+ *          - Throughput: messages per second through the broker and back,
+ *            and cycles spent in the library, including the transport
+ *            system calls, per payload byte sent and received.
+ *          - Latency: time from publishing a message until it is received
+ *            back, at QoS 0, QoS 1 and QoS 2.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <getopt.h>
+#include <net/socket.h>
+#include <net/mqtt_socket.h>
+
+#include "mqtt_internal.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define CYCLES_UNIT "cycles"
+#else
+#define CYCLES_UNIT "ns"
+#endif
+
+#define BENCH_BUFFER_SIZE 8192
+#define BENCH_MAX_PAYLOAD 4096
+#define BENCH_SUBSCRIBE_ID 1
+
+/* Publish messages awaiting acknowledgment during the throughput test. */
+#define BENCH_QOS_WINDOW 32
+
+/* Time allowed for the broker to answer, in milliseconds. */
+#define BENCH_TIMEOUT 5000
+
+static const u32_t payload_sizes[] = { 16, 64, 256, 1024, BENCH_MAX_PAYLOAD };
+
+static struct {
+	struct mqtt_client client;
+	struct sockaddr_storage broker;
+	u8_t rx_buf[BENCH_BUFFER_SIZE];
+	u8_t tx_buf[BENCH_BUFFER_SIZE];
+	char client_id[32];
+	char topic[48];
+	bool connected;
+	bool subscribed;
+	int result;
+	u16_t message_id;
+	/* Messages received back from the broker. */
+	u32_t received;
+	/* Own messages acknowledged by the broker (QoS 1 and QoS 2). */
+	u32_t acknowledged;
+	/* Cycles spent in the library. */
+	u64_t cycles;
+} bench;
+
+static u8_t payload[BENCH_MAX_PAYLOAD];
+
+static inline u64_t cycles_get(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (u64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+#endif
+}
+
+static u64_t time_ns_get(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (u64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+static void evt_handler(struct mqtt_client *client,
+			const struct mqtt_evt *evt)
+{
+	switch (evt->type) {
+	case MQTT_EVT_CONNACK:
+		bench.result = evt->result;
+		bench.connected = (evt->result == 0);
+		break;
+
+	case MQTT_EVT_DISCONNECT:
+		bench.connected = false;
+		break;
+
+	case MQTT_EVT_SUBACK:
+		bench.subscribed = (evt->result == 0);
+		break;
+
+	case MQTT_EVT_PUBLISH: {
+		const struct mqtt_publish_param *p = &evt->param.publish;
+
+		if (p->message.topic.qos == MQTT_QOS_1_AT_LEAST_ONCE) {
+			const struct mqtt_puback_param ack = {
+				.message_id = p->message_id
+			};
+
+			mqtt_publish_qos1_ack(client, &ack);
+		} else if (p->message.topic.qos == MQTT_QOS_2_EXACTLY_ONCE) {
+			const struct mqtt_pubrec_param rec = {
+				.message_id = p->message_id
+			};
+
+			mqtt_publish_qos2_receive(client, &rec);
+		}
+
+		bench.received++;
+		break;
+	}
+
+	case MQTT_EVT_PUBACK:
+	case MQTT_EVT_PUBCOMP:
+		bench.acknowledged++;
+		break;
+
+	case MQTT_EVT_PUBREC: {
+		const struct mqtt_pubrel_param rel = {
+			.message_id = evt->param.pubrec.message_id
+		};
+
+		mqtt_publish_qos2_release(client, &rel);
+		break;
+	}
+
+	case MQTT_EVT_PUBREL: {
+		const struct mqtt_pubcomp_param comp = {
+			.message_id = evt->param.pubrel.message_id
+		};
+
+		mqtt_publish_qos2_complete(client, &comp);
+		break;
+	}
+
+	default:
+		break;
+	}
+}
+
+/**@brief Handles received packets, counting the cycles spent in the library.
+ *
+ * @retval 1 if packets were received, 0 if the timeout expired or an error
+ *         code indicating reason for failure.
+ */
+static int bench_input(s32_t timeout)
+{
+	u64_t start;
+	int ready;
+	int err;
+
+	ready = mqtt_wait(timeout);
+	if (ready < 0) {
+		return ready;
+	}
+
+	start = cycles_get();
+	err = (ready > 0) ? mqtt_input(&bench.client) : 0;
+	if (err >= 0) {
+		err = mqtt_live();
+	}
+	bench.cycles += cycles_get() - start;
+
+	return (err < 0) ? err : (ready > 0);
+}
+
+/* Handle received packets until a counter reaches a value. */
+static int bench_wait(const u32_t *counter, u32_t value)
+{
+	s64_t deadline = k_uptime_get() + BENCH_TIMEOUT;
+
+	while (*counter < value) {
+		s64_t remaining = deadline - k_uptime_get();
+		int err;
+
+		if (remaining <= 0) {
+			return -ETIMEDOUT;
+		}
+
+		err = bench_input(remaining);
+		if (err < 0) {
+			return err;
+		}
+	}
+
+	return 0;
+}
+
+static int bench_publish(u8_t qos, u32_t size)
+{
+	struct mqtt_publish_param param = {
+		.message.topic.qos = qos,
+		.message.topic.topic.utf8 = (u8_t *)bench.topic,
+		.message.topic.topic.size = strlen(bench.topic),
+		.message.payload.data = payload,
+		.message.payload.len = size,
+	};
+	u64_t start;
+	int err;
+
+	bench.message_id++;
+	if (bench.message_id == 0) {
+		bench.message_id++;
+	}
+
+	param.message_id = bench.message_id;
+
+	start = cycles_get();
+	err = mqtt_publish(&bench.client, &param);
+	bench.cycles += cycles_get() - start;
+
+	return err;
+}
+
+static int broker_resolve(const char *host, const char *port)
+{
+	struct addrinfo hints = {
+		.ai_family = AF_UNSPEC,
+		.ai_socktype = SOCK_STREAM
+	};
+	struct addrinfo *result;
+	int err;
+
+	err = getaddrinfo(host, port, &hints, &result);
+	if (err != 0) {
+		fprintf(stderr, "Cannot resolve %s: %s\n", host,
+			gai_strerror(err));
+		return -EHOSTUNREACH;
+	}
+
+	memcpy(&bench.broker, result->ai_addr, result->ai_addrlen);
+	freeaddrinfo(result);
+
+	return 0;
+}
+
+static void client_init(void)
+{
+	mqtt_client_init(&bench.client, bench.rx_buf, sizeof(bench.rx_buf),
+			 bench.tx_buf, sizeof(bench.tx_buf));
+
+	bench.client.broker = (struct sockaddr *)&bench.broker;
+	bench.client.evt_cb = evt_handler;
+	bench.client.client_id.utf8 = (u8_t *)bench.client_id;
+	bench.client.client_id.size = strlen(bench.client_id);
+	bench.client.protocol_version = MQTT_VERSION_3_1_1;
+	bench.client.clean_session = 1;
+	bench.client.transport.type = MQTT_TRANSPORT_NON_SECURE;
+}
+
+static int client_connect(bool nodelay)
+{
+	struct mqtt_topic topic = {
+		.topic.utf8 = (u8_t *)bench.topic,
+		.topic.size = strlen(bench.topic),
+		.qos = MQTT_QOS_2_EXACTLY_ONCE
+	};
+	const struct mqtt_subscription_list subscription = {
+		.list = &topic,
+		.list_count = 1,
+		.message_id = BENCH_SUBSCRIBE_ID
+	};
+	int err;
+
+	err = mqtt_connect(&bench.client);
+	if (err != 0) {
+		fprintf(stderr, "mqtt_connect failed: %d\n", err);
+		return err;
+	}
+
+	/* Small packets, such as acknowledgments, would otherwise wait for the
+	 * acknowledgment of the previous segment, which dominates latency.
+	 */
+	if (nodelay) {
+		int one = 1;
+
+		setsockopt(bench.client.transport.tcp.sock, IPPROTO_TCP,
+			   TCP_NODELAY, &one, sizeof(one));
+	}
+
+	while (!bench.connected) {
+		err = bench_input(BENCH_TIMEOUT);
+		if ((err <= 0) || (bench.result != 0)) {
+			fprintf(stderr, "No CONNACK: %d, result %d\n",
+				err, bench.result);
+			return -ECONNREFUSED;
+		}
+	}
+
+	/* The subscription has the highest QoS, so that messages come back
+	 * with the QoS they were published with.
+	 */
+	err = mqtt_subscribe(&bench.client, &subscription);
+	while ((err == 0) && !bench.subscribed) {
+		err = bench_input(BENCH_TIMEOUT);
+		if (err >= 0) {
+			err = (err > 0) ? 0 : -ETIMEDOUT;
+		}
+	}
+
+	if (err != 0) {
+		fprintf(stderr, "mqtt_subscribe failed: %d\n", err);
+	}
+
+	return err;
+}
+
+/* Encode and decode publish messages, without transport. */
+static int codec_run(u32_t count)
+{
+	static u8_t frame[BENCH_BUFFER_SIZE];
+	struct mqtt_publish_param param = {
+		.message.topic.qos = MQTT_QOS_1_AT_LEAST_ONCE,
+		.message.topic.topic.utf8 = (u8_t *)bench.topic,
+		.message.topic.topic.size = strlen(bench.topic),
+		.message.payload.data = payload,
+		.message_id = 1
+	};
+
+	printf("\nCodec, %u messages per size\n", count);
+	printf("%8s %16s %16s\n", "payload", "encode " CYCLES_UNIT "/B",
+	       "decode " CYCLES_UNIT "/B");
+
+	for (u32_t i = 0; i < ARRAY_SIZE(payload_sizes); i++) {
+		u32_t size = payload_sizes[i];
+		u64_t encode_cycles = 0;
+		u64_t decode_cycles = 0;
+
+		param.message.payload.len = size;
+
+		for (u32_t n = 0; n < count; n++) {
+			struct mqtt_publish_param decoded;
+			const u8_t *packet;
+			u32_t packet_length;
+			u32_t frame_length;
+			u32_t offset;
+			u64_t start;
+			int err;
+
+			start = cycles_get();
+			err = publish_encode(&bench.client, &param, 0, &packet,
+					     &packet_length);
+			encode_cycles += cycles_get() - start;
+			if (err != 0) {
+				return err;
+			}
+
+			/* The transport sends the payload after the header. */
+			memcpy(frame, packet, packet_length);
+			memcpy(frame + packet_length, payload, size);
+
+			start = cycles_get();
+			err = frame_length_decode(&bench.client, frame,
+						  packet_length + size,
+						  &offset, &frame_length,
+						  &packet_length);
+			if (err == 0) {
+				err = publish_decode(&bench.client, frame,
+						     packet_length, offset,
+						     &decoded);
+			}
+			decode_cycles += cycles_get() - start;
+			if (err != 0) {
+				return err;
+			}
+		}
+
+		printf("%8u %16.2f %16.2f\n", size,
+		       (double)encode_cycles / ((u64_t)count * size),
+		       (double)decode_cycles / ((u64_t)count * size));
+	}
+
+	return 0;
+}
+
+/* Publish messages as fast as the broker acknowledges them. */
+static int throughput_run(u8_t qos, u32_t size, u32_t count)
+{
+	u32_t received = bench.received;
+	u32_t acknowledged = bench.acknowledged;
+	u64_t start;
+	double elapsed;
+	int err = 0;
+
+	bench.cycles = 0;
+	start = time_ns_get();
+
+	for (u32_t n = 0; (n < count) && (err == 0); n++) {
+		if (qos != MQTT_QOS_0_AT_MOST_ONCE) {
+			u32_t pending = n - (bench.acknowledged - acknowledged);
+
+			if (pending >= BENCH_QOS_WINDOW) {
+				err = bench_wait(&bench.acknowledged,
+						 acknowledged + n -
+						 BENCH_QOS_WINDOW + 1);
+			}
+		}
+
+		if (err == 0) {
+			err = bench_publish(qos, size);
+		}
+
+		/* Read what has arrived, without waiting. */
+		if (err == 0) {
+			do {
+				err = bench_input(K_NO_WAIT);
+			} while (err > 0);
+		}
+	}
+
+	if (err == 0) {
+		err = bench_wait(&bench.received, received + count);
+	}
+
+	if ((err == 0) && (qos != MQTT_QOS_0_AT_MOST_ONCE)) {
+		err = bench_wait(&bench.acknowledged, acknowledged + count);
+	}
+
+	if (err != 0) {
+		fprintf(stderr, "QoS %u, %u bytes: failed %d after %u of %u "
+			"messages\n", qos, size, err,
+			bench.received - received, count);
+		return err;
+	}
+
+	elapsed = (time_ns_get() - start) / 1e9;
+
+	printf("%3u %8u %12.0f %12.2f %16.2f\n", qos, size,
+	       count / elapsed, count * (double)size / elapsed / 1e6,
+	       (double)bench.cycles / (2 * (u64_t)count * size));
+
+	return 0;
+}
+
+static int u64_compare(const void *a, const void *b)
+{
+	u64_t x = *(const u64_t *)a;
+	u64_t y = *(const u64_t *)b;
+
+	return (x > y) - (x < y);
+}
+
+/* Publish messages one at a time, until they are received back. */
+static int latency_run(u8_t qos, u32_t size, u32_t rounds)
+{
+	u64_t *samples = calloc(rounds, sizeof(*samples));
+	u64_t total = 0;
+	int err = 0;
+
+	if (samples == NULL) {
+		return -ENOMEM;
+	}
+
+	for (u32_t n = 0; (n < rounds) && (err == 0); n++) {
+		u32_t received = bench.received;
+		u32_t acknowledged = bench.acknowledged;
+		u64_t start = time_ns_get();
+
+		err = bench_publish(qos, size);
+		if (err == 0) {
+			err = bench_wait(&bench.received, received + 1);
+		}
+
+		samples[n] = time_ns_get() - start;
+		total += samples[n];
+
+		/* Complete the handshake before the next message. */
+		if ((err == 0) && (qos != MQTT_QOS_0_AT_MOST_ONCE)) {
+			err = bench_wait(&bench.acknowledged,
+					 acknowledged + 1);
+		}
+	}
+
+	if (err == 0) {
+		qsort(samples, rounds, sizeof(*samples), u64_compare);
+
+		printf("%3u %10.1f %10.1f %10.1f %10.1f %10.1f\n", qos,
+		       samples[0] / 1e3, (double)total / rounds / 1e3,
+		       samples[rounds / 2] / 1e3,
+		       samples[(u64_t)rounds * 99 / 100] / 1e3,
+		       samples[rounds - 1] / 1e3);
+	} else {
+		fprintf(stderr, "QoS %u latency failed: %d\n", qos, err);
+	}
+
+	free(samples);
+
+	return err;
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr,
+		"Usage: %s [-h host] [-p port] [-n messages] [-r rounds] "
+		"[-s size] [-D]\n"
+		"  -h  Broker host name or address (default localhost)\n"
+		"  -p  Broker port (default 1883)\n"
+		"  -n  Messages per throughput and codec test (default 10000)\n"
+		"  -r  Round trips per latency test (default 1000)\n"
+		"  -s  Payload size of the latency test (default 64)\n"
+		"  -D  Keep Nagle's algorithm enabled on the client socket\n",
+		name);
+}
+
+int main(int argc, char *argv[])
+{
+	const char *host = "localhost";
+	const char *port = "1883";
+	u32_t count = 10000;
+	u32_t rounds = 1000;
+	u32_t size = 64;
+	bool nodelay = true;
+	int opt;
+	int err;
+
+	while ((opt = getopt(argc, argv, "h:p:n:r:s:D")) != -1) {
+		switch (opt) {
+		case 'h':
+			host = optarg;
+			break;
+		case 'p':
+			port = optarg;
+			break;
+		case 'n':
+			count = strtoul(optarg, NULL, 0);
+			break;
+		case 'r':
+			rounds = strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			size = strtoul(optarg, NULL, 0);
+			break;
+		case 'D':
+			nodelay = false;
+			break;
+		default:
+			usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if ((count == 0) || (rounds == 0) || (size > BENCH_MAX_PAYLOAD)) {
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	for (u32_t i = 0; i < sizeof(payload); i++) {
+		payload[i] = (u8_t)i;
+	}
+
+	snprintf(bench.client_id, sizeof(bench.client_id), "mqtt_bench_%d",
+		 (int)getpid());
+	snprintf(bench.topic, sizeof(bench.topic), "mqtt_bench/%d",
+		 (int)getpid());
+
+	err = mqtt_init();
+	if (err == 0) {
+		err = broker_resolve(host, port);
+	}
+
+	if (err != 0) {
+		return EXIT_FAILURE;
+	}
+
+	client_init();
+
+	err = codec_run(count);
+	if (err != 0) {
+		fprintf(stderr, "Codec test failed: %d\n", err);
+		return EXIT_FAILURE;
+	}
+
+	err = client_connect(nodelay);
+	if (err != 0) {
+		return EXIT_FAILURE;
+	}
+
+	printf("\nThroughput, %u messages per size\n", count);
+	printf("%3s %8s %12s %12s %16s\n", "QoS", "payload", "messages/s",
+	       "MB/s", CYCLES_UNIT "/B");
+
+	for (u8_t qos = 0; (qos <= MQTT_QOS_2_EXACTLY_ONCE) && (err == 0);
+	     qos++) {
+		for (u32_t i = 0; (i < ARRAY_SIZE(payload_sizes)) && (err == 0);
+		     i++) {
+			err = throughput_run(qos, payload_sizes[i], count);
+		}
+	}
+
+	if (err == 0) {
+		printf("\nLatency, %u round trips of %u bytes, in us\n",
+		       rounds, size);
+		printf("%3s %10s %10s %10s %10s %10s\n", "QoS", "min", "avg",
+		       "p50", "p99", "max");
+	}
+
+	for (u8_t qos = 0; (qos <= MQTT_QOS_2_EXACTLY_ONCE) && (err == 0);
+	     qos++) {
+		err = latency_run(qos, size, rounds);
+	}
+
+	mqtt_disconnect(&bench.client);
+
+	return (err == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
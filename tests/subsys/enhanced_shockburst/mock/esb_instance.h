@@ -0,0 +1,191 @@
+/*
+ * Copyright (c) 2018 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#ifndef ESB_INSTANCE_H_
+#define ESB_INSTANCE_H_
+
+/**
+ * @file
+ * @defgroup esb_instance ESB module instances
+ * @{
+ * @brief Several ESB modules in one host test.
+ *
+ * The ESB module keeps its state in static variables. To simulate a PTX and
+ * a PRX in the same test, nrf_esb.c and nrf_esb_frag.c are compiled once for
+ * each simulated device, by wrapper files that define RADIO_MOCK_NODE and
+ * ESB_INSTANCE before including this file. The public functions of each
+ * copy are prefixed with ESB_INSTANCE and collected in a
+ * @ref esb_instance structure, and the interrupt handlers are registered
+ * with the simulator instead of the interrupt controller.
+ */
+
+#ifdef ESB_INSTANCE
+
+#include <irq.h>
+#include "radio_mock.h"
+
+#define ESB_INSTANCE_NAME_(prefix, name) prefix##_##name
+#define ESB_INSTANCE_NAME(prefix, name) ESB_INSTANCE_NAME_(prefix, name)
+
+#define nrf_esb_init ESB_INSTANCE_NAME(ESB_INSTANCE, nrf_esb_init)
+#define nrf_esb_suspend ESB_INSTANCE_NAME(ESB_INSTANCE, nrf_esb_suspend)
+#define nrf_esb_disable ESB_INSTANCE_NAME(ESB_INSTANCE, nrf_esb_disable)
+#define nrf_esb_is_idle ESB_INSTANCE_NAME(ESB_INSTANCE, nrf_esb_is_idle)
+#define nrf_esb_write_payload \
+	ESB_INSTANCE_NAME(ESB_INSTANCE, nrf_esb_write_payload)
+#define nrf_esb_write_payload_nocopy \
+	ESB_INSTANCE_NAME(ESB_INSTANCE, nrf_esb_write_payload_nocopy)
+#define nrf_esb_write_ack_payload \
+	ESB_INSTANCE_NAME(ESB_INSTANCE, nrf_esb_write_ack_payload)
+#define nrf_esb_flush_ack_payloads \
+	ESB_INSTANCE_NAME(ESB_INSTANCE, nrf_esb_flush_ack_payloads)
+#define nrf_esb_read_rx_payload \
+	ESB_INSTANCE_NAME(ESB_INSTANCE, nrf_esb_read_rx_payload)
+#define nrf_esb_read_rx_payloads \
+	ESB_INSTANCE_NAME(ESB_INSTANCE, nrf_esb_read_rx_payloads)
+#define nrf_esb_start_tx ESB_INSTANCE_NAME(ESB_INSTANCE, nrf_esb_start_tx)
+#define nrf_esb_start_rx ESB_INSTANCE_NAME(ESB_INSTANCE, nrf_esb_start_rx)
+#define nrf_esb_stop_rx ESB_INSTANCE_NAME(ESB_INSTANCE, nrf_esb_stop_rx)
+#define nrf_esb_flush_tx ESB_INSTANCE_NAME(ESB_INSTANCE, nrf_esb_flush_tx)
+#define nrf_esb_pop_tx ESB_INSTANCE_NAME(ESB_INSTANCE, nrf_esb_pop_tx)
+#define nrf_esb_flush_rx ESB_INSTANCE_NAME(ESB_INSTANCE, nrf_esb_flush_rx)
+#define nrf_esb_set_address_length \
+	ESB_INSTANCE_NAME(ESB_INSTANCE, nrf_esb_set_address_length)
+#define nrf_esb_set_base_address_0 \
+	ESB_INSTANCE_NAME(ESB_INSTANCE, nrf_esb_set_base_address_0)
+#define nrf_esb_set_base_address_1 \
+	ESB_INSTANCE_NAME(ESB_INSTANCE, nrf_esb_set_base_address_1)
+#define nrf_esb_set_prefixes \
+	ESB_INSTANCE_NAME(ESB_INSTANCE, nrf_esb_set_prefixes)
+#define nrf_esb_enable_pipes \
+	ESB_INSTANCE_NAME(ESB_INSTANCE, nrf_esb_enable_pipes)
+#define nrf_esb_update_prefix \
+	ESB_INSTANCE_NAME(ESB_INSTANCE, nrf_esb_update_prefix)
+#define nrf_esb_set_rf_channel \
+	ESB_INSTANCE_NAME(ESB_INSTANCE, nrf_esb_set_rf_channel)
+#define nrf_esb_set_hop_table \
+	ESB_INSTANCE_NAME(ESB_INSTANCE, nrf_esb_set_hop_table)
+#define nrf_esb_set_rx_duty_cycle \
+	ESB_INSTANCE_NAME(ESB_INSTANCE, nrf_esb_set_rx_duty_cycle)
+#define nrf_esb_get_rf_channel \
+	ESB_INSTANCE_NAME(ESB_INSTANCE, nrf_esb_get_rf_channel)
+#define nrf_esb_set_tx_power \
+	ESB_INSTANCE_NAME(ESB_INSTANCE, nrf_esb_set_tx_power)
+#define nrf_esb_set_retransmit_delay \
+	ESB_INSTANCE_NAME(ESB_INSTANCE, nrf_esb_set_retransmit_delay)
+#define nrf_esb_set_retransmit_count \
+	ESB_INSTANCE_NAME(ESB_INSTANCE, nrf_esb_set_retransmit_count)
+#define nrf_esb_set_bitrate \
+	ESB_INSTANCE_NAME(ESB_INSTANCE, nrf_esb_set_bitrate)
+#define nrf_esb_reuse_pid ESB_INSTANCE_NAME(ESB_INSTANCE, nrf_esb_reuse_pid)
+#define nrf_esb_get_pipe_stats \
+	ESB_INSTANCE_NAME(ESB_INSTANCE, nrf_esb_get_pipe_stats)
+#define nrf_esb_reset_pipe_stats \
+	ESB_INSTANCE_NAME(ESB_INSTANCE, nrf_esb_reset_pipe_stats)
+#define nrf_esb_get_latency_stats \
+	ESB_INSTANCE_NAME(ESB_INSTANCE, nrf_esb_get_latency_stats)
+#define nrf_esb_reset_latency_stats \
+	ESB_INSTANCE_NAME(ESB_INSTANCE, nrf_esb_reset_latency_stats)
+#define nrf_esb_log_latency_stats \
+	ESB_INSTANCE_NAME(ESB_INSTANCE, nrf_esb_log_latency_stats)
+#define nrf_esb_frag_init ESB_INSTANCE_NAME(ESB_INSTANCE, nrf_esb_frag_init)
+#define nrf_esb_frag_send ESB_INSTANCE_NAME(ESB_INSTANCE, nrf_esb_frag_send)
+#define nrf_esb_frag_process_event \
+	ESB_INSTANCE_NAME(ESB_INSTANCE, nrf_esb_frag_process_event)
+
+#undef IRQ_DIRECT_CONNECT
+#define IRQ_DIRECT_CONNECT(irq, prio, isr, flags) \
+	radio_mock_irq_connect(RADIO_MOCK_NODE, irq, isr)
+
+/* Interrupts of the simulated devices are dispatched by the simulator. */
+#undef irq_enable
+#define irq_enable(irq) ((void)(irq))
+
+/* Latency tracing measures the simulated time. */
+#include <kernel.h>
+#define k_cycle_get_32()						\
+	((u32_t)(radio_mock_time_get() *				\
+		 CONFIG_SYS_CLOCK_HW_CYCLES_PER_SEC / USEC_PER_SEC))
+
+#endif /* ESB_INSTANCE */
+
+#include <nrf_esb.h>
+#include <nrf_esb_frag.h>
+
+/** @brief Functions of one ESB module instance. */
+struct esb_instance {
+	int (*init)(const struct nrf_esb_config *config);
+	void (*disable)(void);
+	bool (*is_idle)(void);
+	int (*write_payload)(const struct nrf_esb_payload *payload);
+	int (*write_payload_nocopy)(struct nrf_esb_payload *payload);
+	int (*write_ack_payload)(const struct nrf_esb_payload *payload);
+	int (*flush_ack_payloads)(u8_t pipe);
+	int (*read_rx_payload)(struct nrf_esb_payload *payload);
+	int (*read_rx_payloads)(struct nrf_esb_payload *payloads, size_t max);
+	int (*start_tx)(void);
+	int (*start_rx)(void);
+	int (*stop_rx)(void);
+	int (*flush_tx)(void);
+	int (*pop_tx)(void);
+	int (*flush_rx)(void);
+	int (*set_rf_channel)(u32_t channel);
+	int (*get_rf_channel)(u32_t *channel);
+	int (*set_hop_table)(const u8_t *channels, u8_t count);
+	int (*set_retransmit_delay)(u16_t delay);
+	int (*set_retransmit_count)(u16_t count);
+	int (*set_rx_duty_cycle)(u32_t period_ms, u32_t window_us);
+	int (*get_pipe_stats)(u8_t pipe, struct nrf_esb_pipe_stats *stats);
+	int (*get_latency_stats)(enum nrf_esb_latency_stage stage,
+				 struct nrf_esb_latency_stats *stats);
+	void (*reset_latency_stats)(void);
+	int (*frag_init)(nrf_esb_frag_event_handler_t handler);
+	int (*frag_send)(u8_t pipe, const u8_t *data, size_t length,
+			 bool noack);
+	bool (*frag_process_event)(const struct nrf_esb_evt *event);
+};
+
+/** ESB module of simulated device 0. */
+extern const struct esb_instance esb_ptx;
+/** ESB module of simulated device 1. */
+extern const struct esb_instance esb_prx;
+
+#ifdef ESB_INSTANCE
+/** @brief Define the @ref esb_instance of the current ESB module copy. */
+#define ESB_INSTANCE_DEFINE(_name)					\
+	const struct esb_instance _name = {				\
+		.init = nrf_esb_init,					\
+		.disable = nrf_esb_disable,				\
+		.is_idle = nrf_esb_is_idle,				\
+		.write_payload = nrf_esb_write_payload,			\
+		.write_payload_nocopy = nrf_esb_write_payload_nocopy,	\
+		.write_ack_payload = nrf_esb_write_ack_payload,		\
+		.flush_ack_payloads = nrf_esb_flush_ack_payloads,	\
+		.read_rx_payload = nrf_esb_read_rx_payload,		\
+		.read_rx_payloads = nrf_esb_read_rx_payloads,		\
+		.start_tx = nrf_esb_start_tx,				\
+		.start_rx = nrf_esb_start_rx,				\
+		.stop_rx = nrf_esb_stop_rx,				\
+		.flush_tx = nrf_esb_flush_tx,				\
+		.pop_tx = nrf_esb_pop_tx,				\
+		.flush_rx = nrf_esb_flush_rx,				\
+		.set_rf_channel = nrf_esb_set_rf_channel,		\
+		.get_rf_channel = nrf_esb_get_rf_channel,		\
+		.set_hop_table = nrf_esb_set_hop_table,			\
+		.set_retransmit_delay = nrf_esb_set_retransmit_delay,	\
+		.set_retransmit_count = nrf_esb_set_retransmit_count,	\
+		.set_rx_duty_cycle = nrf_esb_set_rx_duty_cycle,		\
+		.get_pipe_stats = nrf_esb_get_pipe_stats,		\
+		.get_latency_stats = nrf_esb_get_latency_stats,		\
+		.reset_latency_stats = nrf_esb_reset_latency_stats,	\
+		.frag_init = nrf_esb_frag_init,				\
+		.frag_send = nrf_esb_frag_send,				\
+		.frag_process_event = nrf_esb_frag_process_event,	\
+	}
+#endif
+
+/** @} */
+#endif /* ESB_INSTANCE_H_ */
@@ -0,0 +1,14 @@
+/*
+ * Copyright (c) 2018 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#define RADIO_MOCK_NODE 1
+#define ESB_INSTANCE prx
+#include "esb_instance.h"
+
+/* ESB module of simulated device 1. */
+#include <nrf_esb.c>
+
+ESB_INSTANCE_DEFINE(esb_prx);
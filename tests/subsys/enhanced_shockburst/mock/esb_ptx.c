@@ -0,0 +1,14 @@
+/*
+ * Copyright (c) 2018 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#define RADIO_MOCK_NODE 0
+#define ESB_INSTANCE ptx
+#include "esb_instance.h"
+
+/* ESB module of simulated device 0. */
+#include <nrf_esb.c>
+
+ESB_INSTANCE_DEFINE(esb_ptx);
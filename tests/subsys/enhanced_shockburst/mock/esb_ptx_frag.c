@@ -0,0 +1,12 @@
+/*
+ * Copyright (c) 2018 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#define RADIO_MOCK_NODE 0
+#define ESB_INSTANCE ptx
+#include "esb_instance.h"
+
+/* Fragmentation layer on top of the ESB module of simulated device 0. */
+#include <nrf_esb_frag.c>
@@ -0,0 +1,282 @@
+/*
+ * Copyright (c) 2018 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#ifndef RADIO_MOCK_NRF_H_
+#define RADIO_MOCK_NRF_H_
+
+#include <misc/util.h>
+#include <stdbool.h>
+#include <toolchain.h>
+#include <zephyr/types.h>
+
+/**
+ * @file
+ * @defgroup radio_mock_nrf Mocked nRF5 peripherals
+ * @{
+ * @brief Replacement for the MDK nrf.h used by the ESB module in host tests.
+ *
+ * Only the RADIO, TIMER, PPI and FICR registers accessed by the ESB module
+ * are provided. Every peripheral access goes through
+ * @ref radio_mock_regs_sync, which lets the simulator in radio_mock.c react
+ * to task and interrupt configuration writes before the access takes place.
+ * The translation unit selects the simulated device with RADIO_MOCK_NODE.
+ */
+
+typedef struct {
+	volatile u32_t TASKS_TXEN;
+	volatile u32_t TASKS_RXEN;
+	volatile u32_t TASKS_START;
+	volatile u32_t TASKS_STOP;
+	volatile u32_t TASKS_DISABLE;
+	volatile u32_t TASKS_RSSISTART;
+	volatile u32_t TASKS_RSSISTOP;
+	volatile u32_t TASKS_BCSTART;
+	volatile u32_t TASKS_BCSTOP;
+	volatile u32_t EVENTS_READY;
+	volatile u32_t EVENTS_ADDRESS;
+	volatile u32_t EVENTS_PAYLOAD;
+	volatile u32_t EVENTS_END;
+	volatile u32_t EVENTS_DISABLED;
+	volatile u32_t EVENTS_DEVMATCH;
+	volatile u32_t EVENTS_DEVMISS;
+	volatile u32_t EVENTS_RSSIEND;
+	volatile u32_t EVENTS_BCMATCH;
+	volatile u32_t EVENTS_CRCOK;
+	volatile u32_t EVENTS_CRCERROR;
+	volatile u32_t SHORTS;
+	volatile u32_t INTENSET;
+	volatile u32_t INTENCLR;
+	volatile u32_t CRCSTATUS;
+	volatile u32_t RXMATCH;
+	volatile u32_t RXCRC;
+	volatile u32_t PACKETPTR;
+	volatile u32_t FREQUENCY;
+	volatile u32_t TXPOWER;
+	volatile u32_t MODE;
+	volatile u32_t PCNF0;
+	volatile u32_t PCNF1;
+	volatile u32_t BASE0;
+	volatile u32_t BASE1;
+	volatile u32_t PREFIX0;
+	volatile u32_t PREFIX1;
+	volatile u32_t TXADDRESS;
+	volatile u32_t RXADDRESSES;
+	volatile u32_t CRCCNF;
+	volatile u32_t CRCPOLY;
+	volatile u32_t CRCINIT;
+	volatile u32_t RSSISAMPLE;
+	volatile u32_t STATE;
+	volatile u32_t BCC;
+	volatile u32_t MODECNF0;
+} NRF_RADIO_Type;
+
+typedef struct {
+	volatile u32_t TASKS_START;
+	volatile u32_t TASKS_STOP;
+	volatile u32_t TASKS_COUNT;
+	volatile u32_t TASKS_CLEAR;
+	volatile u32_t TASKS_SHUTDOWN;
+	volatile u32_t TASKS_CAPTURE[6];
+	volatile u32_t EVENTS_COMPARE[6];
+	volatile u32_t SHORTS;
+	volatile u32_t INTENSET;
+	volatile u32_t INTENCLR;
+	volatile u32_t MODE;
+	volatile u32_t BITMODE;
+	volatile u32_t PRESCALER;
+	volatile u32_t CC[6];
+} NRF_TIMER_Type;
+
+typedef struct {
+	struct {
+		volatile u32_t EN;
+		volatile u32_t DIS;
+	} TASKS_CHG[6];
+	struct {
+		volatile u32_t EEP;
+		volatile u32_t TEP;
+	} CH[20];
+	volatile u32_t CHEN;
+	volatile u32_t CHENSET;
+	volatile u32_t CHENCLR;
+	volatile u32_t CHG[6];
+} NRF_PPI_Type;
+
+typedef struct {
+	struct {
+		volatile u32_t PART;
+		volatile u32_t VARIANT;
+	} INFO;
+} NRF_FICR_Type;
+
+/** Number of timer instances of a simulated device. */
+#define RADIO_MOCK_TIMER_COUNT 5
+
+/** @brief Peripherals of one simulated device. */
+struct radio_mock_regs {
+	NRF_RADIO_Type radio;
+	NRF_TIMER_Type timer[RADIO_MOCK_TIMER_COUNT];
+	NRF_PPI_Type ppi;
+};
+
+/**
+ * @brief Get the peripherals of a simulated device.
+ *
+ * Pending task, shortcut and interrupt enable writes are applied first.
+ *
+ * @param node Index of the simulated device.
+ *
+ * @return Peripherals of the device.
+ */
+struct radio_mock_regs *radio_mock_regs_sync(int node);
+
+extern NRF_FICR_Type radio_mock_ficr;
+
+#define NRF_RADIO (&radio_mock_regs_sync(RADIO_MOCK_NODE)->radio)
+#define NRF_TIMER0 (&radio_mock_regs_sync(RADIO_MOCK_NODE)->timer[0])
+#define NRF_TIMER1 (&radio_mock_regs_sync(RADIO_MOCK_NODE)->timer[1])
+#define NRF_TIMER2 (&radio_mock_regs_sync(RADIO_MOCK_NODE)->timer[2])
+#define NRF_TIMER3 (&radio_mock_regs_sync(RADIO_MOCK_NODE)->timer[3])
+#define NRF_TIMER4 (&radio_mock_regs_sync(RADIO_MOCK_NODE)->timer[4])
+#define NRF_PPI (&radio_mock_regs_sync(RADIO_MOCK_NODE)->ppi)
+#define NRF_FICR (&radio_mock_ficr)
+
+typedef enum {
+	RADIO_IRQn = 1,
+	TIMER0_IRQn = 8,
+	TIMER1_IRQn = 9,
+	TIMER2_IRQn = 10,
+	SWI0_IRQn = 20,
+	TIMER3_IRQn = 26,
+	TIMER4_IRQn = 27,
+} IRQn_Type;
+
+#define NRF5_IRQ_RADIO_IRQn RADIO_IRQn
+#define NRF5_IRQ_SWI0_IRQn SWI0_IRQn
+
+/**
+ * @brief Set or clear a software pending interrupt of a simulated device.
+ *
+ * @param node    Index of the simulated device.
+ * @param irq     Interrupt number.
+ * @param pending New pending state.
+ */
+void radio_mock_irq_pend(int node, IRQn_Type irq, bool pending);
+
+#define NVIC_SetPendingIRQ(irq) radio_mock_irq_pend(RADIO_MOCK_NODE, irq, true)
+#define NVIC_ClearPendingIRQ(irq) \
+	radio_mock_irq_pend(RADIO_MOCK_NODE, irq, false)
+
+#define __ALIGN(x) __aligned(x)
+#define __REV(x) __builtin_bswap32(x)
+#define __CORTEX_M 0x00U
+
+#define RADIO_SHORTS_READY_START_Pos 0
+#define RADIO_SHORTS_READY_START_Msk BIT(0)
+#define RADIO_SHORTS_READY_START_Enabled 1
+#define RADIO_SHORTS_END_DISABLE_Pos 1
+#define RADIO_SHORTS_END_DISABLE_Msk BIT(1)
+#define RADIO_SHORTS_END_DISABLE_Enabled 1
+#define RADIO_SHORTS_DISABLED_TXEN_Msk BIT(2)
+#define RADIO_SHORTS_DISABLED_RXEN_Msk BIT(3)
+#define RADIO_SHORTS_ADDRESS_RSSISTART_Msk BIT(4)
+#define RADIO_SHORTS_END_START_Msk BIT(5)
+#define RADIO_SHORTS_ADDRESS_BCSTART_Msk BIT(6)
+#define RADIO_SHORTS_DISABLED_RSSISTOP_Msk BIT(8)
+
+#define RADIO_INTENSET_READY_Msk BIT(0)
+#define RADIO_INTENSET_ADDRESS_Msk BIT(1)
+#define RADIO_INTENSET_PAYLOAD_Msk BIT(2)
+#define RADIO_INTENSET_END_Msk BIT(3)
+#define RADIO_INTENSET_DISABLED_Msk BIT(4)
+#define RADIO_INTENSET_BCMATCH_Msk BIT(10)
+#define RADIO_INTENCLR_READY_Msk BIT(0)
+#define RADIO_INTENCLR_ADDRESS_Msk BIT(1)
+#define RADIO_INTENCLR_PAYLOAD_Msk BIT(2)
+#define RADIO_INTENCLR_END_Msk BIT(3)
+#define RADIO_INTENCLR_DISABLED_Msk BIT(4)
+#define RADIO_INTENCLR_BCMATCH_Msk BIT(10)
+
+#define RADIO_STATE_STATE_Disabled 0
+#define RADIO_STATE_STATE_RxRu 1
+#define RADIO_STATE_STATE_RxIdle 2
+#define RADIO_STATE_STATE_Rx 3
+#define RADIO_STATE_STATE_RxDisable 4
+#define RADIO_STATE_STATE_TxRu 9
+#define RADIO_STATE_STATE_TxIdle 10
+#define RADIO_STATE_STATE_Tx 11
+#define RADIO_STATE_STATE_TxDisable 12
+
+#define RADIO_MODE_MODE_Pos 0
+#define RADIO_MODE_MODE_Nrf_1Mbit 0
+#define RADIO_MODE_MODE_Nrf_2Mbit 1
+#define RADIO_MODE_MODE_Nrf_250Kbit 2
+#define RADIO_MODE_MODE_Ble_1Mbit 3
+
+#define RADIO_CRCCNF_LEN_Pos 0
+#define RADIO_CRCCNF_LEN_Msk 0x3
+#define RADIO_CRCCNF_LEN_Disabled 0
+#define RADIO_CRCCNF_LEN_One 1
+#define RADIO_CRCCNF_LEN_Two 2
+
+#define RADIO_TXPOWER_TXPOWER_Pos 0
+#define RADIO_TXPOWER_TXPOWER_Pos4dBm 0x04
+#define RADIO_TXPOWER_TXPOWER_Pos3dBm 0x03
+#define RADIO_TXPOWER_TXPOWER_0dBm 0x00
+#define RADIO_TXPOWER_TXPOWER_Neg4dBm 0xFC
+#define RADIO_TXPOWER_TXPOWER_Neg8dBm 0xF8
+#define RADIO_TXPOWER_TXPOWER_Neg12dBm 0xF4
+#define RADIO_TXPOWER_TXPOWER_Neg16dBm 0xF0
+#define RADIO_TXPOWER_TXPOWER_Neg20dBm 0xEC
+#define RADIO_TXPOWER_TXPOWER_Neg30dBm 0xE2
+#define RADIO_TXPOWER_TXPOWER_Neg40dBm 0xD8
+
+#define RADIO_PCNF0_LFLEN_Pos 0
+#define RADIO_PCNF0_LFLEN_Msk 0xF
+#define RADIO_PCNF0_S0LEN_Pos 8
+#define RADIO_PCNF0_S0LEN_Msk 0x100
+#define RADIO_PCNF0_S1LEN_Pos 16
+#define RADIO_PCNF0_S1LEN_Msk 0xF0000
+#define RADIO_PCNF1_MAXLEN_Pos 0
+#define RADIO_PCNF1_MAXLEN_Msk 0xFF
+#define RADIO_PCNF1_STATLEN_Pos 8
+#define RADIO_PCNF1_STATLEN_Msk 0xFF00
+#define RADIO_PCNF1_BALEN_Pos 16
+#define RADIO_PCNF1_BALEN_Msk 0x70000
+#define RADIO_PCNF1_ENDIAN_Pos 24
+#define RADIO_PCNF1_ENDIAN_Big 1
+#define RADIO_PCNF1_WHITEEN_Pos 25
+#define RADIO_PCNF1_WHITEEN_Disabled 0
+
+#define RADIO_MODECNF0_RU_Pos 0
+#define RADIO_MODECNF0_RU_Msk BIT(0)
+#define RADIO_MODECNF0_RU_Default 0
+#define RADIO_MODECNF0_RU_Fast 1
+
+#define TIMER_SHORTS_COMPARE0_CLEAR_Msk BIT(0)
+#define TIMER_SHORTS_COMPARE1_CLEAR_Msk BIT(1)
+#define TIMER_SHORTS_COMPARE2_CLEAR_Msk BIT(2)
+#define TIMER_SHORTS_COMPARE3_CLEAR_Msk BIT(3)
+#define TIMER_SHORTS_COMPARE0_STOP_Msk BIT(8)
+#define TIMER_SHORTS_COMPARE1_STOP_Msk BIT(9)
+#define TIMER_SHORTS_COMPARE2_STOP_Msk BIT(10)
+#define TIMER_SHORTS_COMPARE3_STOP_Msk BIT(11)
+#define TIMER_INTENSET_COMPARE0_Msk BIT(16)
+#define TIMER_INTENSET_COMPARE1_Msk BIT(17)
+#define TIMER_INTENSET_COMPARE2_Msk BIT(18)
+#define TIMER_INTENSET_COMPARE3_Msk BIT(19)
+#define TIMER_INTENCLR_COMPARE0_Msk BIT(16)
+#define TIMER_INTENCLR_COMPARE1_Msk BIT(17)
+#define TIMER_INTENCLR_COMPARE2_Msk BIT(18)
+#define TIMER_INTENCLR_COMPARE3_Msk BIT(19)
+#define TIMER_BITMODE_BITMODE_Pos 0
+#define TIMER_BITMODE_BITMODE_16Bit 0
+#define TIMER_BITMODE_BITMODE_32Bit 3
+#define TIMER_MODE_MODE_Pos 0
+#define TIMER_MODE_MODE_Timer 0
+
+/** @} */
+#endif /* RADIO_MOCK_NRF_H_ */
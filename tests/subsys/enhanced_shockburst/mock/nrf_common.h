@@ -0,0 +1,13 @@
+/*
+ * Copyright (c) 2018 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#ifndef RADIO_MOCK_NRF_COMMON_H_
+#define RADIO_MOCK_NRF_COMMON_H_
+
+/* The mocked peripherals are all declared in nrf.h. */
+#include <nrf.h>
+
+#endif /* RADIO_MOCK_NRF_COMMON_H_ */
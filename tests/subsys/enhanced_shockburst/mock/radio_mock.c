@@ -0,0 +1,830 @@
+/*
+ * Copyright (c) 2018 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#include <misc/printk.h>
+#include <nrf.h>
+#include <string.h>
+#include "radio_mock.h"
+
+#define TIME_NEVER UINT64_MAX
+
+/* Radio ramp-up time, in microseconds. */
+#define RAMP_UP_US 130
+#define RAMP_UP_FAST_US 40
+
+/* Largest packet in RAM: S0, LENGTH and S1 fields and 255 bytes. */
+#define PACKET_SIZE_MAX 258
+
+/* RSSI reported for received frames, in -dBm. */
+#define RSSI_SAMPLE 50
+
+/* Number of interrupt handler calls after which the interrupt lines are
+ * considered stuck.
+ */
+#define DISPATCH_LIMIT 100000
+
+#define IRQ_COUNT 32
+
+enum radio_phase {
+	PHASE_NONE,
+	PHASE_RAMP_UP,	/* Waiting for READY. */
+	PHASE_ADDRESS,	/* Sending, waiting for the end of the address. */
+	PHASE_END,	/* Sending, waiting for the end of the packet. */
+};
+
+struct air_frame {
+	u32_t channel;
+	u32_t mode;
+	u32_t balen;
+	u32_t prefix;
+	u32_t base;
+	u8_t data[PACKET_SIZE_MAX];
+	size_t length;
+	u64_t addr_time;
+	u64_t end_time;
+	bool lost;
+};
+
+struct timer_state {
+	u32_t inten;
+	bool running;
+	u32_t base;	/* Counter value at since. */
+	u64_t since;
+};
+
+struct node {
+	struct radio_mock_regs regs;
+	u32_t state;
+	enum radio_phase phase;
+	u64_t deadline;
+	u8_t *packetptr;
+	struct air_frame tx;
+	struct air_frame *rx;
+	u32_t rx_match;
+	u32_t radio_inten;
+	struct timer_state timer[RADIO_MOCK_TIMER_COUNT];
+	void (*isr[IRQ_COUNT])(void);
+	u32_t irq_pending;
+	u32_t radio_irq_latency;
+	u64_t radio_irq_since;	/* Time the radio interrupt was raised. */
+	bool radio_irq_raised;
+};
+
+static const IRQn_Type timer_irq[RADIO_MOCK_TIMER_COUNT] = {
+	TIMER0_IRQn, TIMER1_IRQn, TIMER2_IRQn, TIMER3_IRQn, TIMER4_IRQn
+};
+
+static struct node nodes[RADIO_MOCK_NODE_COUNT];
+static u64_t now;
+static u32_t loss_permille;
+static u32_t rand_state;
+static struct radio_mock_stats stats;
+
+NRF_FICR_Type radio_mock_ficr;
+
+static u32_t rand_get(void)
+{
+	/* xorshift32 */
+	rand_state ^= rand_state << 13;
+	rand_state ^= rand_state >> 17;
+	rand_state ^= rand_state << 5;
+
+	return rand_state;
+}
+
+static bool task_take(volatile u32_t *task)
+{
+	if (*task) {
+		*task = 0;
+		return true;
+	}
+
+	return false;
+}
+
+static void ppi_sync(struct node *n)
+{
+	NRF_PPI_Type *ppi = &n->regs.ppi;
+
+	ppi->CHEN = (ppi->CHEN | ppi->CHENSET) & ~ppi->CHENCLR;
+	ppi->CHENSET = 0;
+	ppi->CHENCLR = 0;
+
+	for (size_t g = 0; g < ARRAY_SIZE(ppi->CHG); g++) {
+		if (task_take(&ppi->TASKS_CHG[g].EN)) {
+			ppi->CHEN |= ppi->CHG[g];
+		}
+		if (task_take(&ppi->TASKS_CHG[g].DIS)) {
+			ppi->CHEN &= ~ppi->CHG[g];
+		}
+	}
+}
+
+/* Trigger the tasks connected to an event through PPI. The tasks are
+ * performed by the next synchronization of the node.
+ */
+static void ppi_event(struct node *n, volatile u32_t *event)
+{
+	NRF_PPI_Type *ppi = &n->regs.ppi;
+	uintptr_t regs_start = (uintptr_t)&n->regs;
+	uintptr_t regs_end = regs_start + sizeof(n->regs);
+
+	ppi_sync(n);
+
+	for (size_t ch = 0; ch < ARRAY_SIZE(ppi->CH); ch++) {
+		uintptr_t tep = ppi->CH[ch].TEP;
+
+		if (!(ppi->CHEN & BIT(ch)) ||
+		    (ppi->CH[ch].EEP != (u32_t)(uintptr_t)event)) {
+			continue;
+		}
+		if ((tep >= regs_start) && (tep < regs_end)) {
+			*(volatile u32_t *)tep = 1;
+		}
+	}
+}
+
+static void radio_event(struct node *n, volatile u32_t *event)
+{
+	NRF_RADIO_Type *radio = &n->regs.radio;
+	u32_t shorts = radio->SHORTS;
+
+	*event = 1;
+	ppi_event(n, event);
+
+	if (event == &radio->EVENTS_READY) {
+		if (shorts & RADIO_SHORTS_READY_START_Msk) {
+			radio->TASKS_START = 1;
+		}
+	} else if (event == &radio->EVENTS_END) {
+		if (shorts & RADIO_SHORTS_END_DISABLE_Msk) {
+			radio->TASKS_DISABLE = 1;
+		}
+		if (shorts & RADIO_SHORTS_END_START_Msk) {
+			radio->TASKS_START = 1;
+		}
+	} else if (event == &radio->EVENTS_DISABLED) {
+		if (shorts & RADIO_SHORTS_DISABLED_TXEN_Msk) {
+			radio->TASKS_TXEN = 1;
+		}
+		if (shorts & RADIO_SHORTS_DISABLED_RXEN_Msk) {
+			radio->TASKS_RXEN = 1;
+		}
+	}
+}
+
+/* Number of packet bytes in RAM, including the S0, LENGTH and S1 fields. */
+static size_t packet_size(const NRF_RADIO_Type *radio, const u8_t *packet,
+			  size_t *header_size, size_t *header_bits)
+{
+	u32_t s0len = (radio->PCNF0 & RADIO_PCNF0_S0LEN_Msk) >>
+		      RADIO_PCNF0_S0LEN_Pos;
+	u32_t lflen = (radio->PCNF0 & RADIO_PCNF0_LFLEN_Msk) >>
+		      RADIO_PCNF0_LFLEN_Pos;
+	u32_t s1len = (radio->PCNF0 & RADIO_PCNF0_S1LEN_Msk) >>
+		      RADIO_PCNF0_S1LEN_Pos;
+	u32_t statlen = (radio->PCNF1 & RADIO_PCNF1_STATLEN_Msk) >>
+			RADIO_PCNF1_STATLEN_Pos;
+	u32_t maxlen = (radio->PCNF1 & RADIO_PCNF1_MAXLEN_Msk) >>
+		       RADIO_PCNF1_MAXLEN_Pos;
+	size_t header = s0len + (lflen ? 1 : 0) + (s1len ? 1 : 0);
+	size_t length = statlen;
+
+	if (lflen) {
+		length += packet[s0len] & BIT_MASK(lflen);
+	}
+
+	if (header_size != NULL) {
+		*header_size = header;
+	}
+	if (header_bits != NULL) {
+		*header_bits = 8 * s0len + lflen + s1len;
+	}
+
+	return header + min(length, (size_t)maxlen);
+}
+
+static void logical_address(const NRF_RADIO_Type *radio, u32_t index,
+			    u32_t *prefix, u32_t *base)
+{
+	u32_t prefixes = (index < 4) ? radio->PREFIX0 : radio->PREFIX1;
+
+	*prefix = (prefixes >> (8 * (index % 4))) & 0xFF;
+	*base = (index == 0) ? radio->BASE0 : radio->BASE1;
+}
+
+/* Time on air of a number of bits, in microseconds. */
+static u64_t air_time(u32_t mode, size_t bits)
+{
+	u32_t kbps = (mode == RADIO_MODE_MODE_Nrf_2Mbit) ? 2000 :
+		     (mode == RADIO_MODE_MODE_Nrf_250Kbit) ? 250 : 1000;
+
+	return (bits * 1000 + kbps - 1) / kbps;
+}
+
+static void radio_tx_start(struct node *n)
+{
+	NRF_RADIO_Type *radio = &n->regs.radio;
+	struct air_frame *frame = &n->tx;
+	const u8_t *packet = (const u8_t *)(uintptr_t)radio->PACKETPTR;
+	u32_t preamble = (radio->MODE == RADIO_MODE_MODE_Nrf_2Mbit) ? 2 : 1;
+	u32_t crc_len = radio->CRCCNF & RADIO_CRCCNF_LEN_Msk;
+	size_t header_size;
+	size_t header_bits;
+	size_t addr_bits;
+
+	frame->channel = radio->FREQUENCY;
+	frame->mode = radio->MODE;
+	frame->balen = (radio->PCNF1 & RADIO_PCNF1_BALEN_Msk) >>
+		       RADIO_PCNF1_BALEN_Pos;
+	logical_address(radio, radio->TXADDRESS, &frame->prefix,
+			&frame->base);
+	frame->length = packet_size(radio, packet, &header_size, &header_bits);
+	memcpy(frame->data, packet, frame->length);
+
+	addr_bits = 8 * (preamble + frame->balen + 1);
+	frame->addr_time = now + air_time(frame->mode, addr_bits);
+	frame->end_time = now + air_time(frame->mode, addr_bits + header_bits +
+					 8 * (frame->length - header_size) +
+					 8 * crc_len);
+	frame->lost = (rand_get() % 1000) < loss_permille;
+
+	stats.frames_sent++;
+	if (frame->lost) {
+		stats.frames_lost++;
+	}
+
+	n->state = RADIO_STATE_STATE_Tx;
+	n->phase = PHASE_ADDRESS;
+	n->deadline = frame->addr_time;
+}
+
+static void radio_start(struct node *n)
+{
+	if (n->state == RADIO_STATE_STATE_TxIdle) {
+		radio_tx_start(n);
+	} else if (n->state == RADIO_STATE_STATE_RxIdle) {
+		n->packetptr = (u8_t *)(uintptr_t)n->regs.radio.PACKETPTR;
+		n->state = RADIO_STATE_STATE_Rx;
+	}
+}
+
+/* Abort the reception of frames sent by a node. */
+static void frame_abort(struct node *sender)
+{
+	for (size_t i = 0; i < RADIO_MOCK_NODE_COUNT; i++) {
+		if (nodes[i].rx == &sender->tx) {
+			nodes[i].rx = NULL;
+		}
+	}
+}
+
+static void radio_stop(struct node *n)
+{
+	if (n->state == RADIO_STATE_STATE_Tx) {
+		frame_abort(n);
+		n->state = RADIO_STATE_STATE_TxIdle;
+	} else if (n->state == RADIO_STATE_STATE_Rx) {
+		n->rx = NULL;
+		n->state = RADIO_STATE_STATE_RxIdle;
+	}
+	n->phase = PHASE_NONE;
+	n->deadline = TIME_NEVER;
+}
+
+static void radio_disable(struct node *n)
+{
+	if (n->state == RADIO_STATE_STATE_Tx) {
+		frame_abort(n);
+	}
+	n->rx = NULL;
+	n->state = RADIO_STATE_STATE_Disabled;
+	n->phase = PHASE_NONE;
+	n->deadline = TIME_NEVER;
+
+	/* Disabling takes a few microseconds on hardware. It is immediate
+	 * here, so that busy-waiting for DISABLED terminates.
+	 */
+	radio_event(n, &n->regs.radio.EVENTS_DISABLED);
+}
+
+static void radio_enable(struct node *n, bool tx)
+{
+	bool fast = n->regs.radio.MODECNF0 & RADIO_MODECNF0_RU_Msk;
+
+	if (n->state != RADIO_STATE_STATE_Disabled) {
+		return;
+	}
+
+	n->state = tx ? RADIO_STATE_STATE_TxRu : RADIO_STATE_STATE_RxRu;
+	n->phase = PHASE_RAMP_UP;
+	n->deadline = now + (fast ? RAMP_UP_FAST_US : RAMP_UP_US);
+}
+
+static bool radio_sync(struct node *n)
+{
+	NRF_RADIO_Type *radio = &n->regs.radio;
+	bool busy = false;
+
+	n->radio_inten = (n->radio_inten | radio->INTENSET) & ~radio->INTENCLR;
+	radio->INTENSET = n->radio_inten;
+	radio->INTENCLR = 0;
+
+	radio->TASKS_RSSISTART = 0;
+	radio->TASKS_RSSISTOP = 0;
+	radio->TASKS_BCSTART = 0;
+	radio->TASKS_BCSTOP = 0;
+
+	if (task_take(&radio->TASKS_STOP)) {
+		radio_stop(n);
+		busy = true;
+	}
+	if (task_take(&radio->TASKS_DISABLE)) {
+		radio_disable(n);
+		busy = true;
+	}
+	if (task_take(&radio->TASKS_TXEN)) {
+		radio_enable(n, true);
+		busy = true;
+	}
+	if (task_take(&radio->TASKS_RXEN)) {
+		radio_enable(n, false);
+		busy = true;
+	}
+	if (task_take(&radio->TASKS_START)) {
+		radio_start(n);
+		busy = true;
+	}
+
+	radio->STATE = n->state;
+
+	return busy;
+}
+
+static u32_t timer_count(const struct timer_state *t)
+{
+	if (!t->running) {
+		return t->base;
+	}
+
+	return t->base + (u32_t)(now - t->since);
+}
+
+static bool timer_sync(struct node *n, size_t i)
+{
+	NRF_TIMER_Type *timer = &n->regs.timer[i];
+	struct timer_state *t = &n->timer[i];
+	bool busy = false;
+
+	t->inten = (t->inten | timer->INTENSET) & ~timer->INTENCLR;
+	timer->INTENSET = t->inten;
+	timer->INTENCLR = 0;
+	timer->TASKS_COUNT = 0;
+
+	if (task_take(&timer->TASKS_STOP)) {
+		t->base = timer_count(t);
+		t->running = false;
+		busy = true;
+	}
+	if (task_take(&timer->TASKS_SHUTDOWN)) {
+		t->base = 0;
+		t->running = false;
+		busy = true;
+	}
+	if (task_take(&timer->TASKS_CLEAR)) {
+		t->base = 0;
+		t->since = now;
+		busy = true;
+	}
+	if (task_take(&timer->TASKS_START)) {
+		if (!t->running) {
+			t->running = true;
+			t->since = now;
+		}
+		busy = true;
+	}
+	for (size_t cc = 0; cc < ARRAY_SIZE(timer->CC); cc++) {
+		if (task_take(&timer->TASKS_CAPTURE[cc])) {
+			timer->CC[cc] = timer_count(t);
+		}
+	}
+
+	return busy;
+}
+
+static void node_sync(struct node *n)
+{
+	bool busy;
+
+	do {
+		busy = radio_sync(n);
+		for (size_t i = 0; i < RADIO_MOCK_TIMER_COUNT; i++) {
+			busy |= timer_sync(n, i);
+		}
+		ppi_sync(n);
+	} while (busy);
+}
+
+struct radio_mock_regs *radio_mock_regs_sync(int node)
+{
+	node_sync(&nodes[node]);
+
+	return &nodes[node].regs;
+}
+
+void radio_mock_irq_pend(int node, IRQn_Type irq, bool pending)
+{
+	if (pending) {
+		nodes[node].irq_pending |= BIT(irq);
+	} else {
+		nodes[node].irq_pending &= ~BIT(irq);
+	}
+}
+
+void radio_mock_irq_connect(int node, unsigned int irq, void (*isr)(void))
+{
+	nodes[node].isr[irq] = isr;
+}
+
+static bool radio_irq_level(struct node *n)
+{
+	NRF_RADIO_Type *radio = &n->regs.radio;
+	const struct {
+		volatile u32_t *event;
+		u32_t mask;
+	} sources[] = {
+		{ &radio->EVENTS_READY, RADIO_INTENSET_READY_Msk },
+		{ &radio->EVENTS_ADDRESS, RADIO_INTENSET_ADDRESS_Msk },
+		{ &radio->EVENTS_PAYLOAD, RADIO_INTENSET_PAYLOAD_Msk },
+		{ &radio->EVENTS_END, RADIO_INTENSET_END_Msk },
+		{ &radio->EVENTS_DISABLED, RADIO_INTENSET_DISABLED_Msk },
+		{ &radio->EVENTS_BCMATCH, RADIO_INTENSET_BCMATCH_Msk },
+	};
+
+	for (size_t i = 0; i < ARRAY_SIZE(sources); i++) {
+		if (*sources[i].event && (n->radio_inten & sources[i].mask)) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static bool timer_irq_level(struct node *n, size_t i)
+{
+	NRF_TIMER_Type *timer = &n->regs.timer[i];
+
+	for (size_t cc = 0; cc < ARRAY_SIZE(timer->EVENTS_COMPARE); cc++) {
+		if (timer->EVENTS_COMPARE[cc] &&
+		    (n->timer[i].inten & BIT(16 + cc))) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/* Find the interrupt to serve, in priority order: radio, timers, then
+ * software interrupts.
+ */
+static int irq_next(struct node *n)
+{
+	if (n->isr[RADIO_IRQn] && radio_irq_level(n)) {
+		if (!n->radio_irq_raised) {
+			n->radio_irq_raised = true;
+			n->radio_irq_since = now;
+		}
+		if (now >= n->radio_irq_since + n->radio_irq_latency) {
+			return RADIO_IRQn;
+		}
+	} else {
+		n->radio_irq_raised = false;
+	}
+
+	for (size_t i = 0; i < RADIO_MOCK_TIMER_COUNT; i++) {
+		if (n->isr[timer_irq[i]] && timer_irq_level(n, i)) {
+			return timer_irq[i];
+		}
+	}
+
+	for (int irq = 0; irq < IRQ_COUNT; irq++) {
+		if (n->irq_pending & BIT(irq)) {
+			n->irq_pending &= ~BIT(irq);
+			if (n->isr[irq]) {
+				return irq;
+			}
+		}
+	}
+
+	return -1;
+}
+
+static void irq_dispatch(void)
+{
+	for (u32_t calls = 0; calls < DISPATCH_LIMIT; calls++) {
+		bool served = false;
+
+		for (size_t i = 0; i < RADIO_MOCK_NODE_COUNT; i++) {
+			int irq;
+
+			node_sync(&nodes[i]);
+			irq = irq_next(&nodes[i]);
+			if (irq >= 0) {
+				nodes[i].isr[irq]();
+				served = true;
+			}
+		}
+
+		if (!served) {
+			return;
+		}
+	}
+
+	printk("radio_mock: interrupt lines stuck\n");
+}
+
+static bool address_match(struct node *n, const struct air_frame *frame,
+			  u32_t *match)
+{
+	NRF_RADIO_Type *radio = &n->regs.radio;
+	u32_t balen = (radio->PCNF1 & RADIO_PCNF1_BALEN_Msk) >>
+		      RADIO_PCNF1_BALEN_Pos;
+
+	if ((radio->FREQUENCY != frame->channel) ||
+	    (radio->MODE != frame->mode) || (balen != frame->balen)) {
+		return false;
+	}
+
+	for (u32_t i = 0; i < 8; i++) {
+		u32_t prefix;
+		u32_t base;
+
+		if (!(radio->RXADDRESSES & BIT(i))) {
+			continue;
+		}
+
+		logical_address(radio, i, &prefix, &base);
+		if ((prefix == frame->prefix) && (base == frame->base)) {
+			*match = i;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static u16_t crc16(const u8_t *data, size_t length)
+{
+	u16_t crc = 0xFFFF;
+
+	for (size_t i = 0; i < length; i++) {
+		crc ^= (u16_t)data[i] << 8;
+		for (int bit = 0; bit < 8; bit++) {
+			crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+		}
+	}
+
+	return crc;
+}
+
+static void frame_address_sent(struct node *sender)
+{
+	struct air_frame *frame = &sender->tx;
+
+	radio_event(sender, &sender->regs.radio.EVENTS_ADDRESS);
+
+	if (frame->lost) {
+		return;
+	}
+
+	for (size_t i = 0; i < RADIO_MOCK_NODE_COUNT; i++) {
+		struct node *n = &nodes[i];
+		u32_t match;
+
+		if ((n == sender) || (n->state != RADIO_STATE_STATE_Rx) ||
+		    (n->rx != NULL) || !address_match(n, frame, &match)) {
+			continue;
+		}
+
+		n->rx = frame;
+		n->rx_match = match;
+		n->regs.radio.RSSISAMPLE = RSSI_SAMPLE;
+		radio_event(n, &n->regs.radio.EVENTS_ADDRESS);
+	}
+}
+
+static void frame_end(struct node *sender)
+{
+	struct air_frame *frame = &sender->tx;
+
+	for (size_t i = 0; i < RADIO_MOCK_NODE_COUNT; i++) {
+		struct node *n = &nodes[i];
+		NRF_RADIO_Type *radio = &n->regs.radio;
+		size_t length;
+
+		if (n->rx != frame) {
+			continue;
+		}
+
+		length = min(frame->length,
+			     packet_size(radio, frame->data, NULL, NULL));
+		memcpy(n->packetptr, frame->data, length);
+
+		radio->RXMATCH = n->rx_match;
+		radio->CRCSTATUS = 1;
+		radio->RXCRC = crc16(frame->data, frame->length);
+		n->rx = NULL;
+		n->state = RADIO_STATE_STATE_RxIdle;
+		stats.frames_received++;
+
+		radio_event(n, &radio->EVENTS_PAYLOAD);
+		radio_event(n, &radio->EVENTS_CRCOK);
+		radio_event(n, &radio->EVENTS_END);
+	}
+
+	sender->state = RADIO_STATE_STATE_TxIdle;
+	radio_event(sender, &sender->regs.radio.EVENTS_PAYLOAD);
+	radio_event(sender, &sender->regs.radio.EVENTS_END);
+}
+
+static void radio_step(struct node *n)
+{
+	enum radio_phase phase = n->phase;
+
+	n->phase = PHASE_NONE;
+	n->deadline = TIME_NEVER;
+
+	switch (phase) {
+	case PHASE_RAMP_UP:
+		n->state = (n->state == RADIO_STATE_STATE_TxRu) ?
+			   RADIO_STATE_STATE_TxIdle : RADIO_STATE_STATE_RxIdle;
+		radio_event(n, &n->regs.radio.EVENTS_READY);
+		break;
+	case PHASE_ADDRESS:
+		n->phase = PHASE_END;
+		n->deadline = n->tx.end_time;
+		frame_address_sent(n);
+		break;
+	case PHASE_END:
+		frame_end(n);
+		break;
+	default:
+		break;
+	}
+}
+
+/* Time of the next compare event of a timer. */
+static u64_t timer_deadline(const struct node *n, size_t i)
+{
+	const struct timer_state *t = &n->timer[i];
+	const NRF_TIMER_Type *timer = &n->regs.timer[i];
+	u32_t count = timer_count(t);
+	u64_t deadline = TIME_NEVER;
+
+	if (!t->running) {
+		return TIME_NEVER;
+	}
+
+	for (size_t cc = 0; cc < ARRAY_SIZE(timer->CC); cc++) {
+		if (timer->CC[cc] > count) {
+			deadline = min(deadline, now + timer->CC[cc] - count);
+		}
+	}
+
+	return deadline;
+}
+
+static void timer_step(struct node *n, size_t i)
+{
+	NRF_TIMER_Type *timer = &n->regs.timer[i];
+	u32_t count = timer_count(&n->timer[i]);
+
+	if (!n->timer[i].running) {
+		return;
+	}
+
+	for (size_t cc = 0; cc < ARRAY_SIZE(timer->CC); cc++) {
+		if (timer->CC[cc] != count) {
+			continue;
+		}
+
+		timer->EVENTS_COMPARE[cc] = 1;
+		ppi_event(n, &timer->EVENTS_COMPARE[cc]);
+
+		if (timer->SHORTS & BIT(cc)) {
+			timer->TASKS_CLEAR = 1;
+		}
+		if (timer->SHORTS & BIT(8 + cc)) {
+			timer->TASKS_STOP = 1;
+		}
+	}
+}
+
+static u64_t deadline_next(void)
+{
+	u64_t deadline = TIME_NEVER;
+
+	for (size_t i = 0; i < RADIO_MOCK_NODE_COUNT; i++) {
+		deadline = min(deadline, nodes[i].deadline);
+		if (nodes[i].radio_irq_raised) {
+			deadline = min(deadline, nodes[i].radio_irq_since +
+					       nodes[i].radio_irq_latency);
+		}
+		for (size_t t = 0; t < RADIO_MOCK_TIMER_COUNT; t++) {
+			deadline = min(deadline, timer_deadline(&nodes[i], t));
+		}
+	}
+
+	return deadline;
+}
+
+/* Advance to the next event, unless it comes after end. */
+static bool step(u64_t end)
+{
+	u64_t deadline;
+
+	irq_dispatch();
+
+	deadline = deadline_next();
+	if (deadline > end) {
+		now = end;
+		return false;
+	}
+
+	now = deadline;
+
+	for (size_t i = 0; i < RADIO_MOCK_NODE_COUNT; i++) {
+		for (size_t t = 0; t < RADIO_MOCK_TIMER_COUNT; t++) {
+			timer_step(&nodes[i], t);
+		}
+	}
+	for (size_t i = 0; i < RADIO_MOCK_NODE_COUNT; i++) {
+		if (nodes[i].deadline <= now) {
+			radio_step(&nodes[i]);
+		}
+	}
+
+	irq_dispatch();
+
+	return true;
+}
+
+void radio_mock_reset(u32_t seed)
+{
+	memset(nodes, 0, sizeof(nodes));
+	memset(&stats, 0, sizeof(stats));
+
+	for (size_t i = 0; i < RADIO_MOCK_NODE_COUNT; i++) {
+		nodes[i].deadline = TIME_NEVER;
+	}
+
+	now = 0;
+	loss_permille = 0;
+	rand_state = seed ? seed : 1;
+}
+
+void radio_mock_loss_set(u32_t permille)
+{
+	loss_permille = permille;
+}
+
+void radio_mock_irq_latency_set(int node, u32_t latency_us)
+{
+	nodes[node].radio_irq_latency = latency_us;
+}
+
+u64_t radio_mock_time_get(void)
+{
+	return now;
+}
+
+void radio_mock_run(u32_t duration_us)
+{
+	u64_t end = now + duration_us;
+
+	while (step(end)) {
+	}
+}
+
+bool radio_mock_run_until(bool (*cond)(void), u32_t timeout_us)
+{
+	u64_t end = now + timeout_us;
+
+	irq_dispatch();
+
+	while (!cond()) {
+		if (!step(end)) {
+			return cond();
+		}
+	}
+
+	return true;
+}
+
+void radio_mock_stats_get(struct radio_mock_stats *stats_out)
+{
+	*stats_out = stats;
+}
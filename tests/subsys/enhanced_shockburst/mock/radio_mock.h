@@ -0,0 +1,112 @@
+/*
+ * Copyright (c) 2018 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#ifndef RADIO_MOCK_H_
+#define RADIO_MOCK_H_
+
+#include <stdbool.h>
+#include <zephyr/types.h>
+
+/**
+ * @file
+ * @defgroup radio_mock Radio simulator
+ * @{
+ * @brief Discrete event simulation of nRF5 devices sharing an air channel.
+ *
+ * The simulator models the RADIO state machine (ramp-up, address, end and
+ * disable timing, shortcuts and packet RAM layout), the TIMER peripherals
+ * running at 1 MHz, the PPI channels and the interrupt lines of
+ * @ref RADIO_MOCK_NODE_COUNT devices. A frame is received by every device
+ * that listens on the same channel, bitrate and address when the address of
+ * the frame is sent, unless the frame is lost. Collisions are not modeled.
+ *
+ * Simulated time only advances in @ref radio_mock_run and
+ * @ref radio_mock_run_until. Interrupt handlers run in the context of the
+ * calling thread and take no simulated time.
+ */
+
+/** Number of simulated devices. */
+#define RADIO_MOCK_NODE_COUNT 2
+
+/** @brief Air channel statistics. */
+struct radio_mock_stats {
+	u32_t frames_sent;	/**< Frames started by any device. */
+	u32_t frames_lost;	/**< Frames dropped by the loss model. */
+	u32_t frames_received;	/**< Frames received by any device. */
+};
+
+/**
+ * @brief Reset all simulated devices and the simulated time.
+ *
+ * @param seed Seed of the loss model.
+ */
+void radio_mock_reset(u32_t seed);
+
+/**
+ * @brief Set the probability that a frame is lost.
+ *
+ * @param permille Probability, in 1/1000.
+ */
+void radio_mock_loss_set(u32_t permille);
+
+/**
+ * @brief Set the time a simulated device takes to serve its radio
+ *        interrupt.
+ *
+ * The radio interrupt handler runs this long after the interrupt is raised,
+ * as if a higher priority interrupt was running. Events generated in the
+ * meantime are merged, as on hardware.
+ *
+ * @param node       Index of the simulated device.
+ * @param latency_us Latency, in microseconds.
+ */
+void radio_mock_irq_latency_set(int node, u32_t latency_us);
+
+/**
+ * @brief Get the simulated time.
+ *
+ * @return Time since @ref radio_mock_reset, in microseconds.
+ */
+u64_t radio_mock_time_get(void);
+
+/**
+ * @brief Run the simulation.
+ *
+ * @param duration_us Simulated time to run, in microseconds.
+ */
+void radio_mock_run(u32_t duration_us);
+
+/**
+ * @brief Run the simulation until a condition is met.
+ *
+ * The condition is evaluated after every simulated event.
+ *
+ * @param cond       Condition.
+ * @param timeout_us Maximum simulated time to run, in microseconds.
+ *
+ * @retval true  If the condition was met.
+ * @retval false If the timeout expired.
+ */
+bool radio_mock_run_until(bool (*cond)(void), u32_t timeout_us);
+
+/**
+ * @brief Get the air channel statistics.
+ *
+ * @param stats Statistics since @ref radio_mock_reset.
+ */
+void radio_mock_stats_get(struct radio_mock_stats *stats);
+
+/**
+ * @brief Register an interrupt handler of a simulated device.
+ *
+ * @param node Index of the simulated device.
+ * @param irq  Interrupt number.
+ * @param isr  Interrupt handler.
+ */
+void radio_mock_irq_connect(int node, unsigned int irq, void (*isr)(void));
+
+/** @} */
+#endif /* RADIO_MOCK_H_ */
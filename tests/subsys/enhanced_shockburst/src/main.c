@@ -0,0 +1,731 @@
+/*
+ * Copyright (c) 2018 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+#include <ztest.h>
+#include <kernel.h>
+#include <string.h>
+#include "../mock/esb_instance.h"
+#include "../mock/radio_mock.h"
+
+#define PACKET_COUNT 100
+#define FRAG_MESSAGE_SIZE 1000
+
+/* Simulated time allowed per packet, in microseconds. */
+#define PACKET_TIMEOUT_US 100000
+
+static struct {
+	u32_t tx_success;
+	u32_t tx_failed;
+	u32_t tx_attempts;
+	u32_t rx_count;
+	u32_t rx_events;
+	u8_t rx_data[PACKET_COUNT][CONFIG_NRF_ESB_MAX_PAYLOAD_LENGTH];
+	u8_t rx_length[PACKET_COUNT];
+	/* Payloads returned by nrf_esb_write_payload_nocopy. */
+	struct nrf_esb_payload *released[8];
+	u32_t released_count;
+	u32_t frag_tx_success;
+	u32_t frag_rx_count;
+	u8_t frag_rx_data[FRAG_MESSAGE_SIZE];
+	size_t frag_rx_length;
+} ptx, prx;
+
+static bool use_frag;
+static bool use_batch_read;
+
+static void rx_store(typeof(ptx) *dev, const struct nrf_esb_payload *payload)
+{
+	if (dev->rx_count < PACKET_COUNT) {
+		memcpy(dev->rx_data[dev->rx_count], payload->data,
+		       payload->length);
+		dev->rx_length[dev->rx_count] = payload->length;
+	}
+	dev->rx_count++;
+}
+
+static void rx_read(const struct esb_instance *esb, typeof(ptx) *dev)
+{
+	struct nrf_esb_payload payloads[CONFIG_NRF_ESB_RX_EVENT_COUNT];
+	int count;
+
+	if (!use_batch_read) {
+		while (esb->read_rx_payload(&payloads[0]) == 0) {
+			rx_store(dev, &payloads[0]);
+		}
+		return;
+	}
+
+	while ((count = esb->read_rx_payloads(payloads,
+					      ARRAY_SIZE(payloads))) > 0) {
+		for (int i = 0; i < count; i++) {
+			rx_store(dev, &payloads[i]);
+		}
+	}
+	zassert_equal(count, 0, "Read failed: %d", count);
+}
+
+static void event_handle(const struct esb_instance *esb, typeof(ptx) *dev,
+			 const struct nrf_esb_evt *event)
+{
+	if (use_frag && esb->frag_process_event(event)) {
+		return;
+	}
+
+	if ((event->payload != NULL) &&
+	    (dev->released_count < ARRAY_SIZE(dev->released))) {
+		dev->released[dev->released_count++] = event->payload;
+	}
+
+	switch (event->evt_id) {
+	case NRF_ESB_EVENT_TX_SUCCESS:
+		dev->tx_success++;
+		dev->tx_attempts += event->tx_attempts;
+		break;
+	case NRF_ESB_EVENT_TX_FAILED:
+		dev->tx_failed++;
+		dev->tx_attempts += event->tx_attempts;
+		break;
+	case NRF_ESB_EVENT_RX_RECEIVED:
+		dev->rx_events++;
+		rx_read(esb, dev);
+		break;
+	}
+}
+
+static void ptx_event_handler(const struct nrf_esb_evt *event)
+{
+	event_handle(&esb_ptx, &ptx, event);
+}
+
+static void prx_event_handler(const struct nrf_esb_evt *event)
+{
+	event_handle(&esb_prx, &prx, event);
+}
+
+static void frag_event_handle(typeof(ptx) *dev,
+			      const struct nrf_esb_frag_evt *event)
+{
+	switch (event->evt_id) {
+	case NRF_ESB_FRAG_EVENT_TX_SUCCESS:
+		dev->frag_tx_success++;
+		break;
+	case NRF_ESB_FRAG_EVENT_TX_FAILED:
+		zassert_unreachable("Message failed");
+		break;
+	case NRF_ESB_FRAG_EVENT_RX_RECEIVED:
+		memcpy(dev->frag_rx_data, event->data,
+		       min(event->length, sizeof(dev->frag_rx_data)));
+		dev->frag_rx_length = event->length;
+		dev->frag_rx_count++;
+		break;
+	}
+}
+
+static void ptx_frag_event_handler(const struct nrf_esb_frag_evt *event)
+{
+	frag_event_handle(&ptx, event);
+}
+
+static void prx_frag_event_handler(const struct nrf_esb_frag_evt *event)
+{
+	frag_event_handle(&prx, event);
+}
+
+static void setup(bool selective_auto_ack)
+{
+	struct nrf_esb_config config = NRF_ESB_DEFAULT_CONFIG;
+	int err;
+
+	memset(&ptx, 0, sizeof(ptx));
+	memset(&prx, 0, sizeof(prx));
+	use_frag = false;
+	use_batch_read = false;
+
+	radio_mock_reset(0x2019);
+
+	config.selective_auto_ack = selective_auto_ack;
+	config.retransmit_count = 10;
+
+	config.mode = NRF_ESB_MODE_PTX;
+	config.event_handler = ptx_event_handler;
+	err = esb_ptx.init(&config);
+	zassert_equal(err, 0, "PTX init failed: %d", err);
+
+	config.mode = NRF_ESB_MODE_PRX;
+	config.event_handler = prx_event_handler;
+	err = esb_prx.init(&config);
+	zassert_equal(err, 0, "PRX init failed: %d", err);
+
+	err = esb_prx.start_rx();
+	zassert_equal(err, 0, "PRX start failed: %d", err);
+}
+
+static void payload_fill(struct nrf_esb_payload *payload, u32_t seq,
+			 bool noack)
+{
+	memset(payload, 0, sizeof(*payload));
+	payload->pipe = 0;
+	payload->noack = noack;
+	payload->length = 1 + seq % CONFIG_NRF_ESB_MAX_PAYLOAD_LENGTH;
+	for (size_t i = 0; i < payload->length; i++) {
+		payload->data[i] = seq + i;
+	}
+}
+
+static void rx_check(u32_t count)
+{
+	struct nrf_esb_payload payload;
+
+	zassert_equal(prx.rx_count, count, "Received %u packets, not %u",
+		      prx.rx_count, count);
+
+	for (u32_t seq = 0; seq < count; seq++) {
+		payload_fill(&payload, seq, false);
+		zassert_equal(prx.rx_length[seq], payload.length,
+			      "Wrong length of packet %u", seq);
+		zassert_mem_equal(prx.rx_data[seq], payload.data,
+				  payload.length, "Wrong data in packet %u",
+				  seq);
+	}
+}
+
+static u32_t ptx_tx_count(void)
+{
+	return ptx.tx_success + ptx.tx_failed;
+}
+
+static u32_t stream_tx_target;
+
+static bool ptx_tx_target_reached(void)
+{
+	return ptx_tx_count() >= stream_tx_target;
+}
+
+/* Send PACKET_COUNT packets, keeping the TX FIFO filled. */
+static void stream(bool noack)
+{
+	struct nrf_esb_payload payload;
+	u32_t queued = 0;
+
+	while (ptx_tx_count() < PACKET_COUNT) {
+		while (queued < PACKET_COUNT) {
+			payload_fill(&payload, queued, noack);
+			if (esb_ptx.write_payload(&payload)) {
+				break;
+			}
+			queued++;
+		}
+
+		if (esb_ptx.is_idle()) {
+			esb_ptx.start_tx();
+		}
+
+		/* Refill the TX FIFO as soon as a packet is completed. */
+		stream_tx_target = ptx_tx_count() + 1;
+		zassert_true(radio_mock_run_until(ptx_tx_target_reached,
+						  PACKET_TIMEOUT_US),
+			     "Transmission stalled");
+	}
+
+	/* Let the PRX report the last packets. */
+	radio_mock_run(PACKET_TIMEOUT_US);
+}
+
+static bool ptx_one_done(void)
+{
+	return (ptx.tx_success + ptx.tx_failed) > 0;
+}
+
+void test_esb_tx_ack(void)
+{
+	struct nrf_esb_payload payload;
+	int err;
+
+	setup(false);
+
+	payload_fill(&payload, 0, false);
+	err = esb_ptx.write_payload(&payload);
+	zassert_equal(err, 0, "Write failed: %d", err);
+
+	zassert_true(radio_mock_run_until(ptx_one_done, PACKET_TIMEOUT_US),
+		     "No TX event");
+	radio_mock_run(PACKET_TIMEOUT_US);
+
+	zassert_equal(ptx.tx_success, 1, "Packet not acknowledged");
+	zassert_equal(ptx.tx_attempts, 1, "Unexpected retransmission");
+	rx_check(1);
+}
+
+void test_esb_ack_payload(void)
+{
+	struct nrf_esb_payload payload;
+	struct nrf_esb_payload ack;
+	int err;
+
+	setup(false);
+
+	payload_fill(&ack, 7, false);
+	err = esb_prx.write_ack_payload(&ack);
+	zassert_equal(err, 0, "ACK payload write failed: %d", err);
+
+	payload_fill(&payload, 0, false);
+	err = esb_ptx.write_payload(&payload);
+	zassert_equal(err, 0, "Write failed: %d", err);
+
+	zassert_true(radio_mock_run_until(ptx_one_done, PACKET_TIMEOUT_US),
+		     "No TX event");
+	radio_mock_run(PACKET_TIMEOUT_US);
+
+	zassert_equal(ptx.tx_success, 1, "Packet not acknowledged");
+	zassert_equal(ptx.rx_count, 1, "ACK payload not received");
+	zassert_equal(ptx.rx_length[0], ack.length, "Wrong ACK payload length");
+	zassert_mem_equal(ptx.rx_data[0], ack.data, ack.length,
+			  "Wrong ACK payload");
+}
+
+void test_esb_ack_payload_pipes(void)
+{
+	static const u8_t tx_pipes[] = { 1, 0, 1, 0 };
+	struct nrf_esb_payload ack[3];
+	struct nrf_esb_payload payload;
+
+	setup(false);
+
+	/* One ACK payload for pipe 0 and two for pipe 1. */
+	payload_fill(&ack[0], 10, false);
+	payload_fill(&ack[1], 20, false);
+	ack[1].pipe = 1;
+	payload_fill(&ack[2], 30, false);
+	ack[2].pipe = 1;
+	for (size_t i = 0; i < ARRAY_SIZE(ack); i++) {
+		zassert_equal(esb_prx.write_ack_payload(&ack[i]), 0,
+			      "ACK payload write failed");
+	}
+
+	for (u32_t seq = 0; seq < ARRAY_SIZE(tx_pipes); seq++) {
+		payload_fill(&payload, seq, false);
+		payload.pipe = tx_pipes[seq];
+		zassert_equal(esb_ptx.write_payload(&payload), 0,
+			      "Write failed");
+		stream_tx_target = seq + 1;
+		zassert_true(radio_mock_run_until(ptx_tx_target_reached,
+						  PACKET_TIMEOUT_US),
+			     "No TX event");
+	}
+	radio_mock_run(PACKET_TIMEOUT_US);
+
+	zassert_equal(ptx.tx_success, ARRAY_SIZE(tx_pipes), "Packets failed");
+	rx_check(ARRAY_SIZE(tx_pipes));
+
+	/* Each pipe is served from its own queue, in order. */
+	zassert_equal(ptx.rx_count, 3, "%u ACK payloads received",
+		      ptx.rx_count);
+	zassert_mem_equal(ptx.rx_data[0], ack[1].data, ack[1].length,
+			  "Wrong first ACK payload of pipe 1");
+	zassert_mem_equal(ptx.rx_data[1], ack[0].data, ack[0].length,
+			  "Wrong ACK payload of pipe 0");
+	zassert_mem_equal(ptx.rx_data[2], ack[2].data, ack[2].length,
+			  "Wrong second ACK payload of pipe 1");
+
+	/* An ACK payload is completed by the next packet on its pipe. */
+	zassert_equal(prx.tx_success, 2, "%u ACK payloads completed",
+		      prx.tx_success);
+}
+
+void test_esb_tx_failed(void)
+{
+	struct nrf_esb_payload payload;
+
+	setup(false);
+	radio_mock_loss_set(1000);
+
+	payload_fill(&payload, 0, false);
+	zassert_equal(esb_ptx.write_payload(&payload), 0, "Write failed");
+
+	zassert_true(radio_mock_run_until(ptx_one_done, PACKET_TIMEOUT_US),
+		     "No TX event");
+
+	zassert_equal(ptx.tx_failed, 1, "Packet not failed");
+	zassert_equal(ptx.tx_attempts, 11, "Wrong number of attempts: %u",
+		      ptx.tx_attempts);
+	zassert_equal(prx.rx_count, 0, "Packet received through loss");
+}
+
+void test_esb_lossy_link(void)
+{
+	struct radio_mock_stats stats;
+	struct nrf_esb_pipe_stats pipe_stats;
+
+	setup(false);
+	radio_mock_loss_set(200);
+
+	stream(false);
+
+	radio_mock_stats_get(&stats);
+	esb_ptx.get_pipe_stats(0, &pipe_stats);
+	zassert_equal(ptx.tx_success, PACKET_COUNT, "Packets failed");
+	zassert_true(pipe_stats.tx_attempts > PACKET_COUNT,
+		     "No retransmission");
+	zassert_true(stats.frames_lost > 0, "No frame lost");
+	/* Retransmissions of packets whose ACK was lost are dropped. */
+	rx_check(PACKET_COUNT);
+}
+
+void test_esb_frag(void)
+{
+	static u8_t message[FRAG_MESSAGE_SIZE];
+	int err;
+
+	setup(false);
+	use_frag = true;
+	esb_ptx.frag_init(ptx_frag_event_handler);
+	esb_prx.frag_init(prx_frag_event_handler);
+	radio_mock_loss_set(100);
+
+	for (size_t i = 0; i < sizeof(message); i++) {
+		message[i] = i * 7;
+	}
+
+	err = esb_ptx.frag_send(0, message, sizeof(message), false);
+	zassert_equal(err, 0, "Send failed: %d", err);
+
+	radio_mock_run(100 * PACKET_TIMEOUT_US);
+
+	zassert_equal(ptx.frag_tx_success, 1, "Message not sent");
+	zassert_equal(prx.frag_rx_count, 1, "Message not received");
+	zassert_equal(prx.frag_rx_length, sizeof(message), "Wrong length");
+	zassert_mem_equal(prx.frag_rx_data, message, sizeof(message),
+			  "Wrong message");
+}
+
+void test_esb_nocopy_release(void)
+{
+	static struct nrf_esb_payload lent[5];
+	struct nrf_esb_config config = NRF_ESB_DEFAULT_CONFIG;
+	int err;
+
+	/* A payload that fails is returned in the TX failed event. */
+	setup(false);
+	radio_mock_loss_set(1000);
+
+	payload_fill(&lent[0], 0, false);
+	err = esb_ptx.write_payload_nocopy(&lent[0]);
+	zassert_equal(err, 0, "Write failed: %d", err);
+	zassert_true(radio_mock_run_until(ptx_one_done, PACKET_TIMEOUT_US),
+		     "No TX event");
+
+	zassert_equal(ptx.tx_failed, 1, "Packet not failed");
+	zassert_equal(ptx.released_count, 1, "Payload not returned");
+	zassert_equal_ptr(ptx.released[0], &lent[0], "Wrong payload");
+
+	/* Queued payloads are returned when they are removed. */
+	setup(false);
+	esb_ptx.disable();
+	config.tx_mode = NRF_ESB_TXMODE_MANUAL;
+	config.event_handler = ptx_event_handler;
+	err = esb_ptx.init(&config);
+	zassert_equal(err, 0, "PTX init failed: %d", err);
+
+	for (size_t i = 0; i < 3; i++) {
+		payload_fill(&lent[i], i, false);
+		err = esb_ptx.write_payload_nocopy(&lent[i]);
+		zassert_equal(err, 0, "Write failed: %d", err);
+	}
+	zassert_equal(esb_ptx.pop_tx(), 0, "Pop failed");
+	zassert_equal(esb_ptx.flush_tx(), 0, "Flush failed");
+	radio_mock_run(PACKET_TIMEOUT_US);
+
+	zassert_equal(ptx.tx_failed, 3, "%u TX failed events", ptx.tx_failed);
+	zassert_equal(ptx.released_count, 3, "%u payloads returned",
+		      ptx.released_count);
+	zassert_equal_ptr(ptx.released[0], &lent[2], "Wrong popped payload");
+	zassert_equal_ptr(ptx.released[1], &lent[0], "Wrong flushed payload");
+	zassert_equal_ptr(ptx.released[2], &lent[1], "Wrong flushed payload");
+
+	/* nrf_esb_disable returns the payloads before it returns. */
+	for (size_t i = 3; i < 5; i++) {
+		payload_fill(&lent[i], i, false);
+		err = esb_ptx.write_payload_nocopy(&lent[i]);
+		zassert_equal(err, 0, "Write failed: %d", err);
+	}
+	esb_ptx.disable();
+
+	zassert_equal(ptx.released_count, 5, "%u payloads returned",
+		      ptx.released_count);
+	zassert_equal_ptr(ptx.released[3], &lent[3], "Wrong payload");
+	zassert_equal_ptr(ptx.released[4], &lent[4], "Wrong payload");
+
+	/* Lent ACK payloads are returned when their queue is flushed. */
+	payload_fill(&lent[0], 0, false);
+	lent[0].pipe = 1;
+	err = esb_prx.write_payload_nocopy(&lent[0]);
+	zassert_equal(err, 0, "ACK payload write failed: %d", err);
+	zassert_equal(esb_prx.pop_tx(), -ENOTSUP, "ACK payload popped");
+	zassert_equal(esb_prx.flush_ack_payloads(1), 0, "Flush failed");
+	radio_mock_run(PACKET_TIMEOUT_US);
+
+	zassert_equal(prx.tx_failed, 1, "ACK payload not failed");
+	zassert_equal(prx.released_count, 1, "ACK payload not returned");
+	zassert_equal_ptr(prx.released[0], &lent[0], "Wrong ACK payload");
+}
+
+static bool prx_radio_disabled(void)
+{
+	return radio_mock_regs_sync(1)->radio.STATE ==
+	       RADIO_STATE_STATE_Disabled;
+}
+
+void test_esb_rx_duty_cycle(void)
+{
+	struct nrf_esb_payload payload;
+	u32_t listening = 0;
+	int err;
+
+	setup(false);
+
+	esb_prx.stop_rx();
+	err = esb_prx.set_rx_duty_cycle(20, 2000);
+	zassert_equal(err, 0, "Duty cycle not set: %d", err);
+	err = esb_prx.start_rx();
+	zassert_equal(err, 0, "PRX start failed: %d", err);
+
+	/* Retransmissions span a period and hit every window. */
+	esb_ptx.set_retransmit_delay(1000);
+	esb_ptx.set_retransmit_count(30);
+
+	for (u32_t seq = 0; seq < 5; seq++) {
+		payload_fill(&payload, seq, false);
+		zassert_equal(esb_ptx.write_payload(&payload), 0,
+			      "Write failed");
+		stream_tx_target = seq + 1;
+		zassert_true(radio_mock_run_until(ptx_tx_target_reached,
+						  PACKET_TIMEOUT_US),
+			     "No TX event");
+		radio_mock_run(1000 * (seq * 7 % 20));
+	}
+	radio_mock_run(PACKET_TIMEOUT_US);
+
+	zassert_equal(ptx.tx_success, 5, "Packets failed");
+	rx_check(5);
+
+	/* The PRX listens during the windows only. */
+	for (u32_t ms = 0; ms < 200; ms++) {
+		radio_mock_run(1000);
+		if (!prx_radio_disabled()) {
+			listening++;
+		}
+	}
+	zassert_true(listening > 10 && listening < 30,
+		     "PRX listened for %u ms out of 200", listening);
+
+	esb_prx.stop_rx();
+	esb_prx.set_rx_duty_cycle(0, 0);
+}
+
+void test_esb_noack_irq_latency(void)
+{
+	/* Up to more than two packets of 32 bytes, with ramp-up. */
+	static const u32_t latency_us[] = { 0, 50, 200, 500, 1200 };
+
+	for (size_t i = 0; i < ARRAY_SIZE(latency_us); i++) {
+		setup(true);
+		radio_mock_irq_latency_set(0, latency_us[i]);
+
+		stream(true);
+
+		zassert_equal(ptx.tx_success, PACKET_COUNT,
+			      "%u us: %u packets sent", latency_us[i],
+			      ptx.tx_success);
+		/* Packets repeated by a late interrupt are dropped by the
+		 * PRX as retransmissions.
+		 */
+		rx_check(PACKET_COUNT);
+	}
+}
+
+static bool ptx_two_done(void)
+{
+	return ptx_tx_count() >= 2;
+}
+
+void test_esb_hopping(void)
+{
+	static const u8_t table[] = { 2, 30, 60, 90 };
+	struct nrf_esb_payload payload;
+	u32_t channel;
+
+	setup(false);
+
+	esb_prx.stop_rx();
+	zassert_equal(esb_ptx.set_hop_table(table, ARRAY_SIZE(table)), 0,
+		      "PTX hop table not set");
+	zassert_equal(esb_prx.set_hop_table(table, ARRAY_SIZE(table)), 0,
+		      "PRX hop table not set");
+	/* The PRX starts away from the first channel of the table. */
+	esb_prx.set_rf_channel(table[2]);
+	esb_prx.start_rx();
+
+	/* The PTX sweeps the table until the PRX acknowledges. */
+	payload_fill(&payload, 0, false);
+	zassert_equal(esb_ptx.write_payload(&payload), 0, "Write failed");
+	zassert_true(radio_mock_run_until(ptx_one_done, PACKET_TIMEOUT_US),
+		     "No TX event");
+
+	zassert_equal(ptx.tx_success, 1, "Packet not acknowledged");
+	zassert_equal(ptx.tx_attempts,
+		      2 * CONFIG_NRF_ESB_HOPPING_PTX_ATTEMPTS + 1,
+		      "Wrong number of attempts: %u", ptx.tx_attempts);
+	esb_ptx.get_rf_channel(&channel);
+	zassert_equal(channel, table[2], "PTX on channel %u", channel);
+
+	/* Without packets for a timeout, the PRX moves on. The first period
+	 * still has the packet above.
+	 */
+	k_sleep(CONFIG_NRF_ESB_HOPPING_PRX_TIMEOUT_MS * 5 / 2);
+	radio_mock_run(1000);
+	esb_prx.get_rf_channel(&channel);
+	zassert_equal(channel, table[1], "PRX on channel %u", channel);
+
+	payload_fill(&payload, 1, false);
+	zassert_equal(esb_ptx.write_payload(&payload), 0, "Write failed");
+	zassert_true(radio_mock_run_until(ptx_two_done, PACKET_TIMEOUT_US),
+		     "No TX event");
+	radio_mock_run(PACKET_TIMEOUT_US);
+
+	zassert_equal(ptx.tx_success, 2, "Packet not acknowledged");
+	esb_ptx.get_rf_channel(&channel);
+	zassert_equal(channel, table[1], "PTX on channel %u", channel);
+	rx_check(2);
+
+	esb_prx.stop_rx();
+	esb_ptx.set_hop_table(NULL, 0);
+	esb_prx.set_hop_table(NULL, 0);
+	esb_ptx.set_rf_channel(table[0]);
+	esb_prx.set_rf_channel(table[0]);
+}
+
+void test_esb_rx_moderation(void)
+{
+	struct nrf_esb_payload payload;
+
+	setup(true);
+	use_batch_read = true;
+
+	/* A single packet is reported when the event timeout expires. */
+	payload_fill(&payload, 0, false);
+	zassert_equal(esb_ptx.write_payload(&payload), 0, "Write failed");
+	zassert_true(radio_mock_run_until(ptx_one_done, PACKET_TIMEOUT_US),
+		     "No TX event");
+	zassert_equal(prx.rx_events, 0, "RX event not held back");
+	radio_mock_run(2 * CONFIG_NRF_ESB_RX_EVENT_TIMEOUT_US);
+	zassert_equal(prx.rx_events, 1, "RX event not sent after timeout");
+	rx_check(1);
+
+	/* A stream is reported in batches. */
+	setup(true);
+	use_batch_read = true;
+
+	stream(true);
+
+	zassert_equal(ptx.tx_success, PACKET_COUNT, "Packets failed");
+	rx_check(PACKET_COUNT);
+	zassert_true(prx.rx_events <= PACKET_COUNT / 2,
+		     "%u RX events for %u packets", prx.rx_events,
+		     PACKET_COUNT);
+}
+
+void test_esb_latency_trace(void)
+{
+	struct nrf_esb_latency_stats stats[NRF_ESB_LATENCY_STAGE_COUNT];
+
+	setup(false);
+	esb_ptx.reset_latency_stats();
+
+	stream(false);
+
+	for (int stage = 0; stage < NRF_ESB_LATENCY_STAGE_COUNT; stage++) {
+		zassert_equal(esb_ptx.get_latency_stats(stage, &stats[stage]),
+			      0, "No statistics for stage %d", stage);
+		zassert_true((stats[stage].min_us <= stats[stage].avg_us) &&
+			     (stats[stage].avg_us <= stats[stage].max_us),
+			     "Inconsistent statistics for stage %d", stage);
+	}
+
+	zassert_equal(stats[NRF_ESB_LATENCY_QUEUE].count, PACKET_COUNT,
+		      "Queue stage not traced");
+	zassert_equal(stats[NRF_ESB_LATENCY_RADIO].count, PACKET_COUNT,
+		      "Radio stage not traced");
+	zassert_equal(stats[NRF_ESB_LATENCY_ACK].count, PACKET_COUNT,
+		      "ACK stage not traced");
+	zassert_true(stats[NRF_ESB_LATENCY_EVENT].count > 0,
+		     "Event stage not traced");
+
+	/* Sending takes a ramp-up and the airtime, and the ACK comes after
+	 * the ramp-up of the PRX.
+	 */
+	zassert_true(stats[NRF_ESB_LATENCY_RADIO].min_us > 0,
+		     "No radio time");
+	zassert_true(stats[NRF_ESB_LATENCY_ACK].min_us > 0, "No ACK time");
+
+	zassert_equal(esb_ptx.get_latency_stats(NRF_ESB_LATENCY_STAGE_COUNT,
+						&stats[0]),
+		      -EINVAL, "Invalid stage accepted");
+}
+
+static void benchmark(const char *name, bool noack, u32_t loss_permille)
+{
+	struct radio_mock_stats stats;
+	u64_t start;
+	u64_t duration;
+
+	setup(noack);
+	radio_mock_loss_set(loss_permille);
+
+	start = radio_mock_time_get();
+	stream(noack);
+	duration = radio_mock_time_get() - start - PACKET_TIMEOUT_US;
+	radio_mock_stats_get(&stats);
+
+	TC_PRINT("%s, %u/1000 loss: %u packets in %u us, %u frames sent\n",
+		 name, loss_permille, PACKET_COUNT, (u32_t)duration,
+		 stats.frames_sent);
+}
+
+void test_esb_benchmark(void)
+{
+	benchmark("ACK", false, 0);
+	zassert_equal(ptx.tx_success, PACKET_COUNT, "Packets failed");
+	rx_check(PACKET_COUNT);
+
+	benchmark("ACK", false, 100);
+	zassert_equal(ptx.tx_success, PACKET_COUNT, "Packets failed");
+	rx_check(PACKET_COUNT);
+
+	benchmark("No ACK", true, 0);
+	zassert_equal(ptx.tx_success, PACKET_COUNT, "Packets failed");
+	rx_check(PACKET_COUNT);
+}
+
+void test_main(void)
+{
+	ztest_test_suite(
+		test_esb,
+		ztest_unit_test(test_esb_tx_ack),
+		ztest_unit_test(test_esb_ack_payload),
+		ztest_unit_test(test_esb_ack_payload_pipes),
+		ztest_unit_test(test_esb_tx_failed),
+		ztest_unit_test(test_esb_lossy_link),
+		ztest_unit_test(test_esb_frag),
+		ztest_unit_test(test_esb_nocopy_release),
+		ztest_unit_test(test_esb_rx_duty_cycle),
+		ztest_unit_test(test_esb_noack_irq_latency),
+		ztest_unit_test(test_esb_hopping),
+		ztest_unit_test(test_esb_rx_moderation),
+		ztest_unit_test(test_esb_latency_trace),
+		ztest_unit_test(test_esb_benchmark)
+	);
+
+	ztest_run_test_suite(test_esb);
+}
@@ -0,0 +1,231 @@
+/*
+ * Copyright (c) 2018 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+#include <ztest.h>
+#include <string.h>
+#include <misc/util.h>
+#include <net/mqtt_socket.h>
+
+#define NODE_COUNT 16
+#define FILTER_COUNT 8
+
+static struct mqtt_topic_node nodes[NODE_COUNT];
+static struct mqtt_topic_trie trie;
+
+/* Filters registered by a test, the user data of a handler is the index of
+ * its filter.
+ */
+static struct mqtt_utf8 filters[FILTER_COUNT];
+static char filter_bufs[FILTER_COUNT][32];
+
+/* Number of calls of the handler of each filter. */
+static u32_t calls[FILTER_COUNT];
+
+static void handler(struct mqtt_client *client,
+		    const struct mqtt_publish_param *param, void *user_data)
+{
+	calls[POINTER_TO_UINT(user_data)]++;
+}
+
+static void trie_reset(u32_t node_count)
+{
+	mqtt_topic_trie_init(&trie, nodes, node_count);
+	memset(calls, 0, sizeof(calls));
+}
+
+static int filter_add(u32_t index, const char *filter)
+{
+	strcpy(filter_bufs[index], filter);
+	filters[index].utf8 = (u8_t *)filter_bufs[index];
+	filters[index].size = strlen(filter);
+
+	return mqtt_topic_trie_add(&trie, &filters[index], handler,
+				   UINT_TO_POINTER(index));
+}
+
+static int filter_remove(u32_t index)
+{
+	return mqtt_topic_trie_remove(&trie, &filters[index]);
+}
+
+/* Dispatches a topic and returns the number of handlers called. */
+static int dispatch(const char *topic)
+{
+	struct mqtt_publish_param param = {
+		.message.topic.topic = {
+			.utf8 = (u8_t *)topic,
+			.size = strlen(topic)
+		}
+	};
+
+	memset(calls, 0, sizeof(calls));
+
+	return mqtt_topic_trie_dispatch(&trie, NULL, &param);
+}
+
+static u32_t free_node_count(void)
+{
+	u32_t count = 0;
+
+	for (u32_t i = 0; i < trie.node_count; i++) {
+		if (nodes[i].level == NULL) {
+			count++;
+		}
+	}
+
+	return count;
+}
+
+static void test_topic_trie_single_level(void)
+{
+	trie_reset(NODE_COUNT);
+
+	zassert_equal(filter_add(0, "a/b/c"), 0, "Filter not added");
+	zassert_equal(filter_add(1, "a/+/c"), 0, "Filter not added");
+	zassert_equal(filter_add(2, "+/+/+"), 0, "Filter not added");
+	zassert_equal(filter_add(3, "a/+"), 0, "Filter not added");
+
+	zassert_equal(dispatch("a/b/c"), 3, "Wrong handler count");
+	zassert_true(calls[0] == 1 && calls[1] == 1 && calls[2] == 1,
+		     "Wrong handlers called");
+
+	zassert_equal(dispatch("a/x/c"), 2, "Wrong handler count");
+	zassert_true(calls[1] == 1 && calls[2] == 1, "Wrong handlers called");
+
+	zassert_equal(dispatch("a/x"), 1, "Wrong handler count");
+	zassert_equal(calls[3], 1, "Wrong handler called");
+
+	/* + matches an empty level, but not several levels. */
+	zassert_equal(dispatch("a//c"), 2, "Wrong handler count");
+	zassert_equal(dispatch("a/b/c/d"), 0, "Handler called");
+	zassert_equal(dispatch("b/c"), 0, "Handler called");
+}
+
+static void test_topic_trie_multi_level(void)
+{
+	trie_reset(NODE_COUNT);
+
+	zassert_equal(filter_add(0, "#"), 0, "Filter not added");
+	zassert_equal(filter_add(1, "a/#"), 0, "Filter not added");
+	zassert_equal(filter_add(2, "a/b/#"), 0, "Filter not added");
+	zassert_equal(filter_add(3, "a/+/#"), 0, "Filter not added");
+
+	zassert_equal(dispatch("a/b/c/d"), 4, "Wrong handler count");
+
+	/* A filter ending with # also matches its parent level. */
+	zassert_equal(dispatch("a/b"), 4, "Wrong handler count");
+	zassert_equal(dispatch("a"), 2, "Wrong handler count");
+	zassert_true(calls[0] == 1 && calls[1] == 1, "Wrong handlers called");
+
+	zassert_equal(dispatch("x/y"), 1, "Wrong handler count");
+	zassert_equal(calls[0], 1, "Wrong handler called");
+}
+
+static void test_topic_trie_system(void)
+{
+	trie_reset(NODE_COUNT);
+
+	zassert_equal(filter_add(0, "#"), 0, "Filter not added");
+	zassert_equal(filter_add(1, "+/info"), 0, "Filter not added");
+	zassert_equal(filter_add(2, "$SYS/#"), 0, "Filter not added");
+	zassert_equal(filter_add(3, "$SYS/+"), 0, "Filter not added");
+	zassert_equal(filter_add(4, "$SYS/info"), 0, "Filter not added");
+
+	/* Topics starting with $ are not matched by leading wildcards. */
+	zassert_equal(dispatch("$SYS/info"), 3, "Wrong handler count");
+	zassert_true(calls[2] == 1 && calls[3] == 1 && calls[4] == 1,
+		     "Wrong handlers called");
+
+	zassert_equal(dispatch("$SYS"), 1, "Wrong handler count");
+	zassert_equal(calls[2], 1, "Wrong handler called");
+
+	/* Only the first level is concerned. */
+	zassert_equal(dispatch("a/$info"), 1, "Wrong handler count");
+	zassert_equal(dispatch("a/info"), 2, "Wrong handler count");
+	zassert_true(calls[0] == 1 && calls[1] == 1, "Wrong handlers called");
+}
+
+static void test_topic_trie_errors(void)
+{
+	trie_reset(4);
+
+	zassert_equal(filter_add(0, ""), -EINVAL, "Empty filter added");
+	zassert_equal(filter_add(0, "a/b#"), -EINVAL, "Invalid # added");
+	zassert_equal(filter_add(0, "a/#/b"), -EINVAL, "Invalid # added");
+	zassert_equal(filter_add(0, "a+/b"), -EINVAL, "Invalid + added");
+
+	zassert_equal(filter_add(0, "a/b/c"), 0, "Filter not added");
+	zassert_equal(filter_add(1, "a/b/c"), -EEXIST, "Filter added twice");
+	zassert_equal(filter_add(1, "a/b/d"), 0, "Filter not added");
+
+	/* The trie is left unchanged when nodes are missing. */
+	zassert_equal(filter_add(2, "a/x/y"), -ENOMEM, "Filter added");
+	zassert_equal(free_node_count(), 0, "Nodes leaked");
+	zassert_equal(dispatch("a/x/y"), 0, "Handler called");
+
+	zassert_equal(filter_add(2, "a/b"), 0, "Filter not added");
+	zassert_equal(dispatch("a/b"), 1, "Wrong handler count");
+
+	filters[3].utf8 = (u8_t *)"a/b/e";
+	filters[3].size = strlen("a/b/e");
+	zassert_equal(filter_remove(3), -ENOENT, "Unknown filter removed");
+	filters[3].utf8 = (u8_t *)"a";
+	filters[3].size = strlen("a");
+	zassert_equal(filter_remove(3), -ENOENT, "Inner level removed");
+
+	zassert_equal(filter_remove(2), 0, "Filter not removed");
+	zassert_equal(filter_remove(2), -ENOENT, "Filter removed twice");
+	zassert_equal(dispatch("a/b/c"), 1, "Wrong handler count");
+}
+
+static void test_topic_trie_remove(void)
+{
+	trie_reset(NODE_COUNT);
+
+	zassert_equal(filter_add(0, "a/b/c"), 0, "Filter not added");
+	zassert_equal(filter_add(1, "a/b/d"), 0, "Filter not added");
+	zassert_equal(filter_add(2, "a/+/c"), 0, "Filter not added");
+	zassert_equal(free_node_count(), NODE_COUNT - 6, "Wrong node count");
+
+	/* The shared nodes point into the first filter added. They are moved
+	 * to another filter, so the removed filter can be released.
+	 */
+	zassert_equal(filter_remove(0), 0, "Filter not removed");
+	memset(filter_bufs[0], 'x', sizeof(filter_bufs[0]));
+	zassert_equal(free_node_count(), NODE_COUNT - 5, "Node not freed");
+
+	zassert_equal(dispatch("a/b/d"), 1, "Wrong handler count");
+	zassert_equal(calls[1], 1, "Wrong handler called");
+	zassert_equal(dispatch("a/b/c"), 1, "Wrong handler count");
+	zassert_equal(calls[2], 1, "Wrong handler called");
+
+	zassert_equal(filter_remove(1), 0, "Filter not removed");
+	memset(filter_bufs[1], 'x', sizeof(filter_bufs[1]));
+	zassert_equal(free_node_count(), NODE_COUNT - 3, "Nodes not freed");
+	zassert_equal(dispatch("a/y/c"), 1, "Wrong handler count");
+
+	zassert_equal(filter_remove(2), 0, "Filter not removed");
+	zassert_equal(free_node_count(), NODE_COUNT, "Nodes not freed");
+	zassert_equal(dispatch("a/y/c"), 0, "Handler called");
+
+	/* The freed nodes can be used again. */
+	zassert_equal(filter_add(3, "a/b/c"), 0, "Filter not added");
+	zassert_equal(dispatch("a/b/c"), 1, "Wrong handler count");
+	zassert_equal(calls[3], 1, "Wrong handler called");
+}
+
+void test_main(void)
+{
+	ztest_test_suite(
+		test_topic_trie,
+		ztest_unit_test(test_topic_trie_single_level),
+		ztest_unit_test(test_topic_trie_multi_level),
+		ztest_unit_test(test_topic_trie_system),
+		ztest_unit_test(test_topic_trie_errors),
+		ztest_unit_test(test_topic_trie_remove)
+	);
+
+	ztest_run_test_suite(test_topic_trie);
+}